@@ -0,0 +1,202 @@
+/*
+  bench.h - minimal benchmark harness for vpack
+
+  Copyright (C) 2025 Jacob Bierstedt
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef VPACK_BENCH_H
+#define VPACK_BENCH_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "perf.h"
+
+/*
+  A benchmark body runs `iters` passes over its input. Each pass
+  performs `ops` operations touching `bytes` bytes of packed data.
+*/
+typedef void (*bench_fn)(void* ctx, uint64_t iters);
+
+typedef struct
+{
+  const char* name;
+  const char* dist;
+  uint64_t ops;       // operations per pass
+  uint64_t bytes;     // packed bytes per pass
+  uint64_t iters;     // passes per sample
+  int reps;
+  double ns_op_min;
+  double ns_op_median;
+  double ns_op_mean;
+  double ns_op_stddev;
+  double gbps;        // at the median
+
+  /* hardware counters over all timed samples, when available */
+  int has_perf;
+  uint64_t perf[BP_NEVENTS];
+  double perf_seconds;
+} bench_result_t;
+
+typedef struct
+{
+  int reps;           // timed samples per benchmark
+  double warmup_s;    // warm-up time per benchmark
+  double sample_s;    // target time per sample
+  const char* filter; // run only names containing this
+  FILE* json;
+  int njson;
+  bench_perf_t* perf; // hardware counters, NULL: off
+} bench_opts_t;
+
+static inline bench_opts_t bench_opts_init(void) {
+  return (bench_opts_t){15, 0.1, 0.01, NULL, NULL, 0, NULL};
+}
+
+/* Sink to keep results observable so the compiler cannot drop the work */
+static volatile uint64_t bench_sink;
+
+static inline double bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline int _bench_dbl_cmp(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return x < y ? -1 : x > y;
+}
+
+static inline void bench_json_begin(bench_opts_t* o) {
+  if (o->json) fprintf(o->json, "{\n  \"benchmarks\": [\n");
+}
+
+static inline void bench_json_end(bench_opts_t* o) {
+  if (o->json) fprintf(o->json, "\n  ]\n}\n");
+}
+
+static inline double _bench_ratio(uint64_t a, uint64_t b) {
+  return b ? (double)a / (double)b : 0.0;
+}
+
+static inline void bench_report(bench_opts_t* o, const bench_result_t* r) {
+  printf("%-22s %-10s %10.3f ns/op  (min %8.3f  sd %6.3f)  %8.3f GB/s",
+         r->name, r->dist, r->ns_op_median, r->ns_op_min, r->ns_op_stddev, r->gbps);
+  if (r->has_perf) {
+    const bench_perf_t* p = o->perf;
+    if (bench_perf_has(p, BP_CYCLES) && bench_perf_has(p, BP_INSTRUCTIONS))
+      printf("  ipc %5.2f", _bench_ratio(r->perf[BP_INSTRUCTIONS], r->perf[BP_CYCLES]));
+    if (bench_perf_has(p, BP_BRANCHES) && bench_perf_has(p, BP_BRANCH_MISSES))
+      printf("  br-miss %6.3f%%", 100.0 * _bench_ratio(r->perf[BP_BRANCH_MISSES], r->perf[BP_BRANCHES]));
+    if (bench_perf_has(p, BP_CACHE_MISSES))
+      printf("  llc-miss/op %.4f", (double)r->perf[BP_CACHE_MISSES] / ((double)r->ops * r->iters * r->reps));
+  }
+  printf("\n");
+  if (!o->json) return;
+  fprintf(o->json, "%s    {\"name\": \"%s\", \"dist\": \"%s\", \"reps\": %d, \"iters\": %llu, "
+          "\"ops\": %llu, \"bytes\": %llu, \"ns_op_median\": %.4f, \"ns_op_min\": %.4f, "
+          "\"ns_op_mean\": %.4f, \"ns_op_stddev\": %.4f, \"gbps\": %.4f, \"counters\": ",
+          o->njson++ ? ",\n" : "", r->name, r->dist, r->reps, (unsigned long long)r->iters,
+          (unsigned long long)r->ops, (unsigned long long)r->bytes, r->ns_op_median, r->ns_op_min,
+          r->ns_op_mean, r->ns_op_stddev, r->gbps);
+  if (!r->has_perf) {
+    fprintf(o->json, "null}");
+    return;
+  }
+  double nops = (double)r->ops * (double)r->iters * (double)r->reps;
+  fprintf(o->json, "{");
+  for (int i = 0, n = 0; i < BP_NEVENTS; i++) {
+    if (!bench_perf_has(o->perf, i)) continue;
+    fprintf(o->json, "%s\"%s_per_op\": %.6f", n++ ? ", " : "", bench_perf_names[i], (double)r->perf[i] / nops);
+  }
+  if (bench_perf_has(o->perf, BP_CYCLES) && bench_perf_has(o->perf, BP_INSTRUCTIONS))
+    fprintf(o->json, ", \"ipc\": %.4f", _bench_ratio(r->perf[BP_INSTRUCTIONS], r->perf[BP_CYCLES]));
+  if (bench_perf_has(o->perf, BP_BRANCHES) && bench_perf_has(o->perf, BP_BRANCH_MISSES))
+    fprintf(o->json, ", \"branch_miss_rate\": %.6f", _bench_ratio(r->perf[BP_BRANCH_MISSES], r->perf[BP_BRANCHES]));
+  /* DRAM traffic estimate: one 64-byte line per last level cache miss */
+  if (bench_perf_has(o->perf, BP_CACHE_MISSES) && r->perf_seconds > 0)
+    fprintf(o->json, ", \"mem_gbps_est\": %.4f", (double)r->perf[BP_CACHE_MISSES] * 64.0 / r->perf_seconds * 1e-9);
+  fprintf(o->json, "}}");
+}
+
+/*
+  @brief
+  Time a benchmark body: warm up, pick a pass count so each sample
+  lasts about `sample_s`, then take `reps` samples and report
+  ns/op statistics and GB/s at the median. With `o->perf` set,
+  hardware counters are collected over the timed samples.
+
+  @returns status  0: ran, 1: skipped by filter
+*/
+static inline int bench_run(bench_opts_t* o, const char* name, const char* dist,
+                            bench_fn fn, void* ctx, uint64_t ops, uint64_t bytes,
+                            bench_result_t* out) {
+  if (o->filter && !strstr(name, o->filter)) return 1;
+  uint64_t iters = 1;
+  double t0 = bench_now(), t1 = t0;
+  while (t1 - t0 < o->warmup_s) {
+    fn(ctx, iters);
+    t1 = bench_now();
+    if (iters < (1ULL << 30)) iters *= 2;
+  }
+  /* calibrate */
+  iters = 1;
+  for (;;) {
+    double a = bench_now();
+    fn(ctx, iters);
+    double dt = bench_now() - a;
+    if (dt >= o->sample_s || iters >= (1ULL << 40)) break;
+    iters = dt > 0 ? (uint64_t)(iters * (o->sample_s / dt) * 1.1) + 1 : iters * 10;
+  }
+  double* ns = (double*)malloc((size_t)o->reps * sizeof(double));
+  double sum = 0.0, total = 0.0;
+  if (o->perf) bench_perf_start(o->perf);
+  for (int i = 0; i < o->reps; i++) {
+    double a = bench_now();
+    fn(ctx, iters);
+    double dt = bench_now() - a;
+    ns[i] = dt * 1e9 / ((double)iters * (double)ops);
+    sum += ns[i];
+    total += dt;
+  }
+  if (o->perf) bench_perf_stop(o->perf);
+  qsort(ns, (size_t)o->reps, sizeof(double), _bench_dbl_cmp);
+  bench_result_t r = {.name = name, .dist = dist, .ops = ops, .bytes = bytes, .iters = iters, .reps = o->reps};
+  r.ns_op_min = ns[0];
+  r.ns_op_median = o->reps & 1 ? ns[o->reps / 2] : 0.5 * (ns[o->reps / 2 - 1] + ns[o->reps / 2]);
+  r.ns_op_mean = sum / o->reps;
+  double var = 0.0;
+  for (int i = 0; i < o->reps; i++) var += (ns[i] - r.ns_op_mean) * (ns[i] - r.ns_op_mean);
+  r.ns_op_stddev = o->reps > 1 ? sqrt(var / (o->reps - 1)) : 0.0;
+  r.gbps = (double)bytes / ((double)ops * r.ns_op_median);
+  if (o->perf) {
+    r.has_perf = 1;
+    memcpy(r.perf, o->perf->val, sizeof(r.perf));
+    r.perf_seconds = total;
+  }
+  free(ns);
+  bench_report(o, &r);
+  if (out) *out = r;
+  return 0;
+}
+
+#endif /* VPACK_BENCH_H */
@@ -0,0 +1,121 @@
+/*
+  perf.h - optional hardware counters for vpack benchmarks
+
+  Counters are read with Linux perf_event_open for the calling thread,
+  user space only. Each event is opened on its own, so a machine or VM
+  that lacks one event still reports the others. When perf events are
+  not permitted (kernel.perf_event_paranoid, containers) or on other
+  platforms, `bench_perf_open` returns -1 and benchmarks run without
+  counters.
+
+  Copyright (C) 2025 Jacob Bierstedt
+  Licensed under the GNU GPL v3 or later, see ../LICENSE
+*/
+#ifndef VPACK_BENCH_PERF_H
+#define VPACK_BENCH_PERF_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum {
+  BP_CYCLES,
+  BP_INSTRUCTIONS,
+  BP_CACHE_REFS,
+  BP_CACHE_MISSES,   // last level cache
+  BP_BRANCHES,
+  BP_BRANCH_MISSES,
+  BP_NEVENTS
+};
+
+static const char* bench_perf_names[BP_NEVENTS] = {
+  "cycles", "instructions", "cache_refs", "cache_misses", "branches", "branch_misses"
+};
+
+typedef struct
+{
+  int fd[BP_NEVENTS];     // -1: event unavailable
+  uint64_t val[BP_NEVENTS];
+  int nopen;
+} bench_perf_t;
+
+#if defined(__linux__)
+static inline int _bench_perf_event(uint64_t config) {
+  struct perf_event_attr pe;
+  memset(&pe, 0, sizeof(pe));
+  pe.type = PERF_TYPE_HARDWARE;
+  pe.size = sizeof(pe);
+  pe.config = config;
+  pe.disabled = 1;
+  pe.exclude_kernel = 1;
+  pe.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+}
+#endif
+
+/*
+  @brief
+  Open counters for the calling thread.
+
+  @returns status  0: at least one counter open, -1: counters unavailable
+*/
+static inline int bench_perf_open(bench_perf_t* p) {
+  memset(p, 0, sizeof(*p));
+  for (int i = 0; i < BP_NEVENTS; i++) p->fd[i] = -1;
+#if defined(__linux__)
+  static const uint64_t cfg[BP_NEVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_REFERENCES,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES
+  };
+  for (int i = 0; i < BP_NEVENTS; i++) {
+    p->fd[i] = _bench_perf_event(cfg[i]);
+    if (p->fd[i] >= 0) p->nopen++;
+  }
+#endif
+  return p->nopen ? 0 : -1;
+}
+
+static inline void bench_perf_close(bench_perf_t* p) {
+#if defined(__linux__)
+  for (int i = 0; i < BP_NEVENTS; i++)
+    if (p->fd[i] >= 0) close(p->fd[i]);
+#endif
+  memset(p, 0, sizeof(*p));
+}
+
+static inline void bench_perf_start(bench_perf_t* p) {
+#if defined(__linux__)
+  for (int i = 0; i < BP_NEVENTS; i++) {
+    if (p->fd[i] < 0) continue;
+    ioctl(p->fd[i], PERF_EVENT_IOC_RESET, 0);
+    ioctl(p->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+  }
+#else
+  (void)p;
+#endif
+}
+
+static inline void bench_perf_stop(bench_perf_t* p) {
+#if defined(__linux__)
+  for (int i = 0; i < BP_NEVENTS; i++) {
+    p->val[i] = 0;
+    if (p->fd[i] < 0) continue;
+    ioctl(p->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+    if (read(p->fd[i], &p->val[i], sizeof(uint64_t)) != sizeof(uint64_t)) p->val[i] = 0;
+  }
+#else
+  (void)p;
+#endif
+}
+
+static inline int bench_perf_has(const bench_perf_t* p, int ev) {
+  return p->fd[ev] >= 0;
+}
+
+#endif /* VPACK_BENCH_PERF_H */
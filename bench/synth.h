@@ -0,0 +1,229 @@
+/*
+  synth.h - deterministic synthetic cohorts for vpack benchmarks
+
+  Copyright (C) 2025 Jacob Bierstedt
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef VPACK_SYNTH_H
+#define VPACK_SYNTH_H
+
+#include <pthread.h>
+#include "../vpack.h"
+
+/*
+  Cohort model
+
+  - Sites are spread evenly over `nchrom` chromosomes, in genomic
+    order, with a random jitter inside each site's slot.
+  - Alt allele frequencies follow a power-law site frequency spectrum,
+    density ~ x^-sfs_exp on [1/2n, 1 - 1/2n]; 1.0 is the neutral
+    spectrum, so most sites are rare and most GTs are hom-ref.
+  - Sites are grouped into LD blocks of `ld_block` sites. Each
+    haplotype draws one latent value per block. A site follows the
+    block with probability `ld_r`: its alt carriers are the haplotypes
+    whose latent value falls under the site AF, so those sites are in
+    strong LD. Other sites rehash the latent value and are independent.
+  - `missing` and `phased` only apply to `snvpack64` output, since
+    packed rows have no missing or phase state.
+
+  Every random draw is a hash of (seed, site or block, haplotype), so
+  output is identical for any thread count or chunking.
+*/
+typedef struct
+{
+  uint32_t nsamples;
+  uint64_t nsites;
+  uint64_t seed;
+  uint32_t nchrom;
+  double sfs_exp;     // site frequency spectrum exponent
+  uint32_t ld_block;  // sites per LD block
+  double ld_r;        // fraction of sites that follow their block
+  double missing;     // missing GT rate, snvpack64 only
+  double phased;      // phased GT rate, snvpack64 only
+  uint32_t threads;
+} synth_cfg_t;
+
+static inline synth_cfg_t synth_cfg_init(uint32_t nsamples, uint64_t nsites, uint64_t seed) {
+  return (synth_cfg_t){nsamples, nsites, seed, 22, 1.0, 50, 0.8, 0.01, 0.5, 1};
+}
+
+static inline uint64_t synth_hash(uint64_t seed, uint64_t a, uint64_t b) {
+  return vp_hash64(seed ^ vp_hash64(a * 0x9e3779b97f4a7c15ULL + b));
+}
+
+static inline double synth_unit(uint64_t h) {
+  return ((double)(h >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/*
+  @brief
+  Site word and alt allele frequency of site `i`
+*/
+static inline vpack64_t synth_site(const synth_cfg_t* c, uint64_t i, double* af) {
+  uint64_t per_chrom = (c->nsites + c->nchrom - 1) / c->nchrom;
+  uint32_t chrom = 1 + (uint32_t)(i / per_chrom);
+  uint64_t local = i % per_chrom;
+  uint64_t slot = VMASK_28 / (per_chrom + 1);
+  if (!slot) slot = 1;
+  uint64_t h = synth_hash(c->seed, i, 0);
+  uint32_t pos = (uint32_t)(1 + local * slot + (h % slot));
+  static const uint8_t bases[4] = {'A', 'C', 'G', 'T'};
+  uint8_t ref = bases[(h >> 32) & 3];
+  uint8_t alt = bases[(((h >> 32) & 3) + 1 + ((h >> 34) % 3)) & 3];
+
+  double lo = 1.0 / (2.0 * (c->nsamples ? c->nsamples : 1)), hi = 1.0 - lo;
+  double u = synth_unit(synth_hash(c->seed, i, 1));
+  double a = c->sfs_exp;
+  if (fabs(a - 1.0) < 1e-9) *af = lo * pow(hi / lo, u);
+  else {
+    double e = 1.0 - a;
+    *af = pow(pow(lo, e) + u * (pow(hi, e) - pow(lo, e)), 1.0 / e);
+  }
+  return vpack64_loc(chrom, pos, ref, alt);
+}
+
+/*
+  @brief
+  Fill latent haplotype values of an LD block, len 2*nsamples
+*/
+static inline void synth_block_latent(const synth_cfg_t* c, uint64_t block, uint32_t* lat) {
+  for (uint32_t h = 0; h < 2 * c->nsamples; h++)
+    lat[h] = (uint32_t)synth_hash(c->seed ^ 0x1d, block, h);
+}
+
+/*
+  @brief
+  Generate sites [first, first+n) into `out`, which must hold `n`
+  sites. Single threaded; see `synth_generate_mt`.
+*/
+static inline void synth_generate(const synth_cfg_t* c, uint64_t first, uint64_t n, vp_mat_t* out) {
+  uint32_t rw = vp_row_words(c->nsamples);
+  uint32_t* lat = (uint32_t*)malloc(2 * (size_t)c->nsamples * sizeof(uint32_t) + 1);
+  uint64_t cur_block = UINT64_MAX;
+  uint32_t ld = c->ld_block ? c->ld_block : 1;
+  out->nsamples = c->nsamples;
+  out->nsites = n;
+  for (uint64_t k = 0; k < n; k++) {
+    uint64_t i = first + k;
+    double af;
+    vpack64_t site = synth_site(c, i, &af);
+    out->sites[k] = site;
+    uint64_t b = i / ld;
+    if (b != cur_block) {
+      synth_block_latent(c, b, lat);
+      cur_block = b;
+    }
+    uint64_t sh = synth_hash(c->seed, i, 2);
+    int follow = synth_unit(sh) < c->ld_r;
+    uint32_t salt = (uint32_t)(sh >> 32);
+    uint32_t thr = af >= 1.0 ? UINT32_MAX : (uint32_t)(af * 4294967296.0);
+    uint64_t refc = (site >> 2) & 3, altc = site & 3;
+    vpack64_t* row = out->gts + k * rw;
+    for (uint32_t w = 0; w < rw; w++) {
+      uint32_t s0 = w * VP_GT_PER_WORD;
+      uint32_t s1 = s0 + VP_GT_PER_WORD < c->nsamples ? s0 + VP_GT_PER_WORD : c->nsamples;
+      vpack64_t v = 0;
+      for (uint32_t s = s0; s < s1; s++) {
+        for (int a = 0; a < 2; a++) {
+          uint32_t x = lat[2 * s + a];
+          if (!follow) x = (uint32_t)vp_hash64((uint64_t)x ^ ((uint64_t)salt << 32));
+          v = (v << 2) | (x < thr ? altc : refc);
+        }
+      }
+      row[w] = v;
+    }
+  }
+  free(lat);
+}
+
+typedef struct
+{
+  const synth_cfg_t* c;
+  uint64_t first;
+  uint64_t n;
+  vp_mat_t out;
+} _synth_job_t;
+
+static inline void* _synth_worker(void* arg) {
+  _synth_job_t* j = (_synth_job_t*)arg;
+  synth_generate(j->c, j->first, j->n, &j->out);
+  return NULL;
+}
+
+/*
+  @brief
+  Generate sites [first, first+n) into `out` using `c->threads`
+  threads. Output is identical to `synth_generate`.
+*/
+static inline void synth_generate_mt(const synth_cfg_t* c, uint64_t first, uint64_t n, vp_mat_t* out) {
+  uint32_t nt = c->threads ? c->threads : 1;
+  if (nt > n) nt = n ? (uint32_t)n : 1;
+  if (nt == 1) {
+    synth_generate(c, first, n, out);
+    return;
+  }
+  uint32_t rw = vp_row_words(c->nsamples);
+  pthread_t* th = (pthread_t*)malloc(nt * sizeof(pthread_t));
+  _synth_job_t* jobs = (_synth_job_t*)malloc(nt * sizeof(_synth_job_t));
+  for (uint32_t t = 0; t < nt; t++) {
+    uint64_t a = n * t / nt, b = n * (t + 1) / nt;
+    jobs[t] = (_synth_job_t){c, first + a, b - a, {out->sites + a, out->gts + a * rw, 0, 0}};
+    pthread_create(&th[t], NULL, _synth_worker, &jobs[t]);
+  }
+  for (uint32_t t = 0; t < nt; t++) pthread_join(th[t], NULL);
+  out->nsamples = c->nsamples;
+  out->nsites = n;
+  free(th);
+  free(jobs);
+}
+
+/*
+  @brief
+  Emit `snvpack64` words for one sample from a generated chunk.
+  Missing and phased GTs are drawn per (site, sample) from the
+  config. Sites where the sample is hom-ref are skipped when
+  `nonref_only` is set.
+
+  @param c           config used to generate `m`
+  @param m           generated chunk
+  @param first       index of the chunk's first site
+  @param sample      sample index
+  @param nonref_only skip hom-ref GTs
+  @param out         output words, len >= m->nsites
+
+  @returns number of words written
+*/
+static inline size_t synth_emit_snv(const synth_cfg_t* c, const vp_mat_t* m, uint64_t first,
+                                     uint32_t sample, int nonref_only, vpack64_t* out) {
+  size_t n = 0;
+  uint32_t w = sample / VP_GT_PER_WORD;
+  uint32_t in_word = (w + 1) * VP_GT_PER_WORD <= m->nsamples ? VP_GT_PER_WORD : m->nsamples % VP_GT_PER_WORD;
+  uint32_t shift = 4 * (in_word - 1 - sample % VP_GT_PER_WORD);
+  for (size_t i = 0; i < m->nsites; i++) {
+    vpack64_t site = m->sites[i];
+    uint64_t g = (vp_mat_row(m, i)[w] >> shift) & 0xf;
+    uint64_t altc = site & 3;
+    uint8_t gt[3] = {((g >> 2) & 3) == altc ? '1' : '0', '/', (g & 3) == altc ? '1' : '0'};
+    if (nonref_only && gt[0] == '0' && gt[2] == '0') continue;
+    uint64_t h = synth_hash(c->seed ^ 0x5a, first + i, sample);
+    if (synth_unit(h) < c->missing) gt[0] = gt[2] = '.';
+    else if (synth_unit(vp_hash64(h)) < c->phased) gt[1] = '|';
+    uint8_t ref = dec_dna_8[(site >> 2) & 3], alt = dec_dna_8[site & 3];
+    out[n++] = snvpack64(sample, (uint32_t)((site >> 32) & VMASK_5), (uint32_t)((site >> 4) & VMASK_28), ref, alt, gt);
+  }
+  return n;
+}
+
+#endif /* VPACK_SYNTH_H */
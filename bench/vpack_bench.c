@@ -0,0 +1,519 @@
+/*
+  vpack_bench - microbenchmarks for the vpack pack/unpack primitives
+
+  Build:  cc -O2 -march=native -I.. vpack_bench.c -o vpack_bench -lm
+  Usage:  vpack_bench [--json FILE] [--filter NAME] [--reps N] [--n N] [--perf]
+
+  --perf adds hardware counters (IPC, branch and cache misses) on
+  Linux when perf events are permitted, and is ignored otherwise.
+
+  The `k_*` benchmarks run the dispatched kernels of `vp_cpu()`; set
+  VPACK_CPU_LEVEL to compare levels on one machine.
+
+  Copyright (C) 2025 Jacob Bierstedt
+  Licensed under the GNU GPL v3 or later, see ../LICENSE
+*/
+#include "bench.h"
+#include "../vpack.h"
+
+/* Input distributions for genotypes */
+enum { DIST_UNIFORM, DIST_HOMREF, DIST_MISSING, NDIST };
+static const char* dist_names[NDIST] = {"uniform", "homref", "missing"};
+
+static const char* gt_uniform[5] = {"0/0", "0/1", "1/1", "./.", "0|1"};
+static const char bases[4] = {'A', 'C', 'G', 'T'};
+
+typedef struct
+{
+  size_t n;
+  uint32_t* sample;
+  uint32_t* chrom;
+  uint32_t* pos;
+  uint8_t* ref;
+  uint8_t* alt;
+  uint8_t* gt;         // n * 3
+  vpack64_t* words;    // snvpack64 words
+  vpack64_t* gt9;      // 9-bit GTs
+  uint8_t* alleles;    // n * 2, for vpack_rec
+  uint8_t* codes;      // n * 2 allele codes, for the pack kernel
+  vpack64_t* out;      // n words of kernel output
+  vpack64_t* loc;      // vpack64_loc words, unsorted
+  vpack64_t* recs;     // n / 16 packed rows words
+  uint32_t nrecs;
+} input_t;
+
+static const char* pick_gt(vp_rng_t* rng, int dist) {
+  double u = vp_rng_unit(rng);
+  switch (dist) {
+  case DIST_HOMREF:  return u < 0.95 ? "0/0" : gt_uniform[vp_rng_bounded(rng, 5)];
+  case DIST_MISSING: return u < 0.20 ? "./." : gt_uniform[vp_rng_bounded(rng, 5)];
+  default:           return gt_uniform[vp_rng_bounded(rng, 5)];
+  }
+}
+
+static void input_make(input_t* in, size_t n, int dist, uint64_t seed) {
+  vp_rng_t rng = vp_rng_init(seed);
+  n &= ~(size_t)15;
+  in->n = n;
+  in->sample = malloc(n * sizeof(uint32_t));
+  in->chrom = malloc(n * sizeof(uint32_t));
+  in->pos = malloc(n * sizeof(uint32_t));
+  in->ref = malloc(n);
+  in->alt = malloc(n);
+  in->gt = malloc(n * 3);
+  in->words = malloc(n * sizeof(vpack64_t));
+  in->gt9 = malloc(n * sizeof(vpack64_t));
+  in->alleles = malloc(n * 2);
+  in->codes = malloc(n * 2);
+  in->out = malloc(n * sizeof(vpack64_t));
+  in->loc = malloc(n * sizeof(vpack64_t));
+  in->nrecs = (uint32_t)(n / VP_GT_PER_WORD);
+  in->recs = malloc(in->nrecs * sizeof(vpack64_t));
+  for (size_t i = 0; i < n; i++) {
+    in->sample[i] = (uint32_t)vp_rng_bounded(&rng, 1u << 17);
+    in->chrom[i] = 1 + (uint32_t)vp_rng_bounded(&rng, 22);
+    in->pos[i] = (uint32_t)vp_rng_bounded(&rng, 250000000);
+    in->ref[i] = bases[vp_rng_bounded(&rng, 4)];
+    in->alt[i] = bases[vp_rng_bounded(&rng, 4)];
+    memcpy(in->gt + 3 * i, pick_gt(&rng, dist), 3);
+    in->words[i] = snvpack64(in->sample[i], in->chrom[i], in->pos[i], in->ref[i], in->alt[i], in->gt + 3 * i);
+    in->loc[i] = vpack64_loc(in->chrom[i], in->pos[i], in->ref[i], in->alt[i]);
+    in->gt9[i] = 0;
+    vpack_gt9(&in->gt9[i], in->gt + 3 * i);
+    for (int k = 0; k < 2; k++) {
+      int homref = dist == DIST_HOMREF && vp_rng_unit(&rng) < 0.95;
+      in->alleles[2 * i + k] = homref ? 'A' : bases[vp_rng_bounded(&rng, 4)];
+      in->codes[2 * i + k] = ENCODE(in->alleles[2 * i + k]);
+    }
+  }
+  for (uint32_t r = 0; r < in->nrecs; r++) {
+    vpack_rec1_t rec = vpack_rec1_t_init();
+    for (int k = 0; k < VP_GT_PER_WORD; k++) {
+      const uint8_t* a = in->alleles + 2 * (r * VP_GT_PER_WORD + k);
+      vpack_rec(&rec, a[0], a[1]);
+    }
+    in->recs[r] = rec.v;
+  }
+}
+
+static void input_free(input_t* in) {
+  free(in->sample); free(in->chrom); free(in->pos); free(in->ref); free(in->alt);
+  free(in->gt); free(in->words); free(in->gt9); free(in->alleles); free(in->recs);
+  free(in->codes); free(in->out); free(in->loc);
+}
+
+static void b_snvpack64(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  uint64_t acc = 0;
+  for (uint64_t it = 0; it < iters; it++)
+    for (size_t i = 0; i < in->n; i++)
+      acc ^= snvpack64(in->sample[i], in->chrom[i], in->pos[i], in->ref[i], in->alt[i], in->gt + 3 * i);
+  bench_sink = acc;
+}
+
+static void b_snvunpack64(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  uint64_t acc = 0;
+  for (uint64_t it = 0; it < iters; it++) {
+    for (size_t i = 0; i < in->n; i++) {
+      vpack64_t v = in->words[i];
+      uint32_t s, c, p;
+      uint8_t ref, alt, gt[3];
+      snvunpack64(&v, &s, &c, &p, &ref, &alt, gt);
+      acc += s + c + p + ref + alt + gt[0] + gt[2];
+    }
+  }
+  bench_sink = acc;
+}
+
+static void b_vpack_gt9(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  uint64_t acc = 0;
+  for (uint64_t it = 0; it < iters; it++) {
+    for (size_t i = 0; i < in->n; i++) {
+      vpack64_t v = 0;
+      vpack_gt9(&v, in->gt + 3 * i);
+      acc ^= v + i;
+    }
+  }
+  bench_sink = acc;
+}
+
+/*
+  Table-driven GT packing, for comparison with the `switch` in
+  `vpack_gt9`. Unknown characters map to 0, as in the switch.
+*/
+static uint8_t gt9_lut[256];
+static const uint8_t gt9_dec[8] = {'0', '1', '.', '/', '|', '0', '0', '0'};
+
+static void gt9_lut_init(void) {
+  gt9_lut['0'] = 0; gt9_lut['1'] = 1; gt9_lut['.'] = 2; gt9_lut['/'] = 3; gt9_lut['|'] = 4;
+}
+
+static void b_vpack_gt9_lut(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  uint64_t acc = 0;
+  for (uint64_t it = 0; it < iters; it++) {
+    for (size_t i = 0; i < in->n; i++) {
+      const uint8_t* g = in->gt + 3 * i;
+      vpack64_t v = ((vpack64_t)gt9_lut[g[0]] << 6) | ((vpack64_t)gt9_lut[g[1]] << 3) | gt9_lut[g[2]];
+      acc ^= v + i;
+    }
+  }
+  bench_sink = acc;
+}
+
+static void b_vunpack_gt9_lut(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  uint64_t acc = 0;
+  for (uint64_t it = 0; it < iters; it++) {
+    for (size_t i = 0; i < in->n; i++) {
+      vpack64_t v = in->gt9[i];
+      uint8_t gt[3] = {gt9_dec[(v >> 6) & 7], gt9_dec[(v >> 3) & 7], gt9_dec[v & 7]};
+      acc += gt[0] + gt[1] + gt[2];
+    }
+  }
+  bench_sink = acc;
+}
+
+static void b_vunpack_gt9(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  uint64_t acc = 0;
+  for (uint64_t it = 0; it < iters; it++) {
+    for (size_t i = 0; i < in->n; i++) {
+      vpack64_t v = in->gt9[i];
+      uint8_t gt[3];
+      vunpack_gt9(&v, gt);
+      acc += gt[0] + gt[1] + gt[2];
+    }
+  }
+  bench_sink = acc;
+}
+
+static void b_vpack64_loc(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  uint64_t acc = 0;
+  for (uint64_t it = 0; it < iters; it++)
+    for (size_t i = 0; i < in->n; i++)
+      acc ^= vpack64_loc(in->chrom[i], in->pos[i], in->ref[i], in->alt[i]);
+  bench_sink = acc;
+}
+
+static void b_vpack_rec(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  uint64_t acc = 0;
+  for (uint64_t it = 0; it < iters; it++) {
+    for (uint32_t r = 0; r < in->nrecs; r++) {
+      vpack_rec1_t rec = vpack_rec1_t_init();
+      const uint8_t* a = in->alleles + 2 * r * VP_GT_PER_WORD;
+      for (int k = 0; k < VP_GT_PER_WORD; k++) vpack_rec(&rec, a[2 * k], a[2 * k + 1]);
+      acc ^= rec.v;
+    }
+  }
+  bench_sink = acc;
+}
+
+static void b_vunpack_rec(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  uint64_t acc = 0;
+  for (uint64_t it = 0; it < iters; it++) {
+    for (uint32_t r = 0; r < in->nrecs; r++) {
+      vpack_rec1_t rec = vpack_rec1_load(in->recs[r], VP_GT_PER_WORD);
+      vunpack_rec(&rec);
+      acc += rec.gt[0] + rec.gt[31];
+    }
+  }
+  bench_sink = acc;
+}
+
+static void b_vp_row_count(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  uint64_t acc = 0;
+  /* treat the packed words as one row of nrecs * 16 samples */
+  for (uint64_t it = 0; it < iters; it++)
+    acc += vp_row_count(in->recs, in->nrecs * VP_GT_PER_WORD, (uint32_t)(it & 3));
+  bench_sink = acc;
+}
+
+/* Dispatched kernels: the input is one row of nrecs * 16 samples */
+static void b_k_pack(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  vp_pack_fn pack = vp_cpu()->pack;
+  for (uint64_t it = 0; it < iters; it++) pack(in->codes, in->nrecs * VP_GT_PER_WORD, in->out);
+  bench_sink = in->out[0];
+}
+
+static void b_k_unpack(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  vp_unpack_fn unpack = vp_cpu()->unpack;
+  uint8_t* codes = (uint8_t*)in->out;
+  for (uint64_t it = 0; it < iters; it++) unpack(in->recs, in->nrecs * VP_GT_PER_WORD, codes);
+  bench_sink = codes[0];
+}
+
+static void b_k_count(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  vp_count_fn count = vp_cpu()->count;
+  uint64_t acc = 0;
+  for (uint64_t it = 0; it < iters; it++) acc += count(in->recs, in->nrecs * VP_GT_PER_WORD, (uint32_t)(it & 3));
+  bench_sink = acc;
+}
+
+static void b_k_filter(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  vp_filter_fn filter = vp_cpu()->filter;
+  uint64_t acc = 0;
+  for (uint64_t it = 0; it < iters; it++) acc += filter(in->words, in->n, in->out);
+  bench_sink = acc;
+}
+
+static void b_k_crc32c(void* ctx, uint64_t iters) {
+  input_t* in = ctx;
+  vp_crc_fn crc32c = vp_cpu()->crc32c;
+  uint32_t acc = 0;
+  for (uint64_t it = 0; it < iters; it++) acc = crc32c(acc, in->words, in->n * sizeof(vpack64_t));
+  bench_sink = acc;
+}
+
+/*
+  Sort benchmarks get their own input, sized by --sort-n, so they can
+  run at cohort scale without the per-kernel arrays. Key-value cases
+  carry one-word rows (16 samples).
+*/
+typedef struct
+{
+  size_t n;
+  vpack64_t* loc;      // vpack64_loc words, unsorted
+  vpack64_t* out;      // keys being sorted
+  vpack64_t* rows;     // n rows, unsorted; NULL above VP_SORT_MAX_ROWS
+  vpack64_t* rows_out; // rows being sorted
+} sort_input_t;
+
+#define KV_SAMPLES VP_GT_PER_WORD
+
+static void sort_input_make(sort_input_t* in, size_t n, uint64_t seed) {
+  vp_rng_t rng = vp_rng_init(seed);
+  in->n = n;
+  in->loc = malloc(n * sizeof(vpack64_t));
+  in->out = malloc(n * sizeof(vpack64_t));
+  /* key-value mode is limited to VP_SORT_MAX_ROWS sites */
+  int kv = n <= VP_SORT_MAX_ROWS;
+  in->rows = kv ? malloc(n * sizeof(vpack64_t)) : NULL;
+  in->rows_out = kv ? malloc(n * sizeof(vpack64_t)) : NULL;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t chrom = 1 + (uint32_t)vp_rng_bounded(&rng, 22), pos = (uint32_t)vp_rng_bounded(&rng, 250000000);
+    in->loc[i] = vpack64_loc(chrom, pos, bases[vp_rng_bounded(&rng, 4)], bases[vp_rng_bounded(&rng, 4)]);
+    if (kv) in->rows[i] = vp_rng_next(&rng);
+  }
+}
+
+static void sort_input_free(sort_input_t* in) {
+  free(in->loc); free(in->out); free(in->rows); free(in->rows_out);
+}
+
+static void b_sort_loc(void* ctx, uint64_t iters) {
+  sort_input_t* in = ctx;
+  for (uint64_t it = 0; it < iters; it++) {
+    memcpy(in->out, in->loc, in->n * sizeof(vpack64_t));
+    vp_sort_loc(in->out, NULL, 0, in->n);
+  }
+  bench_sink = in->out[in->n / 2];
+}
+
+static void b_sort_loc_kv(void* ctx, uint64_t iters) {
+  sort_input_t* in = ctx;
+  for (uint64_t it = 0; it < iters; it++) {
+    memcpy(in->out, in->loc, in->n * sizeof(vpack64_t));
+    memcpy(in->rows_out, in->rows, in->n * sizeof(vpack64_t));
+    vp_sort_loc(in->out, in->rows_out, KV_SAMPLES, in->n);
+  }
+  bench_sink = in->rows_out[in->n / 2];
+}
+
+/*
+  Introsort with the comparison inlined: the algorithm of std::sort
+  (median-of-3 quicksort, heapsort past 2 log2(n) levels, insertion
+  sort below 16), as the comparison-sort baseline qsort's indirect
+  calls would understate.
+*/
+static inline void isort_insertion(uint64_t* v, size_t n) {
+  for (size_t i = 1; i < n; i++) {
+    uint64_t x = v[i];
+    size_t j = i;
+    for (; j && v[j - 1] > x; j--) v[j] = v[j - 1];
+    v[j] = x;
+  }
+}
+
+static inline void isort_sift(uint64_t* v, size_t i, size_t n) {
+  uint64_t x = v[i];
+  for (size_t c; (c = 2 * i + 1) < n; i = c) {
+    if (c + 1 < n && v[c + 1] > v[c]) c++;
+    if (v[c] <= x) break;
+    v[i] = v[c];
+  }
+  v[i] = x;
+}
+
+static void isort_heap(uint64_t* v, size_t n) {
+  for (size_t i = n / 2; i-- > 0;) isort_sift(v, i, n);
+  for (size_t i = n; i-- > 1;) {
+    uint64_t t = v[0];
+    v[0] = v[i];
+    v[i] = t;
+    isort_sift(v, 0, i);
+  }
+}
+
+static void isort_rec(uint64_t* v, size_t n, int depth) {
+  while (n > 16) {
+    if (!depth--) {
+      isort_heap(v, n);
+      return;
+    }
+    uint64_t a = v[0], b = v[n / 2], c = v[n - 1];
+    uint64_t p = a < b ? (b < c ? b : a < c ? c : a) : (a < c ? a : b < c ? c : b);
+    size_t i = 0, j = n - 1;
+    for (;;) {
+      while (v[i] < p) i++;
+      while (v[j] > p) j--;
+      if (i >= j) break;
+      uint64_t t = v[i];
+      v[i++] = v[j];
+      v[j--] = t;
+    }
+    /* recurse into the smaller side, loop on the larger */
+    if (j + 1 < n - j - 1) {
+      isort_rec(v, j + 1, depth);
+      v += j + 1;
+      n -= j + 1;
+    } else {
+      isort_rec(v + j + 1, n - j - 1, depth);
+      n = j + 1;
+    }
+  }
+  isort_insertion(v, n);
+}
+
+static void introsort_u64(uint64_t* v, size_t n) {
+  int depth = 0;
+  for (size_t k = n; k > 1; k >>= 1) depth += 2;
+  isort_rec(v, n, depth);
+}
+
+/* comparison-sort baseline for sort_loc */
+static void b_introsort_loc(void* ctx, uint64_t iters) {
+  sort_input_t* in = ctx;
+  for (uint64_t it = 0; it < iters; it++) {
+    memcpy(in->out, in->loc, in->n * sizeof(vpack64_t));
+    introsort_u64(in->out, in->n);
+  }
+  bench_sink = in->out[in->n / 2];
+}
+
+/*
+  Baseline for sort_loc_kv: sort (locus, index) keys, as a stable
+  comparison sort of sites would, then gather the rows
+*/
+static void b_introsort_loc_kv(void* ctx, uint64_t iters) {
+  sort_input_t* in = ctx;
+  for (uint64_t it = 0; it < iters; it++) {
+    for (size_t i = 0; i < in->n; i++) in->out[i] = (in->loc[i] & VMASK_37) << 27 | i;
+    introsort_u64(in->out, in->n);
+    for (size_t i = 0; i < in->n; i++) {
+      in->rows_out[i] = in->rows[in->out[i] & (VP_SORT_MAX_ROWS - 1)];
+      in->out[i] >>= 27;
+    }
+  }
+  bench_sink = in->rows_out[in->n / 2];
+}
+
+static int loc_cmp(const void* a, const void* b) {
+  vpack64_t x = *(const vpack64_t*)a, y = *(const vpack64_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+/* libc baseline for sort_loc, one indirect call per comparison */
+static void b_qsort_loc(void* ctx, uint64_t iters) {
+  sort_input_t* in = ctx;
+  for (uint64_t it = 0; it < iters; it++) {
+    memcpy(in->out, in->loc, in->n * sizeof(vpack64_t));
+    qsort(in->out, in->n, sizeof(vpack64_t), loc_cmp);
+  }
+  bench_sink = in->out[in->n / 2];
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: vpack_bench [--json FILE] [--filter NAME] [--reps N] [--n N] [--sort-n N] [--perf]\n");
+}
+
+int main(int argc, char** argv) {
+  bench_opts_t o = bench_opts_init();
+  size_t n = 1 << 16, sort_n = 0;
+  bench_perf_t perf;
+  int want_perf = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--json") && i + 1 < argc) {
+      o.json = fopen(argv[++i], "w");
+      if (!o.json) { perror(argv[i]); return 1; }
+    } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) o.filter = argv[++i];
+    else if (!strcmp(argv[i], "--reps") && i + 1 < argc) o.reps = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--n") && i + 1 < argc) n = (size_t)atol(argv[++i]);
+    else if (!strcmp(argv[i], "--sort-n") && i + 1 < argc) sort_n = (size_t)atol(argv[++i]);
+    else if (!strcmp(argv[i], "--perf")) want_perf = 1;
+    else { usage(); return 1; }
+  }
+  if (o.reps < 1 || n < VP_GT_PER_WORD) { usage(); return 1; }
+  if (want_perf) {
+    if (bench_perf_open(&perf) == 0) o.perf = &perf;
+    else fprintf(stderr, "vpack_bench: hardware counters unavailable, timing only\n");
+  }
+  gt9_lut_init();
+  fprintf(stderr, "vpack_bench: kernels at level %s\n", vp_cpu_names[vp_cpu()->level]);
+
+  bench_json_begin(&o);
+  for (int d = 0; d < NDIST; d++) {
+    input_t in;
+    input_make(&in, n, d, 0x5eed + d);
+    const char* dn = dist_names[d];
+    bench_run(&o, "snvpack64",   dn, b_snvpack64,   &in, in.n, in.n * 8, NULL);
+    bench_run(&o, "snvunpack64", dn, b_snvunpack64, &in, in.n, in.n * 8, NULL);
+    bench_run(&o, "vpack_gt9",   dn, b_vpack_gt9,   &in, in.n, in.n * 8, NULL);
+    bench_run(&o, "vunpack_gt9", dn, b_vunpack_gt9, &in, in.n, in.n * 8, NULL);
+    bench_run(&o, "vpack_gt9_lut",   dn, b_vpack_gt9_lut,   &in, in.n, in.n * 8, NULL);
+    bench_run(&o, "vunpack_gt9_lut", dn, b_vunpack_gt9_lut, &in, in.n, in.n * 8, NULL);
+    if (d == DIST_UNIFORM) {
+      bench_run(&o, "vpack64_loc", dn, b_vpack64_loc, &in, in.n, in.n * 8, NULL);
+      bench_run(&o, "k_crc32c",    dn, b_k_crc32c,    &in, in.n, in.n * 8, NULL);
+    }
+    bench_run(&o, "k_filter", dn, b_k_filter, &in, in.n, in.n * 8, NULL);
+    /* genotype rows have no missing state */
+    if (d != DIST_MISSING) {
+      bench_run(&o, "vpack_rec",    dn, b_vpack_rec,    &in, in.n, in.nrecs * 8, NULL);
+      bench_run(&o, "vunpack_rec",  dn, b_vunpack_rec,  &in, in.n, in.nrecs * 8, NULL);
+      bench_run(&o, "vp_row_count", dn, b_vp_row_count, &in, in.n, in.nrecs * 8, NULL);
+      bench_run(&o, "k_pack",       dn, b_k_pack,       &in, in.n, in.nrecs * 8, NULL);
+      bench_run(&o, "k_unpack",     dn, b_k_unpack,     &in, in.n, in.nrecs * 8, NULL);
+      bench_run(&o, "k_count",      dn, b_k_count,      &in, in.n, in.nrecs * 8, NULL);
+    }
+    input_free(&in);
+  }
+  /* the sort input is only built when a sort benchmark passes the filter */
+  if (!o.filter || strstr("sort_loc_kv introsort_loc_kv qsort_loc", o.filter)) {
+    sort_input_t si;
+    sort_input_make(&si, sort_n ? sort_n : n, 0x5eed);
+    const char* dn = dist_names[DIST_UNIFORM];
+    bench_run(&o, "sort_loc",      dn, b_sort_loc,      &si, si.n, si.n * 8, NULL);
+    bench_run(&o, "introsort_loc", dn, b_introsort_loc, &si, si.n, si.n * 8, NULL);
+    bench_run(&o, "qsort_loc",     dn, b_qsort_loc,     &si, si.n, si.n * 8, NULL);
+    if (si.rows) {
+      bench_run(&o, "sort_loc_kv",      dn, b_sort_loc_kv,      &si, si.n, si.n * 16, NULL);
+      bench_run(&o, "introsort_loc_kv", dn, b_introsort_loc_kv, &si, si.n, si.n * 16, NULL);
+    }
+    sort_input_free(&si);
+  }
+  bench_json_end(&o);
+  if (o.json) fclose(o.json);
+  if (o.perf) bench_perf_close(o.perf);
+  return 0;
+}
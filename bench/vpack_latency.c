@@ -0,0 +1,362 @@
+/*
+  vpack_latency - query latency harness with stored baselines
+
+  Replays a query trace against a container and records one HDR
+  histogram per query kind:
+
+    point    sites at one position
+    region   sites in [start, end)
+    carrier  samples carrying the alt allele at one position
+
+  Traces are text, one query per line, positions 1-based as in VCF:
+
+    P <chrom> <pos>
+    R <chrom> <start> <end>
+    C <chrom> <pos>
+
+  Without --replay a synthetic trace is drawn from the container's own
+  sites with the --mix percentages; --record saves it for replay. With
+  --baseline, p50/p90/p99/p99.9 are compared to a saved baseline and
+  the exit status is 3 when any of them regressed by more than the
+  tolerance and by more than --min-delta. The delta is never below one
+  histogram bucket width at the baseline value (about 3%), so bucket
+  rounding alone cannot flag a regression.
+
+  Build:  cc -O2 -march=native -I.. vpack_latency.c -o vpack_latency -lm -lpthread
+  Usage:  vpack_latency [-i FILE | -n SAMPLES -m SITES] [-q QUERIES] [-s SEED]
+                        [--mix P,R,C] [-L REGION_BP] [--cold]
+                        [--replay FILE] [--record FILE]
+                        [--save FILE] [--baseline FILE] [--tolerance FRAC]
+                        [--min-delta NS] [--metrics FILE]
+
+  Copyright (C) 2025 Jacob Bierstedt
+  Licensed under the GNU GPL v3 or later, see ../LICENSE
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include "synth.h"
+
+enum { Q_POINT, Q_REGION, Q_CARRIER, NKIND };
+static const char* kind_names[NKIND] = {"point", "region", "carrier"};
+static const char kind_tags[NKIND] = {'P', 'R', 'C'};
+
+#define NQUANT 4
+static const double quants[NQUANT] = {0.5, 0.9, 0.99, 0.999};
+static const char* quant_names[NQUANT] = {"p50", "p90", "p99", "p999"};
+
+typedef struct
+{
+  uint8_t kind;
+  vpack64_t lo;       // locus key, pos << 4
+  vpack64_t hi;       // exclusive
+} query_t;
+
+typedef struct
+{
+  uint64_t b[VP_HIST_BUCKETS];
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+} hist_t;
+
+typedef struct
+{
+  int have[NKIND];
+  uint64_t q[NKIND][NQUANT];
+} baseline_t;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void hist_add(hist_t* h, uint64_t ns) {
+  h->b[vp_hist_bucket(ns)]++;
+  h->count++;
+  h->sum += ns;
+  if (ns > h->max) h->max = ns;
+}
+
+/* Quantile as a bucket upper bound, clamped to the largest value recorded */
+static uint64_t hist_quantile(const hist_t* h, double q) {
+  uint64_t v = vp_hist_quantile(h->b, h->count, q);
+  return v < h->max ? v : h->max;
+}
+
+/* Width of the histogram bucket holding `v` */
+static uint64_t bucket_width(uint64_t v) {
+  uint32_t i = vp_hist_bucket(v);
+  return i < (1u << VP_HIST_SUB) ? 1 : vp_hist_bucket_max(i) - vp_hist_bucket_max(i - 1);
+}
+
+static vpack64_t locus_key(uint32_t chrom, uint32_t pos) {
+  return ((vpack64_t)(chrom & VMASK_5) << 32) | ((vpack64_t)(pos & VMASK_28) << 4);
+}
+
+/* First index in a sorted block with site >= key */
+static size_t lower_bound(const vp_mat_t* m, vpack64_t key) {
+  size_t lo = 0, hi = m->nsites;
+  while (lo < hi) {
+    size_t mid = (lo + hi) >> 1;
+    if (m->sites[mid] < key) lo = mid + 1; else hi = mid;
+  }
+  return lo;
+}
+
+/*
+  Run one query. Every kind resolves its first block through the
+  block index and scans forward while blocks overlap [lo, hi).
+*/
+static int run_query(vp_reader_t* r, const query_t* q, uint64_t* out) {
+  uint64_t n = 0;
+  /* point lookups skip absent positions with the footer Bloom filters */
+  if (q->kind != Q_REGION && !vp_reader_may_contain(r, q->lo)) return 0;
+  for (uint64_t bi = vp_reader_find(r, q->lo); bi < r->nblocks && r->blocks[bi].first < q->hi; bi++) {
+    const vp_mat_t* m;
+    int rc = vp_reader_read(r, bi, &m);
+    if (rc) return rc;
+    for (size_t i = lower_bound(m, q->lo); i < m->nsites && m->sites[i] < q->hi; i++)
+      n += q->kind == Q_CARRIER ? vp_row_carriers(vp_mat_row(m, i), m->nsamples, (uint32_t)(m->sites[i] & 3)) : 1;
+  }
+  *out += n;
+  return 0;
+}
+
+#define SYNTH_MAX_MISSES 1000  // consecutive unreadable or empty blocks before giving up
+
+/* Draw a synthetic trace from sites present in the container, NULL if none can be read */
+static query_t* synth_trace(vp_reader_t* r, uint64_t nq, const int* mix, uint32_t region_bp, uint64_t seed) {
+  if (!r->nblocks) return NULL;
+  query_t* qs = malloc((nq ? nq : 1) * sizeof(query_t));
+  vp_rng_t rng = vp_rng_init(seed);
+  int total = mix[0] + mix[1] + mix[2];
+  for (uint64_t i = 0, miss = 0; i < nq;) {
+    const vp_mat_t* m;
+    uint64_t bi = vp_rng_bounded(&rng, r->nblocks);
+    if (vp_reader_read(r, bi, &m) || !m->nsites) {
+      if (++miss < SYNTH_MAX_MISSES) continue;
+      free(qs);
+      return NULL;
+    }
+    miss = 0;
+    vpack64_t key = m->sites[vp_rng_bounded(&rng, m->nsites)] & ~0xfULL;
+    int d = (int)vp_rng_bounded(&rng, (uint64_t)total);
+    uint8_t kind = d < mix[0] ? Q_POINT : d < mix[0] + mix[1] ? Q_REGION : Q_CARRIER;
+    vpack64_t hi = key + ((kind == Q_REGION ? (vpack64_t)region_bp : 1) << 4);
+    qs[i++] = (query_t){kind, key, hi};
+  }
+  return qs;
+}
+
+static query_t* read_trace(const char* path, uint64_t* nq) {
+  FILE* fp = fopen(path, "r");
+  if (!fp) { perror(path); exit(1); }
+  size_t cap = 1024, n = 0;
+  query_t* qs = malloc(cap * sizeof(query_t));
+  char line[256];
+  while (fgets(line, sizeof(line), fp)) {
+    char tag;
+    unsigned chrom, a, b = 0;
+    if (line[0] == '#' || line[0] == '\n') continue;
+    int f = sscanf(line, " %c %u %u %u", &tag, &chrom, &a, &b);
+    int k = tag == 'P' ? Q_POINT : tag == 'R' ? Q_REGION : tag == 'C' ? Q_CARRIER : -1;
+    if (k < 0 || f < (k == Q_REGION ? 4 : 3)) {
+      fprintf(stderr, "%s: bad trace line: %s", path, line);
+      exit(1);
+    }
+    if (n == cap) qs = realloc(qs, (cap *= 2) * sizeof(query_t));
+    vpack64_t lo = locus_key(chrom, a);
+    qs[n++] = (query_t){(uint8_t)k, lo, k == Q_REGION ? locus_key(chrom, b) : lo + 16};
+  }
+  fclose(fp);
+  *nq = n;
+  return qs;
+}
+
+static void write_trace(const char* path, const query_t* qs, uint64_t nq) {
+  FILE* fp = fopen(path, "w");
+  if (!fp) { perror(path); exit(1); }
+  fprintf(fp, "# vpack query trace\n");
+  for (uint64_t i = 0; i < nq; i++) {
+    unsigned chrom = (unsigned)((qs[i].lo >> 32) & VMASK_5), pos = (unsigned)((qs[i].lo >> 4) & VMASK_28);
+    if (qs[i].kind == Q_REGION) fprintf(fp, "R %u %u %u\n", chrom, pos, (unsigned)((qs[i].hi >> 4) & VMASK_28));
+    else fprintf(fp, "%c %u %u\n", kind_tags[qs[i].kind], chrom, pos);
+  }
+  fclose(fp);
+}
+
+/*
+  Baselines are text: a comment header, then one line per query kind
+
+    <kind> <count> <p50_ns> <p90_ns> <p99_ns> <p999_ns> <max_ns>
+*/
+static void save_baseline(const char* path, const hist_t* h) {
+  FILE* fp = fopen(path, "w");
+  if (!fp) { perror(path); exit(1); }
+  fprintf(fp, "# vpack_latency baseline v1\n# kind count p50_ns p90_ns p99_ns p999_ns max_ns\n");
+  for (int k = 0; k < NKIND; k++) {
+    if (!h[k].count) continue;
+    fprintf(fp, "%s %llu", kind_names[k], (unsigned long long)h[k].count);
+    for (int j = 0; j < NQUANT; j++)
+      fprintf(fp, " %llu", (unsigned long long)hist_quantile(&h[k], quants[j]));
+    fprintf(fp, " %llu\n", (unsigned long long)h[k].max);
+  }
+  fclose(fp);
+}
+
+static void load_baseline(const char* path, baseline_t* bl) {
+  FILE* fp = fopen(path, "r");
+  if (!fp) { perror(path); exit(1); }
+  memset(bl, 0, sizeof(*bl));
+  char line[256], name[32];
+  while (fgets(line, sizeof(line), fp)) {
+    unsigned long long count, q[NQUANT];
+    if (line[0] == '#') continue;
+    if (sscanf(line, "%31s %llu %llu %llu %llu %llu", name, &count, &q[0], &q[1], &q[2], &q[3]) != 6) continue;
+    for (int k = 0; k < NKIND; k++) {
+      if (strcmp(name, kind_names[k])) continue;
+      bl->have[k] = 1;
+      for (int j = 0; j < NQUANT; j++) bl->q[k][j] = q[j];
+    }
+  }
+  fclose(fp);
+}
+
+/* @returns number of regressed quantiles */
+static int compare_baseline(const baseline_t* bl, const hist_t* h, double tol, uint64_t min_delta) {
+  int bad = 0;
+  printf("\n%-8s %-5s %12s %12s %9s\n", "kind", "quant", "base_us", "now_us", "change");
+  for (int k = 0; k < NKIND; k++) {
+    if (!bl->have[k] || !h[k].count) continue;
+    for (int j = 0; j < NQUANT; j++) {
+      uint64_t base = bl->q[k][j], cur = hist_quantile(&h[k], quants[j]);
+      double change = base ? (double)cur / (double)base - 1.0 : 0.0;
+      int regressed = cur > base && change > tol && cur - base >= min_delta && cur - base > bucket_width(base);
+      bad += regressed;
+      printf("%-8s %-5s %12.3f %12.3f %+8.1f%%%s\n", kind_names[k], quant_names[j], base * 1e-3, cur * 1e-3,
+             100.0 * change, regressed ? "  REGRESSION" : "");
+    }
+  }
+  return bad;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: vpack_latency [-i FILE | -n SAMPLES -m SITES] [-q QUERIES] [-s SEED]\n"
+                  "                     [--mix P,R,C] [-L REGION_BP] [--cold]\n"
+                  "                     [--replay FILE] [--record FILE]\n"
+                  "                     [--save FILE] [--baseline FILE] [--tolerance FRAC]\n"
+                  "                     [--min-delta NS] [--metrics FILE]\n");
+}
+
+int main(int argc, char** argv) {
+  synth_cfg_t cfg = synth_cfg_init(2000, 1000000, 7);
+  const char* input = NULL, *replay = NULL, *record = NULL, *save = NULL, *baseline = NULL;
+  uint64_t nq = 100000, min_delta = 0;
+  int mix[3] = {70, 20, 10}, cold = 0;
+  uint32_t region_bp = 100000;
+  double tol = 0.10;
+  FILE* metrics = NULL;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    if (!strcmp(a, "--cold")) { cold = 1; continue; }
+    if (i + 1 >= argc) { usage(); return 1; }
+    const char* v = argv[++i];
+    if (!strcmp(a, "-i")) input = v;
+    else if (!strcmp(a, "-n")) cfg.nsamples = (uint32_t)atol(v);
+    else if (!strcmp(a, "-m")) cfg.nsites = (uint64_t)atoll(v);
+    else if (!strcmp(a, "-s")) cfg.seed = (uint64_t)atoll(v);
+    else if (!strcmp(a, "-q")) nq = (uint64_t)atoll(v);
+    else if (!strcmp(a, "-L")) region_bp = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--mix")) {
+      if (sscanf(v, "%d,%d,%d", &mix[0], &mix[1], &mix[2]) != 3) { usage(); return 1; }
+    }
+    else if (!strcmp(a, "--replay")) replay = v;
+    else if (!strcmp(a, "--record")) record = v;
+    else if (!strcmp(a, "--save")) save = v;
+    else if (!strcmp(a, "--baseline")) baseline = v;
+    else if (!strcmp(a, "--tolerance")) tol = atof(v);
+    else if (!strcmp(a, "--min-delta")) min_delta = (uint64_t)atoll(v);
+    else if (!strcmp(a, "--metrics")) { if (!(metrics = fopen(v, "w"))) { perror(v); return 1; } }
+    else { usage(); return 1; }
+  }
+  if (mix[0] < 0 || mix[1] < 0 || mix[2] < 0 || mix[0] + mix[1] + mix[2] <= 0) { usage(); return 1; }
+
+  char tmp[64] = "";
+  if (!input) {
+    snprintf(tmp, sizeof(tmp), "/tmp/vpack_latency.%llu.vpk", (unsigned long long)cfg.seed);
+    uint32_t rw = vp_row_words(cfg.nsamples);
+    vp_mat_t m = {malloc(8192 * sizeof(vpack64_t)), malloc((size_t)8192 * rw * sizeof(vpack64_t)), 0, 0};
+    vp_writer_t w;
+    if (vp_writer_open(&w, tmp, cfg.nsamples, 4096)) { perror(tmp); return 1; }
+    for (uint64_t i = 0; i < cfg.nsites; i += 8192) {
+      uint64_t n = cfg.nsites - i < 8192 ? cfg.nsites - i : 8192;
+      synth_generate(&cfg, i, n, &m);
+      for (uint64_t k = 0; k < n; k++) vp_writer_add(&w, m.sites[k], vp_mat_row(&m, k));
+    }
+    vp_writer_close(&w);
+    free(m.sites);
+    free(m.gts);
+    input = tmp;
+  }
+  vp_reader_t r;
+  if (vp_reader_open(&r, input)) { perror(input); return 1; }
+  if (!r.nblocks) { fprintf(stderr, "%s: empty container\n", input); return 1; }
+
+  query_t* qs = replay ? read_trace(replay, &nq) : synth_trace(&r, nq, mix, region_bp, cfg.seed);
+  if (!qs) { fprintf(stderr, "%s: no readable blocks to draw queries from\n", input); return 1; }
+  if (record) write_trace(record, qs, nq);
+
+  /* warm up on a tenth of the trace, untimed */
+  uint64_t sink = 0;
+  for (uint64_t i = 0; i < nq / 10; i++) run_query(&r, &qs[i], &sink);
+
+  hist_t* h = calloc(NKIND, sizeof(hist_t));
+  uint64_t errors = 0;
+  for (uint64_t i = 0; i < nq; i++) {
+    if (cold) vp_reader_trim(&r, -1);
+    uint64_t t0 = now_ns();
+    VP_METRIC_TIMER(m0);
+    int rc = run_query(&r, &qs[i], &sink);
+    VP_METRIC_OBSERVE(VP_H_QUERY_LATENCY, m0);
+    uint64_t dt = now_ns() - t0;
+    if (rc) { errors++; continue; }
+    hist_add(&h[qs[i].kind], dt);
+  }
+
+  printf("%-8s %9s %10s %10s %10s %10s %10s %10s\n", "kind", "count", "mean_us", "p50_us", "p90_us", "p99_us",
+         "p999_us", "max_us");
+  for (int k = 0; k < NKIND; k++) {
+    if (!h[k].count) continue;
+    printf("%-8s %9llu %10.3f", kind_names[k], (unsigned long long)h[k].count, h[k].sum * 1e-3 / h[k].count);
+    for (int j = 0; j < NQUANT; j++) printf(" %10.3f", hist_quantile(&h[k], quants[j]) * 1e-3);
+    printf(" %10.3f\n", h[k].max * 1e-3);
+  }
+  printf("%llu queries, %llu results\n", (unsigned long long)nq, (unsigned long long)sink);
+  if (errors) fprintf(stderr, "vpack_latency: %llu queries failed\n", (unsigned long long)errors);
+
+  int status = 0;
+  if (save) save_baseline(save, h);
+  if (baseline) {
+    baseline_t bl;
+    load_baseline(baseline, &bl);
+    int bad = compare_baseline(&bl, h, tol, min_delta);
+    if (bad) {
+      printf("%d quantile(s) regressed beyond %.1f%%\n", bad, 100.0 * tol);
+      status = 3;
+    }
+  }
+  if (metrics) {
+#ifdef VPACK_METRICS
+    vp_metrics_write(metrics);
+#else
+    fprintf(stderr, "vpack_latency: built without -DVPACK_METRICS, no metrics written\n");
+#endif
+    fclose(metrics);
+  }
+  vp_reader_close(&r);
+  if (tmp[0]) remove(tmp);
+  free(qs);
+  free(h);
+  return status;
+}
@@ -0,0 +1,270 @@
+/*
+  vpack_scale - end-to-end scaling benchmark
+
+  Runs ingestion, a region query mix, AF computation and VCF export
+  over a synthetic cohort at 1..T threads, and reports throughput,
+  parallel efficiency and peak RSS.
+
+  Build:  cc -O2 -march=native -I.. vpack_scale.c -o vpack_scale -lm -lpthread
+  Usage:  vpack_scale [-n SAMPLES] [-m SITES] [-t MAX_THREADS] [-q QUERIES]
+                      [-L REGION_BP] [-d TMPDIR] [--json FILE] [--trace FILE]
+                      [--metrics FILE]
+
+  --trace writes a Chrome trace of the pipeline stages; it needs a
+  build with -DVPACK_TRACE. --metrics writes Prometheus text metrics
+  at exit; it needs a build with -DVPACK_METRICS.
+
+  Copyright (C) 2025 Jacob Bierstedt
+  Licensed under the GNU GPL v3 or later, see ../LICENSE
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include <sys/resource.h>
+#include "synth.h"
+
+#define BLOCK_SITES 4096
+#define CHUNK_SITES 8192
+
+enum { PH_INGEST, PH_QUERY, PH_AF, PH_EXPORT, NPHASE };
+static const char* phase_names[NPHASE] = {"ingest", "query", "af", "export"};
+static const char* phase_units[NPHASE] = {"sites/s", "queries/s", "sites/s", "sites/s"};
+
+typedef struct
+{
+  synth_cfg_t cfg;
+  const char* dir;
+  uint32_t nt;
+  uint64_t queries;
+  uint32_t region_bp;
+  uint64_t work[64];    // per-thread result, keeps work observable
+} ctx_t;
+
+typedef void (*task_fn)(ctx_t* c, uint32_t tid);
+
+typedef struct
+{
+  ctx_t* c;
+  task_fn fn;
+  uint32_t tid;
+} job_t;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static double peak_rss_mb(void) {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (double)ru.ru_maxrss / 1024.0;
+}
+
+static void shard_path(const ctx_t* c, uint32_t tid, char* buf, size_t len) {
+  snprintf(buf, len, "%s/vpack_scale.%u.vpk", c->dir, tid);
+}
+
+static void* job_main(void* arg) {
+  job_t* j = (job_t*)arg;
+  j->fn(j->c, j->tid);
+  return NULL;
+}
+
+static double run_parallel(ctx_t* c, task_fn fn) {
+  pthread_t th[64];
+  job_t jobs[64];
+  double t0 = now();
+  for (uint32_t t = 0; t < c->nt; t++) {
+    jobs[t] = (job_t){c, fn, t};
+    pthread_create(&th[t], NULL, job_main, &jobs[t]);
+  }
+  for (uint32_t t = 0; t < c->nt; t++) pthread_join(th[t], NULL);
+  return now() - t0;
+}
+
+/* Each thread generates and packs its share of sites into its own shard */
+static void task_ingest(ctx_t* c, uint32_t tid) {
+  uint64_t a = c->cfg.nsites * tid / c->nt, b = c->cfg.nsites * (tid + 1) / c->nt;
+  uint32_t rw = vp_row_words(c->cfg.nsamples);
+  vp_mat_t m = {malloc(CHUNK_SITES * sizeof(vpack64_t)), malloc((size_t)CHUNK_SITES * rw * sizeof(vpack64_t)), 0, 0};
+  char path[4096];
+  shard_path(c, tid, path, sizeof(path));
+  vp_writer_t w;
+  if (vp_writer_open(&w, path, c->cfg.nsamples, BLOCK_SITES)) { perror(path); exit(1); }
+  for (uint64_t i = a; i < b; i += CHUNK_SITES) {
+    uint64_t n = b - i < CHUNK_SITES ? b - i : CHUNK_SITES;
+    VP_TRACE_BEGIN(pack);
+    synth_generate(&c->cfg, i, n, &m);
+    VP_TRACE_END(pack);
+    for (uint64_t k = 0; k < n; k++) vp_writer_add(&w, m.sites[k], vp_mat_row(&m, k));
+  }
+  vp_writer_close(&w);
+  c->work[tid] = b - a;
+  free(m.sites);
+  free(m.gts);
+}
+
+/* Sites are contiguous per chromosome, so regions are drawn per shard */
+static void task_query(ctx_t* c, uint32_t tid) {
+  uint64_t q0 = c->queries * tid / c->nt, q1 = c->queries * (tid + 1) / c->nt;
+  vp_reader_t* r = calloc(c->nt, sizeof(vp_reader_t));
+  for (uint32_t s = 0; s < c->nt; s++) {
+    char path[4096];
+    shard_path(c, s, path, sizeof(path));
+    if (vp_reader_open(&r[s], path)) { perror(path); exit(1); }
+  }
+  vp_rng_t rng = vp_rng_init(c->cfg.seed ^ (0x9e37ULL * (tid + 1)));
+  uint64_t hits = 0;
+  for (uint64_t q = q0; q < q1; q++) {
+    vp_reader_t* rd = &r[vp_rng_bounded(&rng, c->nt)];
+    if (!rd->nblocks) continue;
+    VP_METRIC_TIMER(t0);
+    const vp_block_ref_t* b = &rd->blocks[vp_rng_bounded(&rng, rd->nblocks)];
+    vpack64_t lo = b->first + (vp_rng_bounded(&rng, (b->last - b->first) | 1) & ~0xfULL);
+    vpack64_t hi = lo + ((vpack64_t)c->region_bp << 4);
+    for (uint64_t bi = vp_reader_find(rd, lo); bi < rd->nblocks && rd->blocks[bi].first < hi; bi++) {
+      const vp_mat_t* m;
+      if (vp_reader_read(rd, bi, &m)) break;
+      for (size_t i = 0; i < m->nsites; i++) hits += m->sites[i] >= lo && m->sites[i] < hi;
+    }
+    VP_METRIC_OBSERVE(VP_H_QUERY_LATENCY, t0);
+  }
+  for (uint32_t s = 0; s < c->nt; s++) vp_reader_close(&r[s]);
+  free(r);
+  c->work[tid] = hits;
+}
+
+static void task_af(ctx_t* c, uint32_t tid) {
+  char path[4096];
+  shard_path(c, tid, path, sizeof(path));
+  vp_reader_t r;
+  if (vp_reader_open(&r, path)) { perror(path); exit(1); }
+  vp_af_t af = {NULL, 0.0, 0};
+  for (uint64_t b = 0; b < r.nblocks; b++) {
+    const vp_mat_t* m;
+    if (vp_reader_read(&r, b, &m)) break;
+    vp_mat_visit(m, vp_visit_af, &af);
+  }
+  vp_reader_close(&r);
+  c->work[tid] = (uint64_t)af.sum;
+}
+
+/* Format VCF body lines and discard them, timing decode + formatting */
+static void task_export(ctx_t* c, uint32_t tid) {
+  char path[4096];
+  shard_path(c, tid, path, sizeof(path));
+  vp_reader_t r;
+  if (vp_reader_open(&r, path)) { perror(path); exit(1); }
+  FILE* out = fopen("/dev/null", "w");
+  uint32_t ns = c->cfg.nsamples, rw = vp_row_words(ns);
+  char* line = malloc(64 + 4 * (size_t)ns);
+  uint64_t bytes = 0;
+  for (uint64_t b = 0; b < r.nblocks; b++) {
+    const vp_mat_t* m;
+    if (vp_reader_read(&r, b, &m)) break;
+    for (size_t i = 0; i < m->nsites; i++) {
+      vpack64_t s = m->sites[i];
+      uint64_t alt = s & 3;
+      int len = sprintf(line, "%u\t%u\t.\t%c\t%c\t.\t.\t.\tGT", (unsigned)((s >> 32) & VMASK_5),
+                        (unsigned)((s >> 4) & VMASK_28), dec_dna_8[(s >> 2) & 3], dec_dna_8[alt]);
+      const vpack64_t* row = vp_mat_row(m, i);
+      for (uint32_t w = 0; w < rw; w++) {
+        uint32_t k = ns - w * VP_GT_PER_WORD < VP_GT_PER_WORD ? ns - w * VP_GT_PER_WORD : VP_GT_PER_WORD;
+        for (int j = (int)k - 1; j >= 0; j--) {
+          uint64_t g = row[w] >> (4 * j);
+          line[len++] = '\t';
+          line[len++] = ((g >> 2) & 3) == alt ? '1' : '0';
+          line[len++] = '/';
+          line[len++] = (g & 3) == alt ? '1' : '0';
+        }
+      }
+      line[len++] = '\n';
+      fwrite(line, 1, (size_t)len, out);
+      bytes += (uint64_t)len;
+    }
+  }
+  fclose(out);
+  free(line);
+  vp_reader_close(&r);
+  c->work[tid] = bytes;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: vpack_scale [-n SAMPLES] [-m SITES] [-t MAX_THREADS] [-q QUERIES]\n"
+                  "                   [-L REGION_BP] [-d TMPDIR] [--json FILE] [--trace FILE]\n"
+                  "                   [--metrics FILE]\n");
+}
+
+int main(int argc, char** argv) {
+  ctx_t c = {synth_cfg_init(2000, 2000000, 7), "/tmp", 1, 20000, 100000, {0}};
+  uint32_t max_t = 8;
+  FILE* json = NULL;
+  FILE* trace = NULL;
+  FILE* metrics = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) { usage(); return 1; }
+    const char* a = argv[i], *v = argv[++i];
+    if (!strcmp(a, "-n")) c.cfg.nsamples = (uint32_t)atol(v);
+    else if (!strcmp(a, "-m")) c.cfg.nsites = (uint64_t)atoll(v);
+    else if (!strcmp(a, "-t")) max_t = (uint32_t)atoi(v);
+    else if (!strcmp(a, "-q")) c.queries = (uint64_t)atoll(v);
+    else if (!strcmp(a, "-L")) c.region_bp = (uint32_t)atoi(v);
+    else if (!strcmp(a, "-d")) c.dir = v;
+    else if (!strcmp(a, "--json")) { if (!(json = fopen(v, "w"))) { perror(v); return 1; } }
+    else if (!strcmp(a, "--trace")) { if (!(trace = fopen(v, "w"))) { perror(v); return 1; } }
+    else if (!strcmp(a, "--metrics")) { if (!(metrics = fopen(v, "w"))) { perror(v); return 1; } }
+    else { usage(); return 1; }
+  }
+  if (!max_t || max_t > 64 || !c.cfg.nsamples) { usage(); return 1; }
+
+  double base[NPHASE] = {0};
+  if (json) fprintf(json, "{\n  \"samples\": %u, \"sites\": %llu, \"runs\": [\n", c.cfg.nsamples,
+                    (unsigned long long)c.cfg.nsites);
+  printf("%-8s %7s %14s %-10s %10s %10s\n", "phase", "threads", "throughput", "unit", "efficiency", "rss_mb");
+  int first = 1;
+  for (uint32_t t = 1;; t = t * 2 > max_t && t < max_t ? max_t : t * 2) {
+    c.nt = t;
+    task_fn fns[NPHASE] = {task_ingest, task_query, task_af, task_export};
+    for (int p = 0; p < NPHASE; p++) {
+      double dt = run_parallel(&c, fns[p]);
+      double items = p == PH_QUERY ? (double)c.queries : (double)c.cfg.nsites;
+      double thr = items / dt;
+      if (t == 1) base[p] = thr;
+      double eff = thr / (base[p] * t);
+      double rss = peak_rss_mb();
+      printf("%-8s %7u %14.1f %-10s %10.3f %10.1f\n", phase_names[p], t, thr, phase_units[p], eff, rss);
+      if (json)
+        fprintf(json, "%s    {\"phase\": \"%s\", \"threads\": %u, \"seconds\": %.6f, \"throughput\": %.3f, "
+                "\"unit\": \"%s\", \"efficiency\": %.4f, \"peak_rss_mb\": %.1f}",
+                first ? "" : ",\n", phase_names[p], t, dt, thr, phase_units[p], eff, rss);
+      first = 0;
+    }
+    for (uint32_t s = 0; s < t; s++) {
+      char path[4096];
+      shard_path(&c, s, path, sizeof(path));
+      remove(path);
+    }
+    if (t >= max_t) break;
+  }
+  if (json) {
+    fprintf(json, "\n  ]\n}\n");
+    fclose(json);
+  }
+  if (trace) {
+#ifdef VPACK_TRACE
+    vp_trace_dump(trace);
+#else
+    fprintf(stderr, "vpack_scale: built without -DVPACK_TRACE, no trace written\n");
+#endif
+    fclose(trace);
+  }
+  if (metrics) {
+#ifdef VPACK_METRICS
+    vp_metrics_write(metrics);
+#else
+    fprintf(stderr, "vpack_scale: built without -DVPACK_METRICS, no metrics written\n");
+#endif
+    fclose(metrics);
+  }
+  return 0;
+}
@@ -0,0 +1,35 @@
+/*
+  test.h - minimal test helpers for vpack
+
+  Copyright (C) 2025 Jacob Bierstedt
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef VPACK_TEST_H
+#define VPACK_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../vpack.h"
+
+/* Fail the test with the condition's text; tests exit 0 only when every check passed */
+#define CHECK(cond)                                                              \
+  do {                                                                           \
+    if (!(cond)) {                                                               \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      exit(1);                                                                   \
+    }                                                                            \
+  } while (0)
+
+#endif /* VPACK_TEST_H */
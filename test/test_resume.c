@@ -0,0 +1,185 @@
+/*
+  test_resume - resuming an interrupted ingest from its checkpoint
+
+  A child process ingests N records with a checkpoint every few
+  sealed blocks and dies partway with _exit, losing whatever stdio
+  had not flushed. The parent cuts the output at a random byte past
+  the checkpoint, resumes, adds the remaining records and closes. The
+  result must match a clean run byte for byte. Resuming must fail with
+  VP_ECHECKSUM when a sealed block is corrupt, and with -1 when the
+  checkpoint file is missing. In every case the writer must give back
+  all the memory it charged. Needs POSIX (fork, truncate), as resuming
+  does.
+
+  Build:  cc -O2 -I.. test_resume.c -o test_resume -lm
+  Usage:  test_resume [-d TMPDIR] [-s SEED] [-r ROUNDS]
+
+  Copyright (C) 2025 Jacob Bierstedt
+  Licensed under the GNU GPL v3 or later, see ../LICENSE
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "test.h"
+
+#define NSAMPLES    40
+#define NRECORDS    20000
+#define BLOCK_SITES 256
+#define CKPT_EVERY  4
+
+static char ref_path[256], out_path[256], ckpt_path[256];
+
+static void record(uint64_t i, vpack64_t* site, vpack64_t* row) {
+  *site = ((vpack64_t)2 << 32) | ((i * 13 + 5) << 4) | (i & 3);
+  for (uint32_t w = 0; w < vp_row_words(NSAMPLES); w++) row[w] = vp_hash64(i * 7 + w);
+  row[vp_row_words(NSAMPLES) - 1] &= (1ULL << (4 * (NSAMPLES % VP_GT_PER_WORD))) - 1;
+}
+
+/* Add records [from, end), or _exit after record `crash_at` when it comes first */
+static void ingest(vp_writer_t* w, uint64_t from, uint64_t end, uint64_t crash_at) {
+  static uint64_t pos[1];
+  CHECK(!vp_writer_checkpoint_every(w, ckpt_path, CKPT_EVERY, pos, 1));
+  for (uint64_t i = from; i < end; i++) {
+    vpack64_t site, row[8];
+    record(i, &site, row);
+    pos[0] = i + 1;
+    CHECK(!vp_writer_add(w, site, row));
+    if (i == crash_at) _exit(0);
+  }
+  CHECK(!vp_writer_close(w));
+}
+
+static uint64_t mem_used(void) {
+  uint64_t n = 0;
+  for (int s = 0; s < VP_MEM_NSUB; s++) n += vp_mem_used(s);
+  return n;
+}
+
+/* Size of `path`, or -1 */
+static int64_t file_size(const char* path) {
+  FILE* fp = fopen(path, "rb");
+  if (!fp || fseek(fp, 0, SEEK_END)) {
+    if (fp) fclose(fp);
+    return -1;
+  }
+  int64_t n = (int64_t)ftell(fp);
+  fclose(fp);
+  return n;
+}
+
+static int same_file(const char* a, const char* b) {
+  FILE* fa = fopen(a, "rb");
+  FILE* fb = fopen(b, "rb");
+  int same = fa && fb;
+  while (same) {
+    int ca = fgetc(fa), cb = fgetc(fb);
+    same = ca == cb;
+    if (ca == EOF) break;
+  }
+  if (fa) fclose(fa);
+  if (fb) fclose(fb);
+  return same;
+}
+
+/* Run an ingest in a child that dies after record `crash_at` */
+static void crash_run(uint64_t crash_at) {
+  remove(ckpt_path);
+  pid_t pid = fork();
+  CHECK(pid >= 0);
+  if (!pid) {
+    vp_writer_t w;
+    CHECK(!vp_writer_open(&w, out_path, NSAMPLES, BLOCK_SITES));
+    ingest(&w, 0, NRECORDS, crash_at);
+    _exit(1);
+  }
+  int status;
+  CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static vp_ckpt_t read_ckpt(void) {
+  vp_ckpt_t c;
+  FILE* fp = fopen(ckpt_path, "rb");
+  CHECK(fp && fread(&c, sizeof(c), 1, fp) == 1);
+  fclose(fp);
+  return c;
+}
+
+int main(int argc, char** argv) {
+  const char* dir = "/tmp";
+  uint64_t seed = 1;
+  int rounds = 8;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "-d")) dir = argv[i + 1];
+    else if (!strcmp(argv[i], "-s")) seed = (uint64_t)atoll(argv[i + 1]);
+    else if (!strcmp(argv[i], "-r")) rounds = atoi(argv[i + 1]);
+  }
+  snprintf(ref_path, sizeof(ref_path), "%s/test_resume.%ld.ref.vpk", dir, (long)getpid());
+  snprintf(out_path, sizeof(out_path), "%s/test_resume.%ld.vpk", dir, (long)getpid());
+  snprintf(ckpt_path, sizeof(ckpt_path), "%s/test_resume.%ld.ckpt", dir, (long)getpid());
+
+  vp_writer_t w;
+  CHECK(!vp_writer_open(&w, ref_path, NSAMPLES, BLOCK_SITES));
+  ingest(&w, 0, NRECORDS, UINT64_MAX);
+  CHECK(mem_used() == 0);
+
+  /* crash anywhere past the first checkpoint, cut anywhere past it, resume and finish */
+  uint64_t h = seed;
+  for (int k = 0; k < rounds; k++) {
+    uint64_t crash_at = BLOCK_SITES * CKPT_EVERY + (h = vp_hash64(h)) % (NRECORDS - BLOCK_SITES * CKPT_EVERY);
+    crash_run(crash_at);
+    vp_ckpt_t c = read_ckpt();
+    int64_t size = file_size(out_path);
+    CHECK(size >= (int64_t)c.off);
+    int64_t cut = (int64_t)c.off + (int64_t)((h = vp_hash64(h)) % (uint64_t)(size - (int64_t)c.off + 1));
+    CHECK(!truncate(out_path, (off_t)cut));
+
+    uint64_t pos[VP_CKPT_MAX_POS];
+    uint32_t npos;
+    CHECK(!vp_writer_resume(&w, out_path, ckpt_path, pos, &npos));
+    CHECK(npos == 1 && pos[0] % BLOCK_SITES == 0 && pos[0] <= crash_at + 1);
+    ingest(&w, pos[0], NRECORDS, UINT64_MAX);
+    CHECK(same_file(out_path, ref_path));
+    CHECK(mem_used() == 0);
+    printf("crash after record %llu, cut at %lld of %lld bytes, resumed at %llu: same\n",
+           (unsigned long long)crash_at, (long long)cut, (long long)size, (unsigned long long)pos[0]);
+  }
+
+  /*
+    The input ends one record past the checkpoint, so the finished file
+    is shorter than what the interrupted run left: resuming must cut
+    that tail rather than write over its start
+  */
+  uint64_t pos[VP_CKPT_MAX_POS];
+  uint32_t npos;
+  crash_run(BLOCK_SITES * CKPT_EVERY * 2 - 2);
+  int64_t size = file_size(out_path);
+  CHECK(!vp_writer_resume(&w, out_path, ckpt_path, pos, &npos));
+  ingest(&w, pos[0], pos[0] + 1, UINT64_MAX);
+  CHECK(file_size(out_path) < size);
+  CHECK(!vp_writer_open(&w, ref_path, NSAMPLES, BLOCK_SITES));
+  ingest(&w, 0, pos[0] + 1, UINT64_MAX);
+  CHECK(same_file(out_path, ref_path));
+  CHECK(mem_used() == 0);
+
+  /* a sealed block that no longer matches its CRC */
+  crash_run(NRECORDS / 2);
+  vp_ckpt_t c = read_ckpt();
+  FILE* fp = fopen(out_path, "r+b");
+  CHECK(fp && !fseek(fp, (long)c.off - 8, SEEK_SET));
+  int byte = fgetc(fp);
+  CHECK(byte != EOF && !fseek(fp, (long)c.off - 8, SEEK_SET) && fputc(byte ^ 0x10, fp) != EOF);
+  fclose(fp);
+  CHECK(vp_writer_resume(&w, out_path, ckpt_path, pos, &npos) == VP_ECHECKSUM);
+  CHECK(mem_used() == 0);
+
+  /* no checkpoint to resume from */
+  remove(ckpt_path);
+  CHECK(vp_writer_resume(&w, out_path, ckpt_path, pos, &npos) == -1);
+  CHECK(mem_used() == 0);
+
+  remove(ref_path);
+  remove(out_path);
+  printf("test_resume: %d rounds: ok\n", rounds);
+  return 0;
+}
@@ -0,0 +1,164 @@
+/*
+  test_store - concurrent readers against the in-memory store writer
+
+  Reader threads loop over read sections and snapshots while the
+  writer appends, replaces blocks and adds samples. Every row carries
+  a stamp in its first word and the rest is hashed from the site and
+  the stamp, so a reader can check a block it sees in full. Each
+  section is checked twice: on entry, and again after the writer has
+  published and reclaimed a few versions. Nothing the section sees
+  may be freed meanwhile. Built with -fsanitize=thread, an early free
+  is also reported as a race between free() and the reader. At the
+  end no version may wait for readers, and the store must give back
+  every byte it charged to VP_MEM_STORE.
+
+  Build:  cc -O1 -g -fsanitize=thread -DVPACK_THREADS -I.. test_store.c -o test_store -lm -lpthread
+  Usage:  test_store [-t READERS] [-m SITES]
+
+  Copyright (C) 2025 Jacob Bierstedt
+  Licensed under the GNU GPL v3 or later, see ../LICENSE
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <sched.h>
+#include "test.h"
+
+#define NSAMPLES    32       // whole row words, so add_samples keeps old words as they are
+#define BLOCK_SITES 256
+
+static vp_store_t st;
+static int done;
+static uint64_t nbad, nsections, nsnapshots;
+
+static uint64_t row_word(vpack64_t site, uint64_t stamp, uint32_t w) {
+  return w ? vp_hash64(site ^ vp_hash64(stamp + w)) : stamp;
+}
+
+static void fill_row(vpack64_t site, uint64_t stamp, uint32_t lo, uint32_t hi, vpack64_t* row) {
+  for (uint32_t w = lo; w < hi; w++) row[w - lo] = row_word(site, stamp, w);
+}
+
+/* @returns number of problems found in version `v` */
+static uint64_t check_version(const vp_store_ver_t* v) {
+  uint64_t bad = 0, nsites = 0;
+  uint32_t rw = vp_row_words(v->nsamples);
+  vpack64_t prev = 0;
+  for (uint64_t b = 0; b < v->nblocks; b++) {
+    const vp_mat_t* m = v->blocks[b];
+    bad += m->nsamples != v->nsamples || !m->nsites;
+    for (size_t i = 0; i < m->nsites; i++) {
+      const vpack64_t* row = vp_mat_row(m, i);
+      bad += m->sites[i] <= prev;
+      prev = m->sites[i];
+      for (uint32_t w = 1; w < rw; w++) bad += row[w] != row_word(m->sites[i], row[0], w);
+    }
+    nsites += m->nsites;
+  }
+  return bad + (nsites != v->nsites);
+}
+
+/* Give the writer time to publish `n` more versions, or to finish */
+static void wait_epochs(uint64_t e, uint64_t n) {
+  for (int k = 0; k < 1000 && _VP_SC_LOAD(st.epoch) < e + n && !_VP_SC_LOAD(done); k++) sched_yield();
+}
+
+static void* reader_main(void* arg) {
+  (void)arg;
+  vp_store_reader_t rd;
+  CHECK(!vp_store_reader_open(&rd, &st));
+  uint64_t bad = 0;
+  for (uint64_t n = 0; !_VP_SC_LOAD(done); n++) {
+    const vp_store_ver_t* v = vp_store_read_begin(&rd);
+    uint64_t e = _VP_SC_LOAD(st.slots[rd.slot].epoch);
+    bad += check_version(v);
+    wait_epochs(e, 2);
+    bad += _VP_SC_LOAD(st.slots[rd.slot].epoch) != e;
+    bad += check_version(v);
+    vp_store_read_end(&rd);
+    _VP_ADD(nsections, 1);
+    if (n % 8 == 0) {
+      const vp_store_ver_t* s = vp_store_snapshot(&rd);
+      uint64_t nsites = s->nsites, nsamples = s->nsamples;
+      bad += check_version(s);
+      wait_epochs(_VP_SC_LOAD(st.epoch), 2);
+      bad += check_version(s) + (s->nsites != nsites) + (s->nsamples != nsamples);
+      vp_store_snapshot_release(&st, s);
+      _VP_ADD(nsnapshots, 1);
+    }
+  }
+  vp_store_reader_close(&rd);
+  _VP_ADD(nbad, bad);
+  return NULL;
+}
+
+/* Copy block `i` with a new stamp on every row */
+static int restamp(uint64_t i, uint64_t stamp) {
+  const vp_mat_t* o = st.cur->blocks[i];
+  uint32_t rw = vp_row_words(o->nsamples);
+  vp_mat_t m = {malloc(o->nsites * sizeof(vpack64_t)), malloc(o->nsites * rw * sizeof(vpack64_t)), o->nsites,
+                o->nsamples};
+  CHECK(m.sites && m.gts);
+  for (size_t k = 0; k < o->nsites; k++) {
+    m.sites[k] = o->sites[k];
+    fill_row(o->sites[k], stamp, 0, rw, vp_mat_row(&m, k));
+  }
+  int rc = vp_store_replace(&st, i, &m);
+  free(m.sites);
+  free(m.gts);
+  return rc;
+}
+
+/* Seal, then add NSAMPLES samples whose words follow each row's stamp */
+static int widen(void) {
+  CHECK(!vp_store_seal(&st));
+  const vp_store_ver_t* v = st.cur;
+  uint32_t rw = vp_row_words(v->nsamples), rn = vp_row_words(NSAMPLES);
+  vpack64_t* rows = (vpack64_t*)malloc((v->nsites ? v->nsites : 1) * rn * sizeof(vpack64_t));
+  CHECK(rows);
+  vpack64_t* r = rows;
+  for (uint64_t b = 0; b < v->nblocks; b++)
+    for (size_t i = 0; i < v->blocks[b]->nsites; i++, r += rn)
+      fill_row(v->blocks[b]->sites[i], vp_mat_row(v->blocks[b], i)[0], rw, rw + rn, r);
+  int rc = vp_store_add_samples(&st, NSAMPLES, rows);
+  free(rows);
+  return rc;
+}
+
+int main(int argc, char** argv) {
+  uint32_t nreaders = 4;
+  uint64_t nsites = 20000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "-t")) nreaders = (uint32_t)atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "-m")) nsites = (uint64_t)atoll(argv[i + 1]);
+  }
+  if (nreaders < 1 || nreaders > 32) nreaders = 4;
+
+  CHECK(!vp_store_init(&st, NSAMPLES, BLOCK_SITES));
+  pthread_t th[32];
+  for (uint32_t t = 0; t < nreaders; t++) CHECK(!pthread_create(&th[t], NULL, reader_main, NULL));
+
+  vpack64_t row[16];
+  uint64_t stamp = 1;
+  for (uint64_t s = 1; s <= nsites; s++) {
+    vpack64_t site = s << 4;
+    fill_row(site, stamp++, 0, vp_row_words(st.nsamples), row);
+    CHECK(!vp_store_append(&st, site, row));
+    if (s % 97 == 0 && st.cur->nblocks) CHECK(!restamp(vp_hash64(s) % st.cur->nblocks, stamp++));
+    if (s == nsites / 3 || s == 2 * nsites / 3) CHECK(!widen());
+    if (s % 64 == 0) sched_yield();
+  }
+  CHECK(!vp_store_seal(&st));
+  CHECK(st.cur->nsites == nsites && st.cur->nsamples == 3 * NSAMPLES);
+  CHECK(!check_version(st.cur));
+
+  _VP_SC_STORE(done, 1);
+  for (uint32_t t = 0; t < nreaders; t++) pthread_join(th[t], NULL);
+  CHECK(!nbad);
+  CHECK(vp_store_reclaim(&st) == 0);
+  vp_store_free(&st);
+  CHECK(vp_mem_used(VP_MEM_STORE) == 0);
+  CHECK(vp_mem_used(VP_MEM_SCRATCH) == 0);
+  printf("test_store: %u readers, %llu sections, %llu snapshots: ok\n", nreaders, (unsigned long long)nsections,
+         (unsigned long long)nsnapshots);
+  return 0;
+}
@@ -22,7 +22,67 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#define VP_HAVE_MMAP
+#endif
+
+/* fsync, fileno and ftruncate are POSIX, but hidden by strict ISO modes such as -std=c99 */
+#if defined(VP_HAVE_MMAP) && (defined(__APPLE__) || defined(_DEFAULT_SOURCE) || defined(_BSD_SOURCE) || \
+                              defined(_XOPEN_SOURCE) || (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200112L))
+#define VP_HAVE_FSYNC
+#endif
+
+/* 64-bit file offsets: fseeko/ftello where POSIX declares them (with
+   _FILE_OFFSET_BITS=64 on 32-bit hosts), _fseeki64 on Windows, else long */
+static inline int _vp_fseek(FILE* fp, int64_t off, int whence) {
+#if defined(VP_HAVE_FSYNC)
+  return fseeko(fp, (off_t)off, whence);
+#elif defined(_WIN32)
+  return _fseeki64(fp, off, whence);
+#else
+  return fseek(fp, (long)off, whence);
+#endif
+}
+
+static inline int64_t _vp_ftell(FILE* fp) {
+#if defined(VP_HAVE_FSYNC)
+  return (int64_t)ftello(fp);
+#elif defined(_WIN32)
+  return _ftelli64(fp);
+#else
+  return ftell(fp);
+#endif
+}
+
+/* clock_gettime(CLOCK_MONOTONIC), hidden the same way */
+#if defined(VP_HAVE_MMAP) && (defined(__APPLE__) || defined(_DEFAULT_SOURCE) || defined(_BSD_SOURCE) || \
+                              defined(_XOPEN_SOURCE) || (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 199309L))
+#define VP_HAVE_CLOCK
+#endif
+
+/* multi-threaded drivers (parallel merge, sort, region read-ahead) need -DVPACK_THREADS and -pthread */
+#if defined(VPACK_THREADS)
+#include <pthread.h>
+#endif
+
+/* x86-64 kernels for runtime CPU dispatch, see "CPU DISPATCH" */
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(VPACK_NO_DISPATCH)
+#define VP_DISPATCH_X86
+#define _VP_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#if defined(__AVX2__) || defined(__SSE4_2__) || defined(VP_DISPATCH_X86)
+#include <immintrin.h>
+#endif
 
 
 /*
@@ -52,6 +112,7 @@ typedef uint32_t vpidx_t;
 #define _DECODE_8_MASK 0x03
 #define VMASK_28 0x0FFFFFFF
 #define VMASK_5  0x01F
+#define VMASK_37 0x1FFFFFFFFFULL
 
 #ifndef DNA_8
 #define DNA_8
@@ -272,4 +333,6134 @@ static inline int vp_get_genotype(vpack_rec1_t* rec, uint32_t sample_idx, vpack_
   return 0;
 }
 
-#endif /* VPACK_H */
\ No newline at end of file
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             MEMORY ACCOUNTING
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*
+  Every allocation vpack owns goes through `vp_malloc` & co, which
+  charge it to a subsystem and to an optional global budget.
+
+  With a budget set, an allocation that would exceed it fails (the
+  caller sees -1 or VP_ENOMEM) instead of growing RSS. Above the soft
+  limit (`soft_pct` of the budget, default 90%) `vp_mem_pressure()`
+  is true and subsystems degrade on their own: readers drop their
+  other cached blocks before loading a new one, and writers flush
+  early and halve their block buffer, spilling to disk sooner.
+*/
+#if defined(__GNUC__)
+#define VP_SHARED __attribute__((weak))  // one instance across translation units
+#else
+#define VP_SHARED static
+#endif
+
+enum {
+  VP_MEM_CACHE,     // reader block caches
+  VP_MEM_BATCH,     // writer block buffers
+  VP_MEM_INDEX,     // block indexes
+  VP_MEM_SKETCH,    // sketch counters and heaps
+  VP_MEM_SCRATCH,   // temporary work buffers
+  VP_MEM_STORE,     // in-memory store blocks and versions
+  VP_MEM_NSUB
+};
+
+typedef struct
+{
+  uint64_t used[VP_MEM_NSUB];
+  uint64_t total;
+  uint64_t peak;
+  uint64_t budget;     // bytes, 0: unlimited
+  uint64_t denied;     // allocations refused by the budget
+  uint32_t soft_pct;   // pressure threshold, % of budget
+} vp_mem_t;
+
+VP_SHARED vp_mem_t vp_mem = {{0}, 0, 0, 0, 0, 90};
+
+static const char* vp_mem_names[VP_MEM_NSUB] = {"cache", "batch", "index", "sketch", "scratch", "store"};
+
+#if defined(__GNUC__)
+#define _VP_LOAD(x)      __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define _VP_ADD(x, n)    __atomic_add_fetch(&(x), (n), __ATOMIC_RELAXED)
+#define _VP_SUB(x, n)    __atomic_sub_fetch(&(x), (n), __ATOMIC_RELAXED)
+#define _VP_MAX(x, v)                                                                        \
+  do {                                                                                       \
+    uint64_t _m = __atomic_load_n(&(x), __ATOMIC_RELAXED);                                   \
+    while ((v) > _m && !__atomic_compare_exchange_n(&(x), &_m, (v), 1, __ATOMIC_RELAXED,     \
+                                                    __ATOMIC_RELAXED));                      \
+  } while (0)
+#else
+#define _VP_LOAD(x)      (x)
+#define _VP_ADD(x, n)    ((x) += (n))
+#define _VP_SUB(x, n)    ((x) -= (n))
+#define _VP_MAX(x, v)    do { if ((v) > (x)) (x) = (v); } while (0)
+#endif
+
+/* sequentially consistent operations, for lock-free structures */
+#if defined(__GNUC__)
+#define _VP_SC_LOAD(x)     __atomic_load_n(&(x), __ATOMIC_SEQ_CST)
+#define _VP_SC_STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_SEQ_CST)
+#define _VP_CAS(x, e, v)   __atomic_compare_exchange_n(&(x), &(e), (v), 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+#define _VP_XCHG(x, v)     __atomic_exchange_n(&(x), (v), __ATOMIC_SEQ_CST)
+#define _VP_SC_SUB(x, n)   __atomic_sub_fetch(&(x), (n), __ATOMIC_SEQ_CST)
+#else
+/* no atomics: single-threaded use only */
+#define _VP_SC_LOAD(x)     (x)
+#define _VP_SC_STORE(x, v) ((x) = (v))
+#define _VP_CAS(x, e, v)   ((x) == (e) ? ((x) = (v), 1) : ((e) = (x), 0))
+#define _VP_XCHG(x, v)     _vp_xchg_ptr((void**)&(x), (v))
+#define _VP_SC_SUB(x, n)   ((x) -= (n))
+static inline void* _vp_xchg_ptr(void** x, void* v) {
+  void* o = *x;
+  *x = v;
+  return o;
+}
+#endif
+
+/* thread-local storage */
+#if defined(__GNUC__)
+#define _VP_TLS __thread
+#elif defined(__cplusplus)
+#define _VP_TLS thread_local
+#else
+#define _VP_TLS _Thread_local
+#endif
+
+#if defined(__GNUC__)
+#define _VP_CACHELINE __attribute__((aligned(64)))
+#else
+#define _VP_CACHELINE
+#endif
+
+/*
+  @brief
+  Set the global memory budget in bytes (0: unlimited) and the
+  pressure threshold as a percentage of it
+*/
+static inline void vp_mem_set_budget(uint64_t bytes, uint32_t soft_pct) {
+  vp_mem.budget = bytes;
+  vp_mem.soft_pct = soft_pct && soft_pct <= 100 ? soft_pct : 90;
+}
+
+/*
+  @brief
+  Charge `n` bytes to a subsystem
+
+  @returns status  0: success, -1: budget exceeded
+*/
+static inline int vp_mem_reserve(int sub, size_t n) {
+  uint64_t budget = _VP_LOAD(vp_mem.budget);
+  uint64_t total = _VP_ADD(vp_mem.total, n);
+  if (budget && total > budget) {
+    _VP_SUB(vp_mem.total, n);
+    _VP_ADD(vp_mem.denied, 1);
+    return -1;
+  }
+  _VP_ADD(vp_mem.used[sub], n);
+  _VP_MAX(vp_mem.peak, total);
+  return 0;
+}
+
+static inline void vp_mem_release(int sub, size_t n) {
+  _VP_SUB(vp_mem.used[sub], n);
+  _VP_SUB(vp_mem.total, n);
+}
+
+/*
+  @brief
+  True when usage is above the soft limit of the budget
+*/
+static inline int vp_mem_pressure(void) {
+  uint64_t budget = _VP_LOAD(vp_mem.budget);
+  return budget && _VP_LOAD(vp_mem.total) * 100 >= budget * vp_mem.soft_pct;
+}
+
+static inline void* vp_malloc(int sub, size_t n) {
+  if (vp_mem_reserve(sub, n)) return NULL;
+  void* p = malloc(n ? n : 1);
+  if (!p) vp_mem_release(sub, n);
+  return p;
+}
+
+static inline void* vp_calloc(int sub, size_t n, size_t size) {
+  if (vp_mem_reserve(sub, n * size)) return NULL;
+  void* p = calloc(n ? n : 1, size ? size : 1);
+  if (!p) vp_mem_release(sub, n * size);
+  return p;
+}
+
+/*
+  @brief
+  Resize an accounted block. On failure the old block is untouched.
+*/
+static inline void* vp_realloc(int sub, void* p, size_t old, size_t n) {
+  if (n > old && vp_mem_reserve(sub, n - old)) return NULL;
+  void* q = realloc(p, n ? n : 1);
+  if (!q) {
+    if (n > old) vp_mem_release(sub, n - old);
+    return NULL;
+  }
+  if (n < old) vp_mem_release(sub, old - n);
+  return q;
+}
+
+static inline void vp_free(int sub, void* p, size_t n) {
+  if (!p) return;
+  free(p);
+  vp_mem_release(sub, n);
+}
+
+static inline uint64_t vp_mem_used(int sub) {
+  return _VP_LOAD(vp_mem.used[sub]);
+}
+
+/*
+  @brief
+  Write a per-subsystem breakdown of accounted memory
+*/
+static inline void vp_mem_report(FILE* fp) {
+  for (int i = 0; i < VP_MEM_NSUB; i++)
+    fprintf(fp, "%-8s %14llu\n", vp_mem_names[i], (unsigned long long)vp_mem_used(i));
+  fprintf(fp, "%-8s %14llu\n%-8s %14llu\n%-8s %14llu\n%-8s %14llu\n",
+          "total", (unsigned long long)_VP_LOAD(vp_mem.total), "peak", (unsigned long long)_VP_LOAD(vp_mem.peak),
+          "budget", (unsigned long long)vp_mem.budget, "denied", (unsigned long long)_VP_LOAD(vp_mem.denied));
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             HASHING AND SKETCHES
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+  @brief
+  Extract the locus bits (chrom, pos, ref, alt) of a `snvpack64` word,
+  dropping the sample ID and GT. The result has the same layout as
+  `vpack64_loc`, so sites from both packing schemes hash identically.
+*/
+static inline vpack64_t vp_snv_locus(vpack64_t v) {
+  return (v >> 9) & VMASK_37;
+}
+
+static inline int vp_clz64(uint64_t x) {
+#if defined(__GNUC__)
+  return x ? __builtin_clzll(x) : 64;
+#else
+  int n = 0;
+  if (!x) return 64;
+  while (!(x & 0x8000000000000000ULL)) { x <<= 1; n++; }
+  return n;
+#endif
+}
+
+static inline int vp_ctz64(uint64_t x) {
+#if defined(__GNUC__)
+  return x ? __builtin_ctzll(x) : 64;
+#else
+  int n = 0;
+  if (!x) return 64;
+  while (!(x & 1)) { x >>= 1; n++; }
+  return n;
+#endif
+}
+
+/*
+  @brief
+  64-bit mixing hash (murmur3 finalizer). Bijective, so distinct
+  sites never collide before the sketch truncates the hash.
+*/
+static inline uint64_t vp_hash64(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+#if defined(__AVX2__)
+/* Low 64 bits of a 64x64 multiply; AVX2 only has 32x32->64 */
+static inline __m256i _vp_mullo64_avx2(__m256i a, __m256i b) {
+  __m256i lo  = _mm256_mul_epu32(a, b);
+  __m256i h1  = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+  __m256i h2  = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+  return _mm256_add_epi64(lo, _mm256_slli_epi64(_mm256_add_epi64(h1, h2), 32));
+}
+#endif
+
+/*
+  @brief
+  Hash an array of packed words with `vp_hash64`. Each word is
+  first shifted right by `shift` and masked with `mask`, which lets
+  callers hash the locus bits of `snvpack64` words directly
+  (shift=9, mask=VMASK_37) or plain `vpack64_loc` words (0, ~0).
+
+  @param in    packed words
+  @param out   hashes, len >= n
+  @param n     number of words
+  @param shift right shift applied before masking
+  @param mask  mask applied before hashing
+*/
+static inline void vp_hash64_batch(const vpack64_t* in, uint64_t* out, size_t n, int shift, uint64_t mask) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i m  = _mm256_set1_epi64x((long long)mask);
+  const __m256i c1 = _mm256_set1_epi64x((long long)0xff51afd7ed558ccdULL);
+  const __m256i c2 = _mm256_set1_epi64x((long long)0xc4ceb9fe1a85ec53ULL);
+  const __m128i sh = _mm_cvtsi32_si128(shift);
+  for (; i + 4 <= n; i += 4) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+    x = _mm256_and_si256(_mm256_srl_epi64(x, sh), m);
+    x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 33));
+    x = _vp_mullo64_avx2(x, c1);
+    x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 33));
+    x = _vp_mullo64_avx2(x, c2);
+    x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 33));
+    _mm256_storeu_si256((__m256i*)(out + i), x);
+  }
+#endif
+  for (; i < n; i++) out[i] = vp_hash64((in[i] >> shift) & mask);
+}
+
+#define VP_HASH_CHUNK 256
+
+/*
+  @brief
+  HyperLogLog sketch for distinct site counts. Precision is fixed
+  at compile time by `VP_HLL_P` (default 12, ~1.6% standard error,
+  4 KB of registers). Sketches with the same precision merge
+  losslessly with `vp_hll_merge`.
+
+  Must initialize to zero with `vp_hll_init()`
+*/
+#ifndef VP_HLL_P
+#define VP_HLL_P 12
+#endif
+#define VP_HLL_M (1u << VP_HLL_P)
+
+typedef struct
+{
+  uint8_t reg[VP_HLL_M];
+} vp_hll_t;
+
+static inline void vp_hll_init(vp_hll_t* h) {
+  memset(h->reg, 0, sizeof(h->reg));
+}
+
+/*
+  @brief
+  Add one precomputed 64-bit hash to the sketch
+*/
+static inline void vp_hll_add_hash(vp_hll_t* h, uint64_t x) {
+  uint32_t idx = (uint32_t)(x >> (64 - VP_HLL_P));
+  uint64_t w = (x << VP_HLL_P) | (1ULL << (VP_HLL_P - 1));
+  uint8_t rank = (uint8_t)(vp_clz64(w) + 1);
+  if (rank > h->reg[idx]) h->reg[idx] = rank;
+}
+
+/*
+  @brief
+  Add `vpack64_loc` words to the sketch
+*/
+static inline void vp_hll_add_loc(vp_hll_t* h, const vpack64_t* v, size_t n) {
+  uint64_t buf[VP_HASH_CHUNK];
+  for (size_t i = 0; i < n; i += VP_HASH_CHUNK) {
+    size_t c = n - i < VP_HASH_CHUNK ? n - i : VP_HASH_CHUNK;
+    vp_hash64_batch(v + i, buf, c, 0, ~0ULL);
+    for (size_t j = 0; j < c; j++) vp_hll_add_hash(h, buf[j]);
+  }
+}
+
+/*
+  @brief
+  Add `snvpack64` words to the sketch. Sample ID and GT bits are
+  masked off, so the same site in different samples counts once.
+*/
+static inline void vp_hll_add_snv(vp_hll_t* h, const vpack64_t* v, size_t n) {
+  uint64_t buf[VP_HASH_CHUNK];
+  for (size_t i = 0; i < n; i += VP_HASH_CHUNK) {
+    size_t c = n - i < VP_HASH_CHUNK ? n - i : VP_HASH_CHUNK;
+    vp_hash64_batch(v + i, buf, c, 9, VMASK_37);
+    for (size_t j = 0; j < c; j++) vp_hll_add_hash(h, buf[j]);
+  }
+}
+
+/*
+  @brief
+  Merge `src` into `dst`. The result estimates the size of the union.
+*/
+static inline void vp_hll_merge(vp_hll_t* dst, const vp_hll_t* src) {
+  for (uint32_t i = 0; i < VP_HLL_M; i++)
+    if (src->reg[i] > dst->reg[i]) dst->reg[i] = src->reg[i];
+}
+
+/*
+  @brief
+  Estimate the number of distinct items added to the sketch
+*/
+static inline double vp_hll_count(const vp_hll_t* h) {
+  double m = (double)VP_HLL_M;
+  double sum = 0.0;
+  uint32_t zeros = 0;
+  for (uint32_t i = 0; i < VP_HLL_M; i++) {
+    sum += 1.0 / (double)(1ULL << h->reg[i]);
+    if (!h->reg[i]) zeros++;
+  }
+  double alpha = 0.7213 / (1.0 + 1.079 / m);
+  double e = alpha * m * m / sum;
+  if (e <= 2.5 * m && zeros) e = m * log(m / (double)zeros); /* linear counting */
+  return e;
+}
+
+#define VP_HLL_MAGIC 0x4c4c4856u /* "VHLL" */
+
+/*
+  @brief
+  Serialize the sketch to a file.
+
+  @returns status  0: success, -1: write error
+*/
+static inline int vp_hll_write(const vp_hll_t* h, FILE* fp) {
+  uint32_t hdr[2] = {VP_HLL_MAGIC, VP_HLL_P};
+  if (fwrite(hdr, sizeof(hdr), 1, fp) != 1) return -1;
+  if (fwrite(h->reg, sizeof(h->reg), 1, fp) != 1) return -1;
+  return 0;
+}
+
+/*
+  @brief
+  Read a sketch written by `vp_hll_write`.
+
+  @returns status  0: success, -1: read error or precision mismatch
+*/
+static inline int vp_hll_read(vp_hll_t* h, FILE* fp) {
+  uint32_t hdr[2];
+  if (fread(hdr, sizeof(hdr), 1, fp) != 1) return -1;
+  if (hdr[0] != VP_HLL_MAGIC || hdr[1] != VP_HLL_P) return -1;
+  if (fread(h->reg, sizeof(h->reg), 1, fp) != 1) return -1;
+  return 0;
+}
+
+/*
+  @brief
+  Bottom-k MinHash sketch: keeps the `VP_MINHASH_K` smallest distinct
+  hashes seen, sorted ascending. Two sketches estimate the Jaccard
+  similarity, and therefore the overlap, of the underlying site sets.
+
+  Must initialize with `vp_minhash_init()`
+*/
+#ifndef VP_MINHASH_K
+#define VP_MINHASH_K 256
+#endif
+
+typedef struct
+{
+  uint32_t n;
+  uint64_t h[VP_MINHASH_K];
+} vp_minhash_t;
+
+static inline void vp_minhash_init(vp_minhash_t* s) {
+  s->n = 0;
+}
+
+/*
+  @brief
+  Add one precomputed 64-bit hash to the sketch
+*/
+static inline void vp_minhash_add_hash(vp_minhash_t* s, uint64_t x) {
+  if (s->n == VP_MINHASH_K && x >= s->h[s->n - 1]) return;
+  uint32_t lo = 0, hi = s->n;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) >> 1;
+    if (s->h[mid] < x) lo = mid + 1; else hi = mid;
+  }
+  if (lo < s->n && s->h[lo] == x) return;
+  uint32_t end = s->n < VP_MINHASH_K ? s->n : VP_MINHASH_K - 1;
+  memmove(s->h + lo + 1, s->h + lo, (end - lo) * sizeof(uint64_t));
+  s->h[lo] = x;
+  if (s->n < VP_MINHASH_K) s->n++;
+}
+
+/*
+  @brief
+  Add `vpack64_loc` words to the sketch
+*/
+static inline void vp_minhash_add_loc(vp_minhash_t* s, const vpack64_t* v, size_t n) {
+  uint64_t buf[VP_HASH_CHUNK];
+  for (size_t i = 0; i < n; i += VP_HASH_CHUNK) {
+    size_t c = n - i < VP_HASH_CHUNK ? n - i : VP_HASH_CHUNK;
+    vp_hash64_batch(v + i, buf, c, 0, ~0ULL);
+    for (size_t j = 0; j < c; j++) vp_minhash_add_hash(s, buf[j]);
+  }
+}
+
+/*
+  @brief
+  Add the locus bits of `snvpack64` words to the sketch
+*/
+static inline void vp_minhash_add_snv(vp_minhash_t* s, const vpack64_t* v, size_t n) {
+  uint64_t buf[VP_HASH_CHUNK];
+  for (size_t i = 0; i < n; i += VP_HASH_CHUNK) {
+    size_t c = n - i < VP_HASH_CHUNK ? n - i : VP_HASH_CHUNK;
+    vp_hash64_batch(v + i, buf, c, 9, VMASK_37);
+    for (size_t j = 0; j < c; j++) vp_minhash_add_hash(s, buf[j]);
+  }
+}
+
+/*
+  @brief
+  Merge `src` into `dst`. The result is the sketch of the union.
+*/
+static inline void vp_minhash_merge(vp_minhash_t* dst, const vp_minhash_t* src) {
+  uint64_t out[VP_MINHASH_K];
+  uint32_t i = 0, j = 0, k = 0;
+  while (k < VP_MINHASH_K && (i < dst->n || j < src->n)) {
+    uint64_t x;
+    if (j >= src->n || (i < dst->n && dst->h[i] < src->h[j])) x = dst->h[i++];
+    else if (i >= dst->n || src->h[j] < dst->h[i])             x = src->h[j++];
+    else { x = dst->h[i++]; j++; }
+    out[k++] = x;
+  }
+  memcpy(dst->h, out, k * sizeof(uint64_t));
+  dst->n = k;
+}
+
+/*
+  @brief
+  Estimate the Jaccard similarity |A n B| / |A u B| of two sketches
+*/
+static inline double vp_minhash_jaccard(const vp_minhash_t* a, const vp_minhash_t* b) {
+  uint32_t i = 0, j = 0, k = 0, common = 0;
+  while (k < VP_MINHASH_K && (i < a->n || j < b->n)) {
+    if (j >= b->n || (i < a->n && a->h[i] < b->h[j]))      i++;
+    else if (i >= a->n || b->h[j] < a->h[i])               j++;
+    else { i++; j++; common++; }
+    k++;
+  }
+  return k ? (double)common / (double)k : 0.0;
+}
+
+/*
+  @brief
+  Estimate the number of distinct items added to the sketch. Exact
+  while fewer than `VP_MINHASH_K` items have been seen.
+*/
+static inline double vp_minhash_count(const vp_minhash_t* s) {
+  if (s->n < VP_MINHASH_K) return (double)s->n;
+  double kth = (double)s->h[VP_MINHASH_K - 1] / 18446744073709551616.0;
+  return (double)(VP_MINHASH_K - 1) / kth;
+}
+
+#define VP_MINHASH_MAGIC 0x484d4e56u /* "VNMH" */
+
+/*
+  @brief
+  Serialize the sketch to a file.
+
+  @returns status  0: success, -1: write error
+*/
+static inline int vp_minhash_write(const vp_minhash_t* s, FILE* fp) {
+  uint32_t hdr[3] = {VP_MINHASH_MAGIC, VP_MINHASH_K, s->n};
+  if (fwrite(hdr, sizeof(hdr), 1, fp) != 1) return -1;
+  if (s->n && fwrite(s->h, sizeof(uint64_t), s->n, fp) != s->n) return -1;
+  return 0;
+}
+
+/*
+  @brief
+  Read a sketch written by `vp_minhash_write`.
+
+  @returns status  0: success, -1: read error or size mismatch
+*/
+static inline int vp_minhash_read(vp_minhash_t* s, FILE* fp) {
+  uint32_t hdr[3];
+  if (fread(hdr, sizeof(hdr), 1, fp) != 1) return -1;
+  if (hdr[0] != VP_MINHASH_MAGIC || hdr[1] != VP_MINHASH_K || hdr[2] > VP_MINHASH_K) return -1;
+  s->n = hdr[2];
+  if (s->n && fread(s->h, sizeof(uint64_t), s->n, fp) != s->n) return -1;
+  return 0;
+}
+/*
+  @brief
+  Per-sample MinHash signature over the sample's non-ref sites, used
+  to find duplicate or swapped samples. The hash space is split into
+  `VP_SKETCH_BINS` bins and each bin keeps its minimum (bottom-1 per
+  bin). Unlike a single bottom-k list, bin `i` of two signatures always
+  covers the same slice of the hash space, so signatures can be cut
+  into LSH bands. Empty bins hold UINT64_MAX.
+
+  Must initialize with `vp_sample_sketch_init()`
+*/
+#ifndef VP_SKETCH_BINS_LOG2
+#define VP_SKETCH_BINS_LOG2 7
+#endif
+#define VP_SKETCH_BINS (1u << VP_SKETCH_BINS_LOG2)
+
+typedef struct
+{
+  uint64_t h[VP_SKETCH_BINS];
+} vp_sample_sketch_t;
+
+static inline void vp_sample_sketch_init(vp_sample_sketch_t* s) {
+  memset(s->h, 0xff, sizeof(s->h));
+}
+
+static inline void vp_sample_sketch_add_hash(vp_sample_sketch_t* s, uint64_t x) {
+  uint32_t bin = (uint32_t)(x >> (64 - VP_SKETCH_BINS_LOG2));
+  if (x < s->h[bin]) s->h[bin] = x;
+}
+
+/*
+  @brief
+  True if the 9-bit GT of a `snvpack64` word carries an alt allele
+*/
+static inline int vp_snv_is_nonref(vpack64_t v) {
+  return ((v >> 6) & 7) == 1 || (v & 7) == 1;
+}
+
+/*
+  @brief
+  Update per-sample signatures from a stream of `snvpack64` words in
+  a single pass. Words may come from any mix of samples; the sample ID
+  bits select the signature. Hom-ref and missing GTs are skipped, and
+  words whose sample ID is >= `nsamples` are ignored.
+
+  @param s        signatures, one per sample
+  @param nsamples number of signatures
+  @param v        `snvpack64` words
+  @param n        number of words
+*/
+static inline void vp_sample_sketch_add_snv(vp_sample_sketch_t* s, uint32_t nsamples, const vpack64_t* v, size_t n) {
+  uint64_t buf[VP_HASH_CHUNK];
+  for (size_t i = 0; i < n; i += VP_HASH_CHUNK) {
+    size_t c = n - i < VP_HASH_CHUNK ? n - i : VP_HASH_CHUNK;
+    vp_hash64_batch(v + i, buf, c, 9, VMASK_37);
+    for (size_t j = 0; j < c; j++) {
+      vpack64_t w = v[i + j];
+      uint32_t sample = (uint32_t)(w >> 46);
+      if (sample < nsamples && vp_snv_is_nonref(w)) vp_sample_sketch_add_hash(&s[sample], buf[j]);
+    }
+  }
+}
+
+/*
+  @brief
+  Estimate the Jaccard similarity of two samples' non-ref site sets
+  as the fraction of non-empty bins holding the same minimum
+*/
+static inline double vp_sample_sketch_jaccard(const vp_sample_sketch_t* a, const vp_sample_sketch_t* b) {
+  uint32_t eq = 0, used = 0;
+  for (uint32_t i = 0; i < VP_SKETCH_BINS; i++) {
+    if (a->h[i] == UINT64_MAX && b->h[i] == UINT64_MAX) continue;
+    used++;
+    if (a->h[i] == b->h[i]) eq++;
+  }
+  return used ? (double)eq / (double)used : 0.0;
+}
+
+typedef struct
+{
+  uint64_t key;
+  uint32_t idx;
+} _vp_band_t;
+
+static inline int _vp_band_cmp(const void* a, const void* b) {
+  const _vp_band_t* x = (const _vp_band_t*)a;
+  const _vp_band_t* y = (const _vp_band_t*)b;
+  if (x->key != y->key) return x->key < y->key ? -1 : 1;
+  return x->idx < y->idx ? -1 : x->idx > y->idx;
+}
+
+static inline uint64_t _vp_band_hash(const uint64_t* h, uint32_t rows) {
+  uint64_t x = 0;
+  for (uint32_t r = 0; r < rows; r++) x = vp_hash64(x ^ h[r]);
+  return x;
+}
+
+/* A band with every bin empty carries no evidence of similarity */
+static inline int _vp_band_empty(const uint64_t* h, uint32_t rows) {
+  for (uint32_t r = 0; r < rows; r++)
+    if (h[r] != UINT64_MAX) return 0;
+  return 1;
+}
+
+/*
+  Callback for candidate pairs from `vp_sample_sketch_lsh`. Return
+  non-zero to stop the search.
+*/
+typedef int (*vp_pair_fn)(uint32_t a, uint32_t b, double jaccard, void* ud);
+
+/*
+  @brief
+  All-vs-all candidate search with banded LSH. Signatures are cut
+  into `bands` bands of VP_SKETCH_BINS/bands bins each; two samples
+  become a candidate when any band matches exactly. Each pair is
+  reported once, with its sketch Jaccard estimate, and only those pairs
+  need to go on to an exact comparison. More bands raise recall for
+  less similar pairs; for duplicate detection (J ~ 1) a few wide bands
+  are enough. Bands whose bins are all empty never match, so sparse,
+  low-coverage samples do not all collide in one bucket.
+
+  @param s        signatures, one per sample
+  @param nsamples number of signatures
+  @param bands    number of bands, must divide VP_SKETCH_BINS
+  @param fn       callback for each candidate pair (a < b)
+  @param ud       user data passed to `fn`
+
+  @returns number of candidate pairs reported, -1: bad band count or out of memory
+*/
+static inline long vp_sample_sketch_lsh(const vp_sample_sketch_t* s, uint32_t nsamples, uint32_t bands, vp_pair_fn fn, void* ud) {
+  if (!bands || VP_SKETCH_BINS % bands) return -1;
+  uint32_t rows = VP_SKETCH_BINS / bands;
+  size_t tbytes = (size_t)nsamples * sizeof(_vp_band_t);
+  _vp_band_t* t = (_vp_band_t*)vp_malloc(VP_MEM_SCRATCH, tbytes);
+  if (!t) return -1;
+  long npairs = 0;
+  for (uint32_t b = 0; b < bands; b++) {
+    uint32_t off = b * rows, nt = 0;
+    for (uint32_t i = 0; i < nsamples; i++) {
+      if (_vp_band_empty(s[i].h + off, rows)) continue;
+      t[nt].key = _vp_band_hash(s[i].h + off, rows);
+      t[nt++].idx = i;
+    }
+    qsort(t, nt, sizeof(_vp_band_t), _vp_band_cmp);
+    for (uint32_t lo = 0, hi; lo < nt; lo = hi) {
+      for (hi = lo + 1; hi < nt && t[hi].key == t[lo].key; hi++);
+      for (uint32_t i = lo; i < hi; i++) {
+        for (uint32_t j = i + 1; j < hi; j++) {
+          const uint64_t* x = s[t[i].idx].h;
+          const uint64_t* y = s[t[j].idx].h;
+          if (memcmp(x + off, y + off, rows * sizeof(uint64_t))) continue;
+          /* already reported by an earlier band */
+          uint32_t prev = 0;
+          for (; prev < b; prev++)
+            if (!memcmp(x + prev * rows, y + prev * rows, rows * sizeof(uint64_t)) &&
+                !_vp_band_empty(x + prev * rows, rows)) break;
+          if (prev < b) continue;
+          npairs++;
+          if (fn(t[i].idx, t[j].idx, vp_sample_sketch_jaccard(&s[t[i].idx], &s[t[j].idx]), ud)) {
+            vp_free(VP_MEM_SCRATCH, t, tbytes);
+            return npairs;
+          }
+        }
+      }
+    }
+  }
+  vp_free(VP_MEM_SCRATCH, t, tbytes);
+  return npairs;
+}
+/*
+  @brief
+  Heavy-hitter entry: a packed site word and its estimated count
+*/
+typedef struct
+{
+  vpack64_t key;
+  uint64_t count;
+} vp_hitter_t;
+
+/*
+  @brief
+  Count-min sketch of site frequencies with a top-k heavy-hitters heap.
+
+  A sketch is not thread safe. For concurrent writers give each thread
+  its own sketch (same `depth`/`wbits`) and fold them into a global one
+  with `vp_cms_merge` at intervals; writers never share memory, so no
+  locks or atomics are needed on the hot path.
+
+  Must initialize with `vp_cms_init()` and free with `vp_cms_destroy()`
+*/
+typedef struct
+{
+  uint32_t depth;
+  uint32_t wbits;
+  uint32_t* c;        // depth rows of 2^wbits counters
+  uint64_t total;
+
+  uint32_t k;
+  uint32_t nheap;
+  vp_hitter_t* heap;  // min-heap on count
+  uint32_t pbits;
+  uint32_t* pos;      // 2^pbits slots, linear probing: heap index + 1 of a key, 0: empty
+} vp_cms_t;
+
+static inline void vp_cms_destroy(vp_cms_t* cms) {
+  vp_free(VP_MEM_SKETCH, cms->c, ((size_t)cms->depth << cms->wbits) * sizeof(uint32_t));
+  vp_free(VP_MEM_SKETCH, cms->heap, cms->k * sizeof(vp_hitter_t));
+  vp_free(VP_MEM_SKETCH, cms->pos, ((size_t)1 << cms->pbits) * sizeof(uint32_t));
+  memset(cms, 0, sizeof(*cms));
+}
+
+/*
+  @brief
+  Allocate a count-min sketch. Error is at most total*e/2^wbits with
+  probability 1-exp(-depth).
+
+  @param cms   sketch
+  @param depth number of hash rows (1...16)
+  @param wbits log2 of the row width (1...30)
+  @param k     number of heavy hitters to track
+
+  @returns status  0: success, -1: bad parameters or out of memory
+*/
+static inline int vp_cms_init(vp_cms_t* cms, uint32_t depth, uint32_t wbits, uint32_t k) {
+  memset(cms, 0, sizeof(*cms));
+  if (!depth || depth > 16 || !wbits || wbits > 30) return -1;
+  cms->depth = depth;
+  cms->wbits = wbits;
+  cms->k = k;
+  cms->c = (uint32_t*)vp_calloc(VP_MEM_SKETCH, (size_t)depth << wbits, sizeof(uint32_t));
+  cms->heap = (vp_hitter_t*)vp_malloc(VP_MEM_SKETCH, k * sizeof(vp_hitter_t));
+  for (cms->pbits = 1; ((size_t)1 << cms->pbits) < 2 * (size_t)k; cms->pbits++);
+  cms->pos = (uint32_t*)vp_calloc(VP_MEM_SKETCH, (size_t)1 << cms->pbits, sizeof(uint32_t));
+  if (!cms->c || !cms->heap || !cms->pos) {
+    vp_cms_destroy(cms);
+    return -1;
+  }
+  return 0;
+}
+
+
+/*
+  The heap is indexed by key so an add finds its entry in O(1): `pos`
+  maps a key to its heap slot and every heap move updates it.
+*/
+static inline size_t _vp_cms_home(const vp_cms_t* cms, vpack64_t key) {
+  return (size_t)(vp_hash64(key ^ 0x9e3779b97f4a7c15ULL) >> (64 - cms->pbits)) & (((size_t)1 << cms->pbits) - 1);
+}
+
+/* Slot holding `key`, or the empty slot where it would go */
+static inline size_t _vp_cms_find(const vp_cms_t* cms, vpack64_t key) {
+  size_t mask = ((size_t)1 << cms->pbits) - 1, i = _vp_cms_home(cms, key);
+  while (cms->pos[i] && cms->heap[cms->pos[i] - 1].key != key) i = (i + 1) & mask;
+  return i;
+}
+
+/* Remove slot `i`, shifting back later entries of its probe run */
+static inline void _vp_cms_unlink(vp_cms_t* cms, size_t i) {
+  size_t mask = ((size_t)1 << cms->pbits) - 1;
+  for (size_t j = (i + 1) & mask; cms->pos[j]; j = (j + 1) & mask) {
+    size_t h = _vp_cms_home(cms, cms->heap[cms->pos[j] - 1].key);
+    if (((j - h) & mask) >= ((j - i) & mask)) {
+      cms->pos[i] = cms->pos[j];
+      i = j;
+    }
+  }
+  cms->pos[i] = 0;
+}
+
+static inline void _vp_cms_swap(vp_cms_t* cms, uint32_t i, uint32_t j) {
+  size_t si = _vp_cms_find(cms, cms->heap[i].key), sj = _vp_cms_find(cms, cms->heap[j].key);
+  vp_hitter_t t = cms->heap[i]; cms->heap[i] = cms->heap[j]; cms->heap[j] = t;
+  cms->pos[si] = j + 1;
+  cms->pos[sj] = i + 1;
+}
+
+static inline void _vp_heap_down(vp_cms_t* cms, uint32_t i) {
+  vp_hitter_t* h = cms->heap;
+  uint32_t n = cms->nheap;
+  for (;;) {
+    uint32_t l = 2 * i + 1, m = i;
+    if (l < n && h[l].count < h[m].count) m = l;
+    if (l + 1 < n && h[l + 1].count < h[m].count) m = l + 1;
+    if (m == i) return;
+    _vp_cms_swap(cms, i, m);
+    i = m;
+  }
+}
+
+static inline void _vp_heap_up(vp_cms_t* cms, uint32_t i) {
+  while (i && cms->heap[(i - 1) / 2].count > cms->heap[i].count) {
+    _vp_cms_swap(cms, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+/* Offer a key with its current estimate to the heavy-hitters heap */
+static inline void _vp_cms_offer(vp_cms_t* cms, vpack64_t key, uint64_t est) {
+  if (!cms->k) return;
+  size_t slot = _vp_cms_find(cms, key);
+  if (cms->pos[slot]) {
+    uint32_t i = cms->pos[slot] - 1;
+    cms->heap[i].count = est;
+    _vp_heap_down(cms, i);
+  } else if (cms->nheap < cms->k) {
+    cms->heap[cms->nheap] = (vp_hitter_t){key, est};
+    cms->pos[slot] = cms->nheap + 1;
+    _vp_heap_up(cms, cms->nheap++);
+  } else if (est > cms->heap[0].count) {
+    _vp_cms_unlink(cms, _vp_cms_find(cms, cms->heap[0].key));
+    cms->heap[0] = (vp_hitter_t){key, est};
+    cms->pos[_vp_cms_find(cms, key)] = 1;
+    _vp_heap_down(cms, 0);
+  }
+}
+
+/*
+  @brief
+  Estimated count for a key, never below the true count
+*/
+static inline uint64_t vp_cms_estimate(const vp_cms_t* cms, vpack64_t key) {
+  uint64_t h = vp_hash64(key);
+  uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+  uint32_t mask = (1u << cms->wbits) - 1;
+  uint64_t est = UINT64_MAX;
+  for (uint32_t r = 0; r < cms->depth; r++) {
+    uint32_t c = cms->c[((size_t)r << cms->wbits) + ((h1 + r * h2) & mask)];
+    if (c < est) est = c;
+  }
+  return est;
+}
+
+static inline void _vp_cms_add_hash(vp_cms_t* cms, vpack64_t key, uint64_t h, uint32_t n) {
+  uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+  uint32_t mask = (1u << cms->wbits) - 1;
+  uint64_t est = UINT64_MAX;
+  for (uint32_t r = 0; r < cms->depth; r++) {
+    uint32_t* c = &cms->c[((size_t)r << cms->wbits) + ((h1 + r * h2) & mask)];
+    *c = *c > UINT32_MAX - n ? UINT32_MAX : *c + n;
+    if (*c < est) est = *c;
+  }
+  cms->total += n;
+  _vp_cms_offer(cms, key, est);
+}
+
+/*
+  @brief
+  Count `n` occurrences of a site key (`vpack64_loc` layout)
+*/
+static inline void vp_cms_add(vp_cms_t* cms, vpack64_t key, uint32_t n) {
+  _vp_cms_add_hash(cms, key, vp_hash64(key), n);
+}
+
+/*
+  @brief
+  Count `vpack64_loc` words, one occurrence each
+*/
+static inline void vp_cms_add_loc(vp_cms_t* cms, const vpack64_t* v, size_t n) {
+  uint64_t buf[VP_HASH_CHUNK];
+  for (size_t i = 0; i < n; i += VP_HASH_CHUNK) {
+    size_t c = n - i < VP_HASH_CHUNK ? n - i : VP_HASH_CHUNK;
+    vp_hash64_batch(v + i, buf, c, 0, ~0ULL);
+    for (size_t j = 0; j < c; j++) _vp_cms_add_hash(cms, v[i + j], buf[j], 1);
+  }
+}
+
+/*
+  @brief
+  Count carriers per site from a stream of `snvpack64` words. Only
+  non-ref GTs are counted, keyed by the site's locus bits, so the
+  estimate for a site is its number of carrier samples.
+*/
+static inline void vp_cms_add_snv(vp_cms_t* cms, const vpack64_t* v, size_t n) {
+  uint64_t buf[VP_HASH_CHUNK];
+  for (size_t i = 0; i < n; i += VP_HASH_CHUNK) {
+    size_t c = n - i < VP_HASH_CHUNK ? n - i : VP_HASH_CHUNK;
+    vp_hash64_batch(v + i, buf, c, 9, VMASK_37);
+    for (size_t j = 0; j < c; j++)
+      if (vp_snv_is_nonref(v[i + j])) _vp_cms_add_hash(cms, vp_snv_locus(v[i + j]), buf[j], 1);
+  }
+}
+
+/*
+  @brief
+  Fold `src` into `dst`, e.g. a per-thread sketch into the global one.
+  Heavy hitters of both sketches are re-estimated against the merged
+  counters. `src` is left unchanged; clear it with `vp_cms_reset`.
+
+  @returns status  0: success, -1: sketch dimensions differ
+*/
+static inline int vp_cms_merge(vp_cms_t* dst, const vp_cms_t* src) {
+  if (dst->depth != src->depth || dst->wbits != src->wbits) return -1;
+  size_t n = (size_t)dst->depth << dst->wbits;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t a = dst->c[i], b = src->c[i];
+    dst->c[i] = a > UINT32_MAX - b ? UINT32_MAX : a + b;
+  }
+  dst->total += src->total;
+  for (uint32_t i = 0; i < dst->nheap; i++) dst->heap[i].count = vp_cms_estimate(dst, dst->heap[i].key);
+  for (uint32_t i = dst->nheap / 2; i-- > 0;) _vp_heap_down(dst, i);
+  for (uint32_t i = 0; i < src->nheap; i++)
+    _vp_cms_offer(dst, src->heap[i].key, vp_cms_estimate(dst, src->heap[i].key));
+  return 0;
+}
+
+/*
+  @brief
+  Zero all counters and the heavy-hitters heap
+*/
+static inline void vp_cms_reset(vp_cms_t* cms) {
+  memset(cms->c, 0, ((size_t)cms->depth << cms->wbits) * sizeof(uint32_t));
+  if (cms->pos) memset(cms->pos, 0, ((size_t)1 << cms->pbits) * sizeof(uint32_t));
+  cms->total = 0;
+  cms->nheap = 0;
+}
+
+static inline int _vp_hitter_cmp(const void* a, const void* b) {
+  const vp_hitter_t* x = (const vp_hitter_t*)a;
+  const vp_hitter_t* y = (const vp_hitter_t*)b;
+  if (x->count != y->count) return x->count > y->count ? -1 : 1;
+  return x->key < y->key ? -1 : x->key > y->key;
+}
+
+/*
+  @brief
+  Copy the current heavy hitters to `out`, most frequent first
+
+  @param out  output, len >= cms->k
+
+  @returns number of entries written
+*/
+static inline uint32_t vp_cms_topk(const vp_cms_t* cms, vp_hitter_t* out) {
+  memcpy(out, cms->heap, cms->nheap * sizeof(vp_hitter_t));
+  qsort(out, cms->nheap, sizeof(vp_hitter_t), _vp_hitter_cmp);
+  return cms->nheap;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             PACKED GENOTYPE MATRIX
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*
+  A packed matrix is an array of `vpack64_loc` site words plus, for
+  each site, one genotype row. A row is `vp_row_words(nsamples)` words
+  packed with `vpack_rec`: 2 bits per allele, so 16 diploid genotypes
+  per word, first sample in the highest used bits. The last word of a
+  row holds the remaining samples in its low bits.
+*/
+#define VP_GT_PER_WORD 16
+
+static inline uint32_t vp_row_words(uint32_t nsamples) {
+  return (nsamples + VP_GT_PER_WORD - 1) / VP_GT_PER_WORD;
+}
+
+typedef struct
+{
+  vpack64_t* sites;   // nsites `vpack64_loc` words
+  vpack64_t* gts;     // nsites rows of vp_row_words(nsamples) words
+  size_t nsites;
+  uint32_t nsamples;
+} vp_mat_t;
+
+static inline vpack64_t* vp_mat_row(const vp_mat_t* m, size_t i) {
+  return m->gts + i * vp_row_words(m->nsamples);
+}
+
+static inline int vp_popcount64(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/*
+  @brief
+  Count alleles in a packed row equal to a 2-bit base code, without
+  unpacking. Use `site & 3` for the alt allele of a `vpack64_loc` word.
+
+  @param row      packed row
+  @param nsamples number of samples in the row
+  @param code     2-bit base code (see `dna_8`)
+*/
+static inline uint32_t vp_row_count(const vpack64_t* row, uint32_t nsamples, uint32_t code) {
+  const uint64_t lo = 0x5555555555555555ULL;
+  uint64_t pat = (uint64_t)(code & 3) * lo;
+  uint32_t nw = vp_row_words(nsamples), n = 0;
+  for (uint32_t j = 0; j < nw; j++) {
+    uint64_t x = row[j] ^ pat;
+    uint64_t eq = ~(x | (x >> 1)) & lo;
+    uint32_t rem = nsamples - j * VP_GT_PER_WORD;
+    if (rem < VP_GT_PER_WORD) eq &= (1ULL << (rem * 4)) - 1;
+    n += (uint32_t)vp_popcount64(eq);
+  }
+  return n;
+}
+
+/*
+  @brief
+  Alt allele frequency of site `i`
+*/
+static inline double vp_mat_af(const vp_mat_t* m, size_t i) {
+  if (!m->nsamples) return 0.0;
+  uint32_t n = vp_row_count(vp_mat_row(m, i), m->nsamples, (uint32_t)(m->sites[i] & 3));
+  return (double)n / (2.0 * m->nsamples);
+}
+
+/*
+  @brief
+  Copy the sites listed in `idx` (ascending) and their genotype rows
+  into `out`, which must have room for `n` sites. Runs of consecutive
+  indices are copied as one block; rows are never unpacked.
+
+  @param in  source matrix
+  @param idx ascending site indices
+  @param n   number of indices
+  @param out destination, `sites` and `gts` allocated by the caller
+*/
+static inline void vp_mat_subset(const vp_mat_t* in, const size_t* idx, size_t n, vp_mat_t* out) {
+  size_t rw = vp_row_words(in->nsamples);
+  out->nsamples = in->nsamples;
+  out->nsites = n;
+  for (size_t i = 0, j; i < n; i = j) {
+    for (j = i + 1; j < n && idx[j] == idx[j - 1] + 1; j++);
+    memcpy(out->sites + i, in->sites + idx[i], (j - i) * sizeof(vpack64_t));
+    memcpy(out->gts + i * rw, in->gts + idx[i] * rw, (j - i) * rw * sizeof(vpack64_t));
+  }
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             BATCH VISITORS
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*
+  Analytics see sites a batch at a time rather than one record per
+  call. A batch is up to VP_BATCH_SITES consecutive sites: a span of
+  site words, the matching span of rows, and a selection bitmap. A
+  visitor works on the selected sites and may clear bits to filter
+  them from later stages; whole spans let kernels work across sites,
+  e.g. `vp_batch_ac` counts eight single-word rows per AVX-512
+  instruction.
+
+    int fn(vp_batch_t* b, void* ud);   // non-zero stops the scan
+
+  `vp_mat_visit` drives a visitor over a matrix, `vp_region_scan` over
+  a range of a container. `vp_visit_pipe` chains visitors, e.g. a
+  non-ref filter followed by frequencies:
+
+    vp_pipe_t p = vp_pipe_init();
+    vp_af_t af = {NULL, 0.0, 0};
+    vp_pipe_add(&p, vp_visit_nonref, NULL);
+    vp_pipe_add(&p, vp_visit_af, &af);
+    vp_mat_visit(&m, vp_visit_pipe, &p);
+*/
+#ifndef VP_BATCH_SITES
+#define VP_BATCH_SITES 256 // multiple of 64
+#endif
+
+#define VP_SEL_WORDS (VP_BATCH_SITES / 64)
+
+typedef struct
+{
+  const vpack64_t* sites;      // n `vpack64_loc` words
+  const vpack64_t* rows;       // n rows of `rw` words
+  size_t n;
+  size_t first;                // position of sites[0] in the driver's stream
+  uint32_t nsamples;
+  uint32_t rw;                 // vp_row_words(nsamples)
+  uint64_t sel[VP_SEL_WORDS];  // bit i set: site i selected
+} vp_batch_t;
+
+typedef int (*vp_batch_fn)(vp_batch_t* b, void* ud);
+
+/*
+  @brief
+  Point a batch at `n` <= VP_BATCH_SITES sites and rows, all selected
+*/
+static inline void vp_batch_init(vp_batch_t* b, const vpack64_t* sites, const vpack64_t* rows, size_t n,
+                                 size_t first, uint32_t nsamples) {
+  b->sites = sites;
+  b->rows = rows;
+  b->n = n;
+  b->first = first;
+  b->nsamples = nsamples;
+  b->rw = vp_row_words(nsamples);
+  for (size_t w = 0; w < VP_SEL_WORDS; w++)
+    b->sel[w] = n >= (w + 1) * 64 ? ~0ULL : n > w * 64 ? (1ULL << (n - w * 64)) - 1 : 0;
+}
+
+static inline const vpack64_t* vp_batch_row(const vp_batch_t* b, size_t i) {
+  return b->rows + i * b->rw;
+}
+
+static inline int vp_batch_selected(const vp_batch_t* b, size_t i) {
+  return (int)((b->sel[i >> 6] >> (i & 63)) & 1);
+}
+
+static inline void vp_batch_drop(vp_batch_t* b, size_t i) {
+  b->sel[i >> 6] &= ~(1ULL << (i & 63));
+}
+
+/* Number of selected sites */
+static inline size_t vp_batch_count(const vp_batch_t* b) {
+  size_t n = 0;
+  for (size_t w = 0; w < VP_SEL_WORDS; w++) n += (size_t)vp_popcount64(b->sel[w]);
+  return n;
+}
+
+/*
+  Visit the selected sites in order, `i` being the index in the batch:
+
+    VP_BATCH_EACH(b, i) { ... }
+*/
+#define VP_BATCH_EACH(b, i)                                                     \
+  for (size_t _w = 0, i; _w < VP_SEL_WORDS; _w++)                               \
+    for (uint64_t _s = (b)->sel[_w]; _s && ((i = _w * 64 + (size_t)vp_ctz64(_s)), 1); _s &= _s - 1)
+
+static inline void _vp_rows_ac_auto(const vpack64_t* sites, const vpack64_t* rows, size_t n, uint32_t nsamples, uint32_t* ac);
+
+/*
+  @brief
+  Alt allele count of every site in the batch, selected or not,
+  with the `ac` kernel (see "CPU DISPATCH")
+
+  @param ac output, len >= b->n
+*/
+static inline void vp_batch_ac(const vp_batch_t* b, uint32_t* ac) {
+  _vp_rows_ac_auto(b->sites, b->rows, b->n, b->nsamples, ac);
+}
+
+/*
+  @brief
+  Run a visitor over a matrix in batches of VP_BATCH_SITES sites;
+  `first` is the matrix index of the batch's first site
+
+  @returns 0: all sites visited, otherwise the visitor's stop value
+*/
+static inline int vp_mat_visit(const vp_mat_t* m, vp_batch_fn fn, void* ud) {
+  size_t rw = vp_row_words(m->nsamples);
+  vp_batch_t b;
+  for (size_t i = 0; i < m->nsites; i += VP_BATCH_SITES) {
+    size_t n = m->nsites - i < VP_BATCH_SITES ? m->nsites - i : VP_BATCH_SITES;
+    vp_batch_init(&b, m->sites + i, m->gts + i * rw, n, i, m->nsamples);
+    int rc = fn(&b, ud);
+    if (rc) return rc;
+  }
+  return 0;
+}
+
+#ifndef VP_PIPE_MAX
+#define VP_PIPE_MAX 8
+#endif
+
+typedef struct
+{
+  uint32_t n;
+  vp_batch_fn fn[VP_PIPE_MAX];
+  void* ud[VP_PIPE_MAX];
+} vp_pipe_t;
+
+static inline vp_pipe_t vp_pipe_init(void) {
+  vp_pipe_t p;
+  p.n = 0;
+  return p;
+}
+
+/*
+  @brief
+  Append a stage to a pipeline
+
+  @returns status 0: success, -1: pipeline full
+*/
+static inline int vp_pipe_add(vp_pipe_t* p, vp_batch_fn fn, void* ud) {
+  if (p->n >= VP_PIPE_MAX) return -1;
+  p->fn[p->n] = fn;
+  p->ud[p->n++] = ud;
+  return 0;
+}
+
+/*
+  @brief
+  Visitor running the stages of a `vp_pipe_t` (ud) in order on the
+  same batch, so each sees the selection left by the one before.
+  Stops early once nothing is selected.
+*/
+static inline int vp_visit_pipe(vp_batch_t* b, void* ud) {
+  const vp_pipe_t* p = (const vp_pipe_t*)ud;
+  for (uint32_t k = 0; k < p->n && vp_batch_count(b); k++) {
+    int rc = p->fn[k](b, p->ud[k]);
+    if (rc) return rc;
+  }
+  return 0;
+}
+
+/*
+  @brief
+  Filter: drop sites with no alt allele. `ud` is unused.
+*/
+static inline int vp_visit_nonref(vp_batch_t* b, void* ud) {
+  uint32_t ac[VP_BATCH_SITES];
+  (void)ud;
+  vp_batch_ac(b, ac);
+  for (size_t w = 0; w < VP_SEL_WORDS && w * 64 < b->n; w++) {
+    uint64_t keep = 0;
+    size_t e = b->n - w * 64 < 64 ? b->n - w * 64 : 64;
+    for (size_t j = 0; j < e; j++) keep |= (uint64_t)(ac[w * 64 + j] != 0) << j;
+    b->sel[w] &= keep;
+  }
+  return 0;
+}
+
+/* Alt allele frequencies of the selected sites */
+typedef struct
+{
+  double* af;   // per site, by `first + i`; NULL: sum only
+  double sum;
+  size_t n;     // sites seen
+} vp_af_t;
+
+static inline int vp_visit_af(vp_batch_t* b, void* ud) {
+  vp_af_t* a = (vp_af_t*)ud;
+  uint32_t ac[VP_BATCH_SITES];
+  vp_batch_ac(b, ac);
+  VP_BATCH_EACH(b, i) {
+    double f = b->nsamples ? (double)ac[i] / (2.0 * b->nsamples) : 0.0;
+    if (a->af) a->af[b->first + i] = f;
+    a->sum += f;
+    a->n++;
+  }
+  return 0;
+}
+
+/*
+  @brief
+  Samples carrying at least one allele equal to `code` in a packed
+  row: the two allele pairs of each sample are matched and or-ed.
+*/
+static inline uint32_t vp_row_carriers(const vpack64_t* row, uint32_t nsamples, uint32_t code) {
+  const uint64_t lo = 0x5555555555555555ULL, lo4 = 0x1111111111111111ULL;
+  uint64_t pat = (uint64_t)(code & 3) * lo;
+  uint32_t nw = vp_row_words(nsamples), n = 0;
+  for (uint32_t j = 0; j < nw; j++) {
+    uint64_t x = row[j] ^ pat;
+    uint64_t eq = ~(x | (x >> 1)) & lo;
+    uint64_t c = (eq | (eq >> 2)) & lo4;
+    uint32_t rem = nsamples - j * VP_GT_PER_WORD;
+    if (rem < VP_GT_PER_WORD) c &= (1ULL << (rem * 4)) - 1;
+    n += (uint32_t)vp_popcount64(c);
+  }
+  return n;
+}
+
+/* Alt allele carriers of the selected sites */
+typedef struct
+{
+  uint32_t* count;  // per site, by `first + i`; NULL: total only
+  uint64_t total;
+} vp_carriers_t;
+
+static inline int vp_visit_carriers(vp_batch_t* b, void* ud) {
+  vp_carriers_t* c = (vp_carriers_t*)ud;
+  VP_BATCH_EACH(b, i) {
+    uint32_t k = vp_row_carriers(vp_batch_row(b, i), b->nsamples, (uint32_t)(b->sites[i] & 3));
+    if (c->count) c->count[b->first + i] = k;
+    c->total += k;
+  }
+  return 0;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             SITE SAMPLING
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*
+  @brief
+  Seedable generator (splitmix64). Same seed, same sample.
+*/
+typedef struct
+{
+  uint64_t s;
+} vp_rng_t;
+
+static inline vp_rng_t vp_rng_init(uint64_t seed) {
+  return (vp_rng_t){seed};
+}
+
+static inline uint64_t vp_rng_next(vp_rng_t* r) {
+  uint64_t z = (r->s += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* Uniform double in (0, 1) */
+static inline double vp_rng_unit(vp_rng_t* r) {
+  return ((double)(vp_rng_next(r) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/* Uniform integer in [0, n) */
+static inline uint64_t vp_rng_bounded(vp_rng_t* r, uint64_t n) {
+#if defined(__SIZEOF_INT128__)
+  return (uint64_t)(((__uint128_t)vp_rng_next(r) * n) >> 64);
+#else
+  return vp_rng_next(r) % n;
+#endif
+}
+
+static inline int _vp_size_cmp(const void* a, const void* b) {
+  size_t x = *(const size_t*)a, y = *(const size_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+/*
+  @brief
+  Uniform random sample of `m` of `nsites` site indices by reservoir
+  sampling (Algorithm L, O(m log(n/m)) draws). Indices are returned
+  ascending, ready for `vp_mat_subset`.
+
+  @param nsites number of sites to sample from
+  @param m      sample size
+  @param rng    random generator
+  @param idx    output indices, len >= m
+
+  @returns number of indices written, min(m, nsites)
+*/
+static inline size_t vp_sample_reservoir(size_t nsites, size_t m, vp_rng_t* rng, size_t* idx) {
+  if (m >= nsites) {
+    for (size_t i = 0; i < nsites; i++) idx[i] = i;
+    return nsites;
+  }
+  if (!m) return 0;
+  for (size_t i = 0; i < m; i++) idx[i] = i;
+  double w = exp(log(vp_rng_unit(rng)) / (double)m);
+  size_t i = m - 1;
+  for (;;) {
+    double skip = floor(log(vp_rng_unit(rng)) / log(1.0 - w));
+    if (skip >= (double)(nsites - i - 1)) break;
+    i += (size_t)skip + 1;
+    idx[vp_rng_bounded(rng, m)] = i;
+    w *= exp(log(vp_rng_unit(rng)) / (double)m);
+  }
+  qsort(idx, m, sizeof(size_t), _vp_size_cmp);
+  return m;
+}
+
+/*
+  Stratified random sample: sites are binned by minor allele frequency
+  into `nbins` equal-width bins over [0, 0.5] and up to `m / nbins`
+  sites are drawn per bin by reservoir sampling, the remainder
+  `m % nbins` going one each to the first bins. `vp_visit_stratified`
+  takes sites from any driver, so a container region can be sampled
+  without loading it whole; selected sites are indexed by `first + i`.
+
+    vp_strat_t s;
+    vp_strat_init(&s, nbins, m, &rng, idx);
+    vp_region_scan(r, lo, hi, vp_visit_stratified, &s);
+    n = vp_strat_finish(&s);
+*/
+typedef struct
+{
+  uint32_t nbins;
+  size_t per;      // reservoir size per bin
+  size_t extra;    // bins [0, extra) hold one more
+  size_t* seen;    // sites seen per bin
+  size_t* idx;     // nbins reservoirs, back to back
+  vp_rng_t* rng;
+} vp_strat_t;
+
+/*
+  @brief
+  Set up a stratified sample of `m` sites into `idx` (len >= m)
+
+  @returns status 0: success, -1: out of memory
+*/
+static inline int vp_strat_init(vp_strat_t* s, uint32_t nbins, size_t m, vp_rng_t* rng, size_t* idx) {
+  s->nbins = nbins;
+  s->per = nbins ? m / nbins : 0;
+  s->extra = nbins ? m % nbins : 0;
+  s->idx = idx;
+  s->rng = rng;
+  s->seen = NULL;
+  if (nbins && !(s->seen = (size_t*)vp_calloc(VP_MEM_SCRATCH, nbins, sizeof(size_t)))) return -1;
+  return 0;
+}
+
+/* Offset of a bin's reservoir in `idx` */
+static inline size_t _vp_strat_start(const vp_strat_t* s, uint32_t bin) {
+  return bin * s->per + (bin < s->extra ? bin : s->extra);
+}
+
+static inline int vp_visit_stratified(vp_batch_t* b, void* ud) {
+  vp_strat_t* s = (vp_strat_t*)ud;
+  uint32_t ac[VP_BATCH_SITES];
+  if (!s->nbins) return 0;
+  vp_batch_ac(b, ac);
+  VP_BATCH_EACH(b, i) {
+    double af = b->nsamples ? (double)ac[i] / (2.0 * b->nsamples) : 0.0;
+    double maf = af > 0.5 ? 1.0 - af : af;
+    uint32_t bin = (uint32_t)(maf * 2.0 * s->nbins);
+    if (bin >= s->nbins) bin = s->nbins - 1;
+    size_t per = s->per + (bin < s->extra);
+    size_t* res = s->idx + _vp_strat_start(s, bin);
+    size_t k = s->seen[bin]++;
+    if (k < per) res[k] = b->first + i;
+    else {
+      uint64_t r = vp_rng_bounded(s->rng, k + 1);
+      if (r < per) res[r] = b->first + i;
+    }
+  }
+  return 0;
+}
+
+/*
+  @brief
+  Gather the bin reservoirs to the front of `idx`, ascending, and
+  free the state
+
+  @returns number of indices written
+*/
+static inline size_t vp_strat_finish(vp_strat_t* s) {
+  size_t n = 0;
+  for (uint32_t b = 0; b < s->nbins; b++) {
+    size_t per = s->per + (b < s->extra);
+    size_t c = s->seen[b] < per ? s->seen[b] : per;
+    memmove(s->idx + n, s->idx + _vp_strat_start(s, b), c * sizeof(size_t));
+    n += c;
+  }
+  vp_free(VP_MEM_SCRATCH, s->seen, s->nbins * sizeof(size_t));
+  s->seen = NULL;
+  qsort(s->idx, n, sizeof(size_t), _vp_size_cmp);
+  return n;
+}
+
+/*
+  @brief
+  Stratified random sample of a matrix (see `vp_strat_t`). Frequencies
+  are taken from the packed rows, so nothing is decoded. Indices are
+  returned ascending.
+
+  @param mat    packed matrix
+  @param nbins  number of MAF bins
+  @param m      total sample size
+  @param rng    random generator
+  @param idx    output indices, len >= m
+
+  @returns number of indices written, at most `m`, fewer when bins hold
+           fewer sites than their share; -1: out of memory
+*/
+static inline long vp_sample_stratified(const vp_mat_t* mat, uint32_t nbins, size_t m, vp_rng_t* rng, size_t* idx) {
+  vp_strat_t s;
+  if (vp_strat_init(&s, nbins, m, rng, idx)) return -1;
+  vp_mat_visit(mat, vp_visit_stratified, &s);
+  return (long)vp_strat_finish(&s);
+}
+
+/*
+  Uniform genomic stride: keep the first selected site of every
+  `stride` bp window on each chromosome. Sites must be in genomic
+  order.
+*/
+typedef struct
+{
+  uint32_t stride;
+  uint64_t last;   // chromosome and window of the last kept site
+  size_t* idx;     // kept sites, by `first + i`
+  size_t n;
+} vp_stride_t;
+
+static inline void vp_stride_init(vp_stride_t* s, uint32_t stride, size_t* idx) {
+  s->stride = stride ? stride : 1;
+  s->last = UINT64_MAX;
+  s->idx = idx;
+  s->n = 0;
+}
+
+static inline int vp_visit_stride(vp_batch_t* b, void* ud) {
+  vp_stride_t* s = (vp_stride_t*)ud;
+  VP_BATCH_EACH(b, i) {
+    vpack64_t v = b->sites[i];
+    uint64_t chrom = (v >> 32) & VMASK_5;
+    uint64_t win = ((v >> 4) & VMASK_28) / s->stride;
+    uint64_t key = (chrom << 32) | win;
+    if (key != s->last) {
+      s->idx[s->n++] = b->first + i;
+      s->last = key;
+    }
+  }
+  return 0;
+}
+
+/*
+  @brief
+  Uniform genomic stride sample of a matrix (see `vp_stride_t`)
+
+  @param mat    packed matrix
+  @param stride window size in bp
+  @param idx    output indices, len >= mat->nsites
+
+  @returns number of indices written
+*/
+static inline size_t vp_sample_stride(const vp_mat_t* mat, uint32_t stride, size_t* idx) {
+  vp_stride_t s;
+  vp_stride_init(&s, stride, idx);
+  vp_mat_visit(mat, vp_visit_stride, &s);
+  return s.n;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             CRC32C
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#define VP_CRC32C_POLY 0x82f63b78u
+
+static const uint32_t vp_crc32c_table[256] = {
+  0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c,
+  0x26a1e7e8, 0xd4ca64eb, 0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+  0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24, 0x105ec76f, 0xe235446c,
+  0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+  0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc,
+  0xbc267848, 0x4e4dfb4b, 0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+  0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35, 0xaa64d611, 0x580f5512,
+  0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+  0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad,
+  0x1642ae59, 0xe4292d5a, 0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+  0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595, 0x417b1dbc, 0xb3109ebf,
+  0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+  0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f,
+  0xed03a29b, 0x1f682198, 0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+  0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38, 0xdbfc821c, 0x2997011f,
+  0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+  0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e,
+  0x4767748a, 0xb50cf789, 0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+  0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46, 0x7198540d, 0x83f3d70e,
+  0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+  0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de,
+  0xdde0eb2a, 0x2f8b6829, 0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+  0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93, 0x082f63b7, 0xfa44e0b4,
+  0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+  0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b,
+  0xb4091bff, 0x466298fc, 0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+  0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033, 0xa24bb5a6, 0x502036a5,
+  0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+  0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975,
+  0x0e330a81, 0xfc588982, 0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+  0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622, 0x38cc2a06, 0xcaa7a905,
+  0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+  0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8,
+  0xe52cc12c, 0x1747422f, 0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+  0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0, 0xd3d3e1ab, 0x21b862a8,
+  0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+  0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78,
+  0x7fab5e8c, 0x8dc0dd8f, 0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+  0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1, 0x69e9f0d5, 0x9b8273d6,
+  0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+  0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69,
+  0xd5cf889d, 0x27a40b9e, 0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+  0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+};
+
+/*
+  @brief
+  Table-driven CRC32C, used when SSE4.2 is not available
+*/
+static inline uint32_t vp_crc32c_sw(uint32_t crc, const void* buf, size_t len) {
+  const uint8_t* p = (const uint8_t*)buf;
+  crc = ~crc;
+  while (len--) crc = vp_crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+/* a*b modulo the CRC32C polynomial, bit-reflected */
+static inline uint32_t _vp_crc32c_multmodp(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31, p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0) break;
+    }
+    m >>= 1;
+    b = b & 1 ? (b >> 1) ^ VP_CRC32C_POLY : b >> 1;
+  }
+  return p;
+}
+
+/*
+  @brief
+  Combine CRCs of two adjacent buffers: given crc(A) and crc(B), return
+  crc(A||B). `len2` is the length of B in bytes.
+*/
+static inline uint32_t vp_crc32c_combine(uint32_t crc1, uint32_t crc2, size_t len2) {
+  uint32_t x = 1u << 30;           /* x^1 */
+  uint32_t p = 1u << 31;           /* x^0 */
+  uint64_t n = (uint64_t)len2 << 3;
+  while (n) {
+    if (n & 1) p = _vp_crc32c_multmodp(x, p);
+    x = _vp_crc32c_multmodp(x, x);
+    n >>= 1;
+  }
+  return _vp_crc32c_multmodp(p, crc1) ^ crc2;
+}
+
+#if (defined(__SSE4_2__) && defined(__x86_64__)) || defined(VP_DISPATCH_X86)
+#ifndef _VP_TARGET
+#define _VP_TARGET(isa)
+#endif
+/* stream lengths of the three-way split, and the tables that shift a raw CRC register past them */
+#define VP_CRC32C_LONG  8192
+#define VP_CRC32C_SHORT 256
+
+static const uint32_t _vp_crc32c_long[4][256] = {
+  {
+    0x00000000, 0xe040e0ac, 0xc56db7a9, 0x252d5705, 0x8f3719a3, 0x6f77f90f,
+    0x4a5aae0a, 0xaa1a4ea6, 0x1b8245b7, 0xfbc2a51b, 0xdeeff21e, 0x3eaf12b2,
+    0x94b55c14, 0x74f5bcb8, 0x51d8ebbd, 0xb1980b11, 0x37048b6e, 0xd7446bc2,
+    0xf2693cc7, 0x1229dc6b, 0xb83392cd, 0x58737261, 0x7d5e2564, 0x9d1ec5c8,
+    0x2c86ced9, 0xccc62e75, 0xe9eb7970, 0x09ab99dc, 0xa3b1d77a, 0x43f137d6,
+    0x66dc60d3, 0x869c807f, 0x6e0916dc, 0x8e49f670, 0xab64a175, 0x4b2441d9,
+    0xe13e0f7f, 0x017eefd3, 0x2453b8d6, 0xc413587a, 0x758b536b, 0x95cbb3c7,
+    0xb0e6e4c2, 0x50a6046e, 0xfabc4ac8, 0x1afcaa64, 0x3fd1fd61, 0xdf911dcd,
+    0x590d9db2, 0xb94d7d1e, 0x9c602a1b, 0x7c20cab7, 0xd63a8411, 0x367a64bd,
+    0x135733b8, 0xf317d314, 0x428fd805, 0xa2cf38a9, 0x87e26fac, 0x67a28f00,
+    0xcdb8c1a6, 0x2df8210a, 0x08d5760f, 0xe89596a3, 0xdc122db8, 0x3c52cd14,
+    0x197f9a11, 0xf93f7abd, 0x5325341b, 0xb365d4b7, 0x964883b2, 0x7608631e,
+    0xc790680f, 0x27d088a3, 0x02fddfa6, 0xe2bd3f0a, 0x48a771ac, 0xa8e79100,
+    0x8dcac605, 0x6d8a26a9, 0xeb16a6d6, 0x0b56467a, 0x2e7b117f, 0xce3bf1d3,
+    0x6421bf75, 0x84615fd9, 0xa14c08dc, 0x410ce870, 0xf094e361, 0x10d403cd,
+    0x35f954c8, 0xd5b9b464, 0x7fa3fac2, 0x9fe31a6e, 0xbace4d6b, 0x5a8eadc7,
+    0xb21b3b64, 0x525bdbc8, 0x77768ccd, 0x97366c61, 0x3d2c22c7, 0xdd6cc26b,
+    0xf841956e, 0x180175c2, 0xa9997ed3, 0x49d99e7f, 0x6cf4c97a, 0x8cb429d6,
+    0x26ae6770, 0xc6ee87dc, 0xe3c3d0d9, 0x03833075, 0x851fb00a, 0x655f50a6,
+    0x407207a3, 0xa032e70f, 0x0a28a9a9, 0xea684905, 0xcf451e00, 0x2f05feac,
+    0x9e9df5bd, 0x7edd1511, 0x5bf04214, 0xbbb0a2b8, 0x11aaec1e, 0xf1ea0cb2,
+    0xd4c75bb7, 0x3487bb1b, 0xbdc82d81, 0x5d88cd2d, 0x78a59a28, 0x98e57a84,
+    0x32ff3422, 0xd2bfd48e, 0xf792838b, 0x17d26327, 0xa64a6836, 0x460a889a,
+    0x6327df9f, 0x83673f33, 0x297d7195, 0xc93d9139, 0xec10c63c, 0x0c502690,
+    0x8acca6ef, 0x6a8c4643, 0x4fa11146, 0xafe1f1ea, 0x05fbbf4c, 0xe5bb5fe0,
+    0xc09608e5, 0x20d6e849, 0x914ee358, 0x710e03f4, 0x542354f1, 0xb463b45d,
+    0x1e79fafb, 0xfe391a57, 0xdb144d52, 0x3b54adfe, 0xd3c13b5d, 0x3381dbf1,
+    0x16ac8cf4, 0xf6ec6c58, 0x5cf622fe, 0xbcb6c252, 0x999b9557, 0x79db75fb,
+    0xc8437eea, 0x28039e46, 0x0d2ec943, 0xed6e29ef, 0x47746749, 0xa73487e5,
+    0x8219d0e0, 0x6259304c, 0xe4c5b033, 0x0485509f, 0x21a8079a, 0xc1e8e736,
+    0x6bf2a990, 0x8bb2493c, 0xae9f1e39, 0x4edffe95, 0xff47f584, 0x1f071528,
+    0x3a2a422d, 0xda6aa281, 0x7070ec27, 0x90300c8b, 0xb51d5b8e, 0x555dbb22,
+    0x61da0039, 0x819ae095, 0xa4b7b790, 0x44f7573c, 0xeeed199a, 0x0eadf936,
+    0x2b80ae33, 0xcbc04e9f, 0x7a58458e, 0x9a18a522, 0xbf35f227, 0x5f75128b,
+    0xf56f5c2d, 0x152fbc81, 0x3002eb84, 0xd0420b28, 0x56de8b57, 0xb69e6bfb,
+    0x93b33cfe, 0x73f3dc52, 0xd9e992f4, 0x39a97258, 0x1c84255d, 0xfcc4c5f1,
+    0x4d5ccee0, 0xad1c2e4c, 0x88317949, 0x687199e5, 0xc26bd743, 0x222b37ef,
+    0x070660ea, 0xe7468046, 0x0fd316e5, 0xef93f649, 0xcabea14c, 0x2afe41e0,
+    0x80e40f46, 0x60a4efea, 0x4589b8ef, 0xa5c95843, 0x14515352, 0xf411b3fe,
+    0xd13ce4fb, 0x317c0457, 0x9b664af1, 0x7b26aa5d, 0x5e0bfd58, 0xbe4b1df4,
+    0x38d79d8b, 0xd8977d27, 0xfdba2a22, 0x1dfaca8e, 0xb7e08428, 0x57a06484,
+    0x728d3381, 0x92cdd32d, 0x2355d83c, 0xc3153890, 0xe6386f95, 0x06788f39,
+    0xac62c19f, 0x4c222133, 0x690f7636, 0x894f969a
+  },
+  {
+    0x00000000, 0x7e7c2df3, 0xfcf85be6, 0x82847615, 0xfc1cc13d, 0x8260ecce,
+    0x00e49adb, 0x7e98b728, 0xfdd5f48b, 0x83a9d978, 0x012daf6d, 0x7f51829e,
+    0x01c935b6, 0x7fb51845, 0xfd316e50, 0x834d43a3, 0xfe479fe7, 0x803bb214,
+    0x02bfc401, 0x7cc3e9f2, 0x025b5eda, 0x7c277329, 0xfea3053c, 0x80df28cf,
+    0x03926b6c, 0x7dee469f, 0xff6a308a, 0x81161d79, 0xff8eaa51, 0x81f287a2,
+    0x0376f1b7, 0x7d0adc44, 0xf963493f, 0x871f64cc, 0x059b12d9, 0x7be73f2a,
+    0x057f8802, 0x7b03a5f1, 0xf987d3e4, 0x87fbfe17, 0x04b6bdb4, 0x7aca9047,
+    0xf84ee652, 0x8632cba1, 0xf8aa7c89, 0x86d6517a, 0x0452276f, 0x7a2e0a9c,
+    0x0724d6d8, 0x7958fb2b, 0xfbdc8d3e, 0x85a0a0cd, 0xfb3817e5, 0x85443a16,
+    0x07c04c03, 0x79bc61f0, 0xfaf12253, 0x848d0fa0, 0x060979b5, 0x78755446,
+    0x06ede36e, 0x7891ce9d, 0xfa15b888, 0x8469957b, 0xf72ae48f, 0x8956c97c,
+    0x0bd2bf69, 0x75ae929a, 0x0b3625b2, 0x754a0841, 0xf7ce7e54, 0x89b253a7,
+    0x0aff1004, 0x74833df7, 0xf6074be2, 0x887b6611, 0xf6e3d139, 0x889ffcca,
+    0x0a1b8adf, 0x7467a72c, 0x096d7b68, 0x7711569b, 0xf595208e, 0x8be90d7d,
+    0xf571ba55, 0x8b0d97a6, 0x0989e1b3, 0x77f5cc40, 0xf4b88fe3, 0x8ac4a210,
+    0x0840d405, 0x763cf9f6, 0x08a44ede, 0x76d8632d, 0xf45c1538, 0x8a2038cb,
+    0x0e49adb0, 0x70358043, 0xf2b1f656, 0x8ccddba5, 0xf2556c8d, 0x8c29417e,
+    0x0ead376b, 0x70d11a98, 0xf39c593b, 0x8de074c8, 0x0f6402dd, 0x71182f2e,
+    0x0f809806, 0x71fcb5f5, 0xf378c3e0, 0x8d04ee13, 0xf00e3257, 0x8e721fa4,
+    0x0cf669b1, 0x728a4442, 0x0c12f36a, 0x726ede99, 0xf0eaa88c, 0x8e96857f,
+    0x0ddbc6dc, 0x73a7eb2f, 0xf1239d3a, 0x8f5fb0c9, 0xf1c707e1, 0x8fbb2a12,
+    0x0d3f5c07, 0x734371f4, 0xebb9bfef, 0x95c5921c, 0x1741e409, 0x693dc9fa,
+    0x17a57ed2, 0x69d95321, 0xeb5d2534, 0x952108c7, 0x166c4b64, 0x68106697,
+    0xea941082, 0x94e83d71, 0xea708a59, 0x940ca7aa, 0x1688d1bf, 0x68f4fc4c,
+    0x15fe2008, 0x6b820dfb, 0xe9067bee, 0x977a561d, 0xe9e2e135, 0x979eccc6,
+    0x151abad3, 0x6b669720, 0xe82bd483, 0x9657f970, 0x14d38f65, 0x6aafa296,
+    0x143715be, 0x6a4b384d, 0xe8cf4e58, 0x96b363ab, 0x12daf6d0, 0x6ca6db23,
+    0xee22ad36, 0x905e80c5, 0xeec637ed, 0x90ba1a1e, 0x123e6c0b, 0x6c4241f8,
+    0xef0f025b, 0x91732fa8, 0x13f759bd, 0x6d8b744e, 0x1313c366, 0x6d6fee95,
+    0xefeb9880, 0x9197b573, 0xec9d6937, 0x92e144c4, 0x106532d1, 0x6e191f22,
+    0x1081a80a, 0x6efd85f9, 0xec79f3ec, 0x9205de1f, 0x11489dbc, 0x6f34b04f,
+    0xedb0c65a, 0x93cceba9, 0xed545c81, 0x93287172, 0x11ac0767, 0x6fd02a94,
+    0x1c935b60, 0x62ef7693, 0xe06b0086, 0x9e172d75, 0xe08f9a5d, 0x9ef3b7ae,
+    0x1c77c1bb, 0x620bec48, 0xe146afeb, 0x9f3a8218, 0x1dbef40d, 0x63c2d9fe,
+    0x1d5a6ed6, 0x63264325, 0xe1a23530, 0x9fde18c3, 0xe2d4c487, 0x9ca8e974,
+    0x1e2c9f61, 0x6050b292, 0x1ec805ba, 0x60b42849, 0xe2305e5c, 0x9c4c73af,
+    0x1f01300c, 0x617d1dff, 0xe3f96bea, 0x9d854619, 0xe31df131, 0x9d61dcc2,
+    0x1fe5aad7, 0x61998724, 0xe5f0125f, 0x9b8c3fac, 0x190849b9, 0x6774644a,
+    0x19ecd362, 0x6790fe91, 0xe5148884, 0x9b68a577, 0x1825e6d4, 0x6659cb27,
+    0xe4ddbd32, 0x9aa190c1, 0xe43927e9, 0x9a450a1a, 0x18c17c0f, 0x66bd51fc,
+    0x1bb78db8, 0x65cba04b, 0xe74fd65e, 0x9933fbad, 0xe7ab4c85, 0x99d76176,
+    0x1b531763, 0x652f3a90, 0xe6627933, 0x981e54c0, 0x1a9a22d5, 0x64e60f26,
+    0x1a7eb80e, 0x640295fd, 0xe686e3e8, 0x98face1b
+  },
+  {
+    0x00000000, 0xd29f092f, 0xa0d264af, 0x724d6d80, 0x4448bfaf, 0x96d7b680,
+    0xe49adb00, 0x3605d22f, 0x88917f5e, 0x5a0e7671, 0x28431bf1, 0xfadc12de,
+    0xccd9c0f1, 0x1e46c9de, 0x6c0ba45e, 0xbe94ad71, 0x14ce884d, 0xc6518162,
+    0xb41cece2, 0x6683e5cd, 0x508637e2, 0x82193ecd, 0xf054534d, 0x22cb5a62,
+    0x9c5ff713, 0x4ec0fe3c, 0x3c8d93bc, 0xee129a93, 0xd81748bc, 0x0a884193,
+    0x78c52c13, 0xaa5a253c, 0x299d109a, 0xfb0219b5, 0x894f7435, 0x5bd07d1a,
+    0x6dd5af35, 0xbf4aa61a, 0xcd07cb9a, 0x1f98c2b5, 0xa10c6fc4, 0x739366eb,
+    0x01de0b6b, 0xd3410244, 0xe544d06b, 0x37dbd944, 0x4596b4c4, 0x9709bdeb,
+    0x3d5398d7, 0xefcc91f8, 0x9d81fc78, 0x4f1ef557, 0x791b2778, 0xab842e57,
+    0xd9c943d7, 0x0b564af8, 0xb5c2e789, 0x675deea6, 0x15108326, 0xc78f8a09,
+    0xf18a5826, 0x23155109, 0x51583c89, 0x83c735a6, 0x533a2134, 0x81a5281b,
+    0xf3e8459b, 0x21774cb4, 0x17729e9b, 0xc5ed97b4, 0xb7a0fa34, 0x653ff31b,
+    0xdbab5e6a, 0x09345745, 0x7b793ac5, 0xa9e633ea, 0x9fe3e1c5, 0x4d7ce8ea,
+    0x3f31856a, 0xedae8c45, 0x47f4a979, 0x956ba056, 0xe726cdd6, 0x35b9c4f9,
+    0x03bc16d6, 0xd1231ff9, 0xa36e7279, 0x71f17b56, 0xcf65d627, 0x1dfadf08,
+    0x6fb7b288, 0xbd28bba7, 0x8b2d6988, 0x59b260a7, 0x2bff0d27, 0xf9600408,
+    0x7aa731ae, 0xa8383881, 0xda755501, 0x08ea5c2e, 0x3eef8e01, 0xec70872e,
+    0x9e3deaae, 0x4ca2e381, 0xf2364ef0, 0x20a947df, 0x52e42a5f, 0x807b2370,
+    0xb67ef15f, 0x64e1f870, 0x16ac95f0, 0xc4339cdf, 0x6e69b9e3, 0xbcf6b0cc,
+    0xcebbdd4c, 0x1c24d463, 0x2a21064c, 0xf8be0f63, 0x8af362e3, 0x586c6bcc,
+    0xe6f8c6bd, 0x3467cf92, 0x462aa212, 0x94b5ab3d, 0xa2b07912, 0x702f703d,
+    0x02621dbd, 0xd0fd1492, 0xa6744268, 0x74eb4b47, 0x06a626c7, 0xd4392fe8,
+    0xe23cfdc7, 0x30a3f4e8, 0x42ee9968, 0x90719047, 0x2ee53d36, 0xfc7a3419,
+    0x8e375999, 0x5ca850b6, 0x6aad8299, 0xb8328bb6, 0xca7fe636, 0x18e0ef19,
+    0xb2baca25, 0x6025c30a, 0x1268ae8a, 0xc0f7a7a5, 0xf6f2758a, 0x246d7ca5,
+    0x56201125, 0x84bf180a, 0x3a2bb57b, 0xe8b4bc54, 0x9af9d1d4, 0x4866d8fb,
+    0x7e630ad4, 0xacfc03fb, 0xdeb16e7b, 0x0c2e6754, 0x8fe952f2, 0x5d765bdd,
+    0x2f3b365d, 0xfda43f72, 0xcba1ed5d, 0x193ee472, 0x6b7389f2, 0xb9ec80dd,
+    0x07782dac, 0xd5e72483, 0xa7aa4903, 0x7535402c, 0x43309203, 0x91af9b2c,
+    0xe3e2f6ac, 0x317dff83, 0x9b27dabf, 0x49b8d390, 0x3bf5be10, 0xe96ab73f,
+    0xdf6f6510, 0x0df06c3f, 0x7fbd01bf, 0xad220890, 0x13b6a5e1, 0xc129acce,
+    0xb364c14e, 0x61fbc861, 0x57fe1a4e, 0x85611361, 0xf72c7ee1, 0x25b377ce,
+    0xf54e635c, 0x27d16a73, 0x559c07f3, 0x87030edc, 0xb106dcf3, 0x6399d5dc,
+    0x11d4b85c, 0xc34bb173, 0x7ddf1c02, 0xaf40152d, 0xdd0d78ad, 0x0f927182,
+    0x3997a3ad, 0xeb08aa82, 0x9945c702, 0x4bdace2d, 0xe180eb11, 0x331fe23e,
+    0x41528fbe, 0x93cd8691, 0xa5c854be, 0x77575d91, 0x051a3011, 0xd785393e,
+    0x6911944f, 0xbb8e9d60, 0xc9c3f0e0, 0x1b5cf9cf, 0x2d592be0, 0xffc622cf,
+    0x8d8b4f4f, 0x5f144660, 0xdcd373c6, 0x0e4c7ae9, 0x7c011769, 0xae9e1e46,
+    0x989bcc69, 0x4a04c546, 0x3849a8c6, 0xead6a1e9, 0x54420c98, 0x86dd05b7,
+    0xf4906837, 0x260f6118, 0x100ab337, 0xc295ba18, 0xb0d8d798, 0x6247deb7,
+    0xc81dfb8b, 0x1a82f2a4, 0x68cf9f24, 0xba50960b, 0x8c554424, 0x5eca4d0b,
+    0x2c87208b, 0xfe1829a4, 0x408c84d5, 0x92138dfa, 0xe05ee07a, 0x32c1e955,
+    0x04c43b7a, 0xd65b3255, 0xa4165fd5, 0x768956fa
+  },
+  {
+    0x00000000, 0x4904f221, 0x9209e442, 0xdb0d1663, 0x21ffbe75, 0x68fb4c54,
+    0xb3f65a37, 0xfaf2a816, 0x43ff7cea, 0x0afb8ecb, 0xd1f698a8, 0x98f26a89,
+    0x6200c29f, 0x2b0430be, 0xf00926dd, 0xb90dd4fc, 0x87fef9d4, 0xcefa0bf5,
+    0x15f71d96, 0x5cf3efb7, 0xa60147a1, 0xef05b580, 0x3408a3e3, 0x7d0c51c2,
+    0xc401853e, 0x8d05771f, 0x5608617c, 0x1f0c935d, 0xe5fe3b4b, 0xacfac96a,
+    0x77f7df09, 0x3ef32d28, 0x0a118559, 0x43157778, 0x9818611b, 0xd11c933a,
+    0x2bee3b2c, 0x62eac90d, 0xb9e7df6e, 0xf0e32d4f, 0x49eef9b3, 0x00ea0b92,
+    0xdbe71df1, 0x92e3efd0, 0x681147c6, 0x2115b5e7, 0xfa18a384, 0xb31c51a5,
+    0x8def7c8d, 0xc4eb8eac, 0x1fe698cf, 0x56e26aee, 0xac10c2f8, 0xe51430d9,
+    0x3e1926ba, 0x771dd49b, 0xce100067, 0x8714f246, 0x5c19e425, 0x151d1604,
+    0xefefbe12, 0xa6eb4c33, 0x7de65a50, 0x34e2a871, 0x14230ab2, 0x5d27f893,
+    0x862aeef0, 0xcf2e1cd1, 0x35dcb4c7, 0x7cd846e6, 0xa7d55085, 0xeed1a2a4,
+    0x57dc7658, 0x1ed88479, 0xc5d5921a, 0x8cd1603b, 0x7623c82d, 0x3f273a0c,
+    0xe42a2c6f, 0xad2ede4e, 0x93ddf366, 0xdad90147, 0x01d41724, 0x48d0e505,
+    0xb2224d13, 0xfb26bf32, 0x202ba951, 0x692f5b70, 0xd0228f8c, 0x99267dad,
+    0x422b6bce, 0x0b2f99ef, 0xf1dd31f9, 0xb8d9c3d8, 0x63d4d5bb, 0x2ad0279a,
+    0x1e328feb, 0x57367dca, 0x8c3b6ba9, 0xc53f9988, 0x3fcd319e, 0x76c9c3bf,
+    0xadc4d5dc, 0xe4c027fd, 0x5dcdf301, 0x14c90120, 0xcfc41743, 0x86c0e562,
+    0x7c324d74, 0x3536bf55, 0xee3ba936, 0xa73f5b17, 0x99cc763f, 0xd0c8841e,
+    0x0bc5927d, 0x42c1605c, 0xb833c84a, 0xf1373a6b, 0x2a3a2c08, 0x633ede29,
+    0xda330ad5, 0x9337f8f4, 0x483aee97, 0x013e1cb6, 0xfbccb4a0, 0xb2c84681,
+    0x69c550e2, 0x20c1a2c3, 0x28461564, 0x6142e745, 0xba4ff126, 0xf34b0307,
+    0x09b9ab11, 0x40bd5930, 0x9bb04f53, 0xd2b4bd72, 0x6bb9698e, 0x22bd9baf,
+    0xf9b08dcc, 0xb0b47fed, 0x4a46d7fb, 0x034225da, 0xd84f33b9, 0x914bc198,
+    0xafb8ecb0, 0xe6bc1e91, 0x3db108f2, 0x74b5fad3, 0x8e4752c5, 0xc743a0e4,
+    0x1c4eb687, 0x554a44a6, 0xec47905a, 0xa543627b, 0x7e4e7418, 0x374a8639,
+    0xcdb82e2f, 0x84bcdc0e, 0x5fb1ca6d, 0x16b5384c, 0x2257903d, 0x6b53621c,
+    0xb05e747f, 0xf95a865e, 0x03a82e48, 0x4aacdc69, 0x91a1ca0a, 0xd8a5382b,
+    0x61a8ecd7, 0x28ac1ef6, 0xf3a10895, 0xbaa5fab4, 0x405752a2, 0x0953a083,
+    0xd25eb6e0, 0x9b5a44c1, 0xa5a969e9, 0xecad9bc8, 0x37a08dab, 0x7ea47f8a,
+    0x8456d79c, 0xcd5225bd, 0x165f33de, 0x5f5bc1ff, 0xe6561503, 0xaf52e722,
+    0x745ff141, 0x3d5b0360, 0xc7a9ab76, 0x8ead5957, 0x55a04f34, 0x1ca4bd15,
+    0x3c651fd6, 0x7561edf7, 0xae6cfb94, 0xe76809b5, 0x1d9aa1a3, 0x549e5382,
+    0x8f9345e1, 0xc697b7c0, 0x7f9a633c, 0x369e911d, 0xed93877e, 0xa497755f,
+    0x5e65dd49, 0x17612f68, 0xcc6c390b, 0x8568cb2a, 0xbb9be602, 0xf29f1423,
+    0x29920240, 0x6096f061, 0x9a645877, 0xd360aa56, 0x086dbc35, 0x41694e14,
+    0xf8649ae8, 0xb16068c9, 0x6a6d7eaa, 0x23698c8b, 0xd99b249d, 0x909fd6bc,
+    0x4b92c0df, 0x029632fe, 0x36749a8f, 0x7f7068ae, 0xa47d7ecd, 0xed798cec,
+    0x178b24fa, 0x5e8fd6db, 0x8582c0b8, 0xcc863299, 0x758be665, 0x3c8f1444,
+    0xe7820227, 0xae86f006, 0x54745810, 0x1d70aa31, 0xc67dbc52, 0x8f794e73,
+    0xb18a635b, 0xf88e917a, 0x23838719, 0x6a877538, 0x9075dd2e, 0xd9712f0f,
+    0x027c396c, 0x4b78cb4d, 0xf2751fb1, 0xbb71ed90, 0x607cfbf3, 0x297809d2,
+    0xd38aa1c4, 0x9a8e53e5, 0x41834586, 0x0887b7a7
+  }
+};
+
+static const uint32_t _vp_crc32c_short[4][256] = {
+  {
+    0x00000000, 0xdcb17aa4, 0xbc8e83b9, 0x603ff91d, 0x7cf17183, 0xa0400b27,
+    0xc07ff23a, 0x1cce889e, 0xf9e2e306, 0x255399a2, 0x456c60bf, 0x99dd1a1b,
+    0x85139285, 0x59a2e821, 0x399d113c, 0xe52c6b98, 0xf629b0fd, 0x2a98ca59,
+    0x4aa73344, 0x961649e0, 0x8ad8c17e, 0x5669bbda, 0x365642c7, 0xeae73863,
+    0x0fcb53fb, 0xd37a295f, 0xb345d042, 0x6ff4aae6, 0x733a2278, 0xaf8b58dc,
+    0xcfb4a1c1, 0x1305db65, 0xe9bf170b, 0x350e6daf, 0x553194b2, 0x8980ee16,
+    0x954e6688, 0x49ff1c2c, 0x29c0e531, 0xf5719f95, 0x105df40d, 0xccec8ea9,
+    0xacd377b4, 0x70620d10, 0x6cac858e, 0xb01dff2a, 0xd0220637, 0x0c937c93,
+    0x1f96a7f6, 0xc327dd52, 0xa318244f, 0x7fa95eeb, 0x6367d675, 0xbfd6acd1,
+    0xdfe955cc, 0x03582f68, 0xe67444f0, 0x3ac53e54, 0x5afac749, 0x864bbded,
+    0x9a853573, 0x46344fd7, 0x260bb6ca, 0xfabacc6e, 0xd69258e7, 0x0a232243,
+    0x6a1cdb5e, 0xb6ada1fa, 0xaa632964, 0x76d253c0, 0x16edaadd, 0xca5cd079,
+    0x2f70bbe1, 0xf3c1c145, 0x93fe3858, 0x4f4f42fc, 0x5381ca62, 0x8f30b0c6,
+    0xef0f49db, 0x33be337f, 0x20bbe81a, 0xfc0a92be, 0x9c356ba3, 0x40841107,
+    0x5c4a9999, 0x80fbe33d, 0xe0c41a20, 0x3c756084, 0xd9590b1c, 0x05e871b8,
+    0x65d788a5, 0xb966f201, 0xa5a87a9f, 0x7919003b, 0x1926f926, 0xc5978382,
+    0x3f2d4fec, 0xe39c3548, 0x83a3cc55, 0x5f12b6f1, 0x43dc3e6f, 0x9f6d44cb,
+    0xff52bdd6, 0x23e3c772, 0xc6cfacea, 0x1a7ed64e, 0x7a412f53, 0xa6f055f7,
+    0xba3edd69, 0x668fa7cd, 0x06b05ed0, 0xda012474, 0xc904ff11, 0x15b585b5,
+    0x758a7ca8, 0xa93b060c, 0xb5f58e92, 0x6944f436, 0x097b0d2b, 0xd5ca778f,
+    0x30e61c17, 0xec5766b3, 0x8c689fae, 0x50d9e50a, 0x4c176d94, 0x90a61730,
+    0xf099ee2d, 0x2c289489, 0xa8c8c73f, 0x7479bd9b, 0x14464486, 0xc8f73e22,
+    0xd439b6bc, 0x0888cc18, 0x68b73505, 0xb4064fa1, 0x512a2439, 0x8d9b5e9d,
+    0xeda4a780, 0x3115dd24, 0x2ddb55ba, 0xf16a2f1e, 0x9155d603, 0x4de4aca7,
+    0x5ee177c2, 0x82500d66, 0xe26ff47b, 0x3ede8edf, 0x22100641, 0xfea17ce5,
+    0x9e9e85f8, 0x422fff5c, 0xa70394c4, 0x7bb2ee60, 0x1b8d177d, 0xc73c6dd9,
+    0xdbf2e547, 0x07439fe3, 0x677c66fe, 0xbbcd1c5a, 0x4177d034, 0x9dc6aa90,
+    0xfdf9538d, 0x21482929, 0x3d86a1b7, 0xe137db13, 0x8108220e, 0x5db958aa,
+    0xb8953332, 0x64244996, 0x041bb08b, 0xd8aaca2f, 0xc46442b1, 0x18d53815,
+    0x78eac108, 0xa45bbbac, 0xb75e60c9, 0x6bef1a6d, 0x0bd0e370, 0xd76199d4,
+    0xcbaf114a, 0x171e6bee, 0x772192f3, 0xab90e857, 0x4ebc83cf, 0x920df96b,
+    0xf2320076, 0x2e837ad2, 0x324df24c, 0xeefc88e8, 0x8ec371f5, 0x52720b51,
+    0x7e5a9fd8, 0xa2ebe57c, 0xc2d41c61, 0x1e6566c5, 0x02abee5b, 0xde1a94ff,
+    0xbe256de2, 0x62941746, 0x87b87cde, 0x5b09067a, 0x3b36ff67, 0xe78785c3,
+    0xfb490d5d, 0x27f877f9, 0x47c78ee4, 0x9b76f440, 0x88732f25, 0x54c25581,
+    0x34fdac9c, 0xe84cd638, 0xf4825ea6, 0x28332402, 0x480cdd1f, 0x94bda7bb,
+    0x7191cc23, 0xad20b687, 0xcd1f4f9a, 0x11ae353e, 0x0d60bda0, 0xd1d1c704,
+    0xb1ee3e19, 0x6d5f44bd, 0x97e588d3, 0x4b54f277, 0x2b6b0b6a, 0xf7da71ce,
+    0xeb14f950, 0x37a583f4, 0x579a7ae9, 0x8b2b004d, 0x6e076bd5, 0xb2b61171,
+    0xd289e86c, 0x0e3892c8, 0x12f61a56, 0xce4760f2, 0xae7899ef, 0x72c9e34b,
+    0x61cc382e, 0xbd7d428a, 0xdd42bb97, 0x01f3c133, 0x1d3d49ad, 0xc18c3309,
+    0xa1b3ca14, 0x7d02b0b0, 0x982edb28, 0x449fa18c, 0x24a05891, 0xf8112235,
+    0xe4dfaaab, 0x386ed00f, 0x58512912, 0x84e053b6
+  },
+  {
+    0x00000000, 0x547df88f, 0xa8fbf11e, 0xfc860991, 0x541b94cd, 0x00666c42,
+    0xfce065d3, 0xa89d9d5c, 0xa837299a, 0xfc4ad115, 0x00ccd884, 0x54b1200b,
+    0xfc2cbd57, 0xa85145d8, 0x54d74c49, 0x00aab4c6, 0x558225c5, 0x01ffdd4a,
+    0xfd79d4db, 0xa9042c54, 0x0199b108, 0x55e44987, 0xa9624016, 0xfd1fb899,
+    0xfdb50c5f, 0xa9c8f4d0, 0x554efd41, 0x013305ce, 0xa9ae9892, 0xfdd3601d,
+    0x0155698c, 0x55289103, 0xab044b8a, 0xff79b305, 0x03ffba94, 0x5782421b,
+    0xff1fdf47, 0xab6227c8, 0x57e42e59, 0x0399d6d6, 0x03336210, 0x574e9a9f,
+    0xabc8930e, 0xffb56b81, 0x5728f6dd, 0x03550e52, 0xffd307c3, 0xabaeff4c,
+    0xfe866e4f, 0xaafb96c0, 0x567d9f51, 0x020067de, 0xaa9dfa82, 0xfee0020d,
+    0x02660b9c, 0x561bf313, 0x56b147d5, 0x02ccbf5a, 0xfe4ab6cb, 0xaa374e44,
+    0x02aad318, 0x56d72b97, 0xaa512206, 0xfe2cda89, 0x53e4e1e5, 0x0799196a,
+    0xfb1f10fb, 0xaf62e874, 0x07ff7528, 0x53828da7, 0xaf048436, 0xfb797cb9,
+    0xfbd3c87f, 0xafae30f0, 0x53283961, 0x0755c1ee, 0xafc85cb2, 0xfbb5a43d,
+    0x0733adac, 0x534e5523, 0x0666c420, 0x521b3caf, 0xae9d353e, 0xfae0cdb1,
+    0x527d50ed, 0x0600a862, 0xfa86a1f3, 0xaefb597c, 0xae51edba, 0xfa2c1535,
+    0x06aa1ca4, 0x52d7e42b, 0xfa4a7977, 0xae3781f8, 0x52b18869, 0x06cc70e6,
+    0xf8e0aa6f, 0xac9d52e0, 0x501b5b71, 0x0466a3fe, 0xacfb3ea2, 0xf886c62d,
+    0x0400cfbc, 0x507d3733, 0x50d783f5, 0x04aa7b7a, 0xf82c72eb, 0xac518a64,
+    0x04cc1738, 0x50b1efb7, 0xac37e626, 0xf84a1ea9, 0xad628faa, 0xf91f7725,
+    0x05997eb4, 0x51e4863b, 0xf9791b67, 0xad04e3e8, 0x5182ea79, 0x05ff12f6,
+    0x0555a630, 0x51285ebf, 0xadae572e, 0xf9d3afa1, 0x514e32fd, 0x0533ca72,
+    0xf9b5c3e3, 0xadc83b6c, 0xa7c9c3ca, 0xf3b43b45, 0x0f3232d4, 0x5b4fca5b,
+    0xf3d25707, 0xa7afaf88, 0x5b29a619, 0x0f545e96, 0x0ffeea50, 0x5b8312df,
+    0xa7051b4e, 0xf378e3c1, 0x5be57e9d, 0x0f988612, 0xf31e8f83, 0xa763770c,
+    0xf24be60f, 0xa6361e80, 0x5ab01711, 0x0ecdef9e, 0xa65072c2, 0xf22d8a4d,
+    0x0eab83dc, 0x5ad67b53, 0x5a7ccf95, 0x0e01371a, 0xf2873e8b, 0xa6fac604,
+    0x0e675b58, 0x5a1aa3d7, 0xa69caa46, 0xf2e152c9, 0x0ccd8840, 0x58b070cf,
+    0xa436795e, 0xf04b81d1, 0x58d61c8d, 0x0cabe402, 0xf02ded93, 0xa450151c,
+    0xa4faa1da, 0xf0875955, 0x0c0150c4, 0x587ca84b, 0xf0e13517, 0xa49ccd98,
+    0x581ac409, 0x0c673c86, 0x594fad85, 0x0d32550a, 0xf1b45c9b, 0xa5c9a414,
+    0x0d543948, 0x5929c1c7, 0xa5afc856, 0xf1d230d9, 0xf178841f, 0xa5057c90,
+    0x59837501, 0x0dfe8d8e, 0xa56310d2, 0xf11ee85d, 0x0d98e1cc, 0x59e51943,
+    0xf42d222f, 0xa050daa0, 0x5cd6d331, 0x08ab2bbe, 0xa036b6e2, 0xf44b4e6d,
+    0x08cd47fc, 0x5cb0bf73, 0x5c1a0bb5, 0x0867f33a, 0xf4e1faab, 0xa09c0224,
+    0x08019f78, 0x5c7c67f7, 0xa0fa6e66, 0xf48796e9, 0xa1af07ea, 0xf5d2ff65,
+    0x0954f6f4, 0x5d290e7b, 0xf5b49327, 0xa1c96ba8, 0x5d4f6239, 0x09329ab6,
+    0x09982e70, 0x5de5d6ff, 0xa163df6e, 0xf51e27e1, 0x5d83babd, 0x09fe4232,
+    0xf5784ba3, 0xa105b32c, 0x5f2969a5, 0x0b54912a, 0xf7d298bb, 0xa3af6034,
+    0x0b32fd68, 0x5f4f05e7, 0xa3c90c76, 0xf7b4f4f9, 0xf71e403f, 0xa363b8b0,
+    0x5fe5b121, 0x0b9849ae, 0xa305d4f2, 0xf7782c7d, 0x0bfe25ec, 0x5f83dd63,
+    0x0aab4c60, 0x5ed6b4ef, 0xa250bd7e, 0xf62d45f1, 0x5eb0d8ad, 0x0acd2022,
+    0xf64b29b3, 0xa236d13c, 0xa29c65fa, 0xf6e19d75, 0x0a6794e4, 0x5e1a6c6b,
+    0xf687f137, 0xa2fa09b8, 0x5e7c0029, 0x0a01f8a6
+  },
+  {
+    0x00000000, 0x4a7ff165, 0x94ffe2ca, 0xde8013af, 0x2c13b365, 0x666c4200,
+    0xb8ec51af, 0xf293a0ca, 0x582766ca, 0x125897af, 0xccd88400, 0x86a77565,
+    0x7434d5af, 0x3e4b24ca, 0xe0cb3765, 0xaab4c600, 0xb04ecd94, 0xfa313cf1,
+    0x24b12f5e, 0x6ecede3b, 0x9c5d7ef1, 0xd6228f94, 0x08a29c3b, 0x42dd6d5e,
+    0xe869ab5e, 0xa2165a3b, 0x7c964994, 0x36e9b8f1, 0xc47a183b, 0x8e05e95e,
+    0x5085faf1, 0x1afa0b94, 0x6571edd9, 0x2f0e1cbc, 0xf18e0f13, 0xbbf1fe76,
+    0x49625ebc, 0x031dafd9, 0xdd9dbc76, 0x97e24d13, 0x3d568b13, 0x77297a76,
+    0xa9a969d9, 0xe3d698bc, 0x11453876, 0x5b3ac913, 0x85badabc, 0xcfc52bd9,
+    0xd53f204d, 0x9f40d128, 0x41c0c287, 0x0bbf33e2, 0xf92c9328, 0xb353624d,
+    0x6dd371e2, 0x27ac8087, 0x8d184687, 0xc767b7e2, 0x19e7a44d, 0x53985528,
+    0xa10bf5e2, 0xeb740487, 0x35f41728, 0x7f8be64d, 0xcae3dbb2, 0x809c2ad7,
+    0x5e1c3978, 0x1463c81d, 0xe6f068d7, 0xac8f99b2, 0x720f8a1d, 0x38707b78,
+    0x92c4bd78, 0xd8bb4c1d, 0x063b5fb2, 0x4c44aed7, 0xbed70e1d, 0xf4a8ff78,
+    0x2a28ecd7, 0x60571db2, 0x7aad1626, 0x30d2e743, 0xee52f4ec, 0xa42d0589,
+    0x56bea543, 0x1cc15426, 0xc2414789, 0x883eb6ec, 0x228a70ec, 0x68f58189,
+    0xb6759226, 0xfc0a6343, 0x0e99c389, 0x44e632ec, 0x9a662143, 0xd019d026,
+    0xaf92366b, 0xe5edc70e, 0x3b6dd4a1, 0x711225c4, 0x8381850e, 0xc9fe746b,
+    0x177e67c4, 0x5d0196a1, 0xf7b550a1, 0xbdcaa1c4, 0x634ab26b, 0x2935430e,
+    0xdba6e3c4, 0x91d912a1, 0x4f59010e, 0x0526f06b, 0x1fdcfbff, 0x55a30a9a,
+    0x8b231935, 0xc15ce850, 0x33cf489a, 0x79b0b9ff, 0xa730aa50, 0xed4f5b35,
+    0x47fb9d35, 0x0d846c50, 0xd3047fff, 0x997b8e9a, 0x6be82e50, 0x2197df35,
+    0xff17cc9a, 0xb5683dff, 0x902bc195, 0xda5430f0, 0x04d4235f, 0x4eabd23a,
+    0xbc3872f0, 0xf6478395, 0x28c7903a, 0x62b8615f, 0xc80ca75f, 0x8273563a,
+    0x5cf34595, 0x168cb4f0, 0xe41f143a, 0xae60e55f, 0x70e0f6f0, 0x3a9f0795,
+    0x20650c01, 0x6a1afd64, 0xb49aeecb, 0xfee51fae, 0x0c76bf64, 0x46094e01,
+    0x98895dae, 0xd2f6accb, 0x78426acb, 0x323d9bae, 0xecbd8801, 0xa6c27964,
+    0x5451d9ae, 0x1e2e28cb, 0xc0ae3b64, 0x8ad1ca01, 0xf55a2c4c, 0xbf25dd29,
+    0x61a5ce86, 0x2bda3fe3, 0xd9499f29, 0x93366e4c, 0x4db67de3, 0x07c98c86,
+    0xad7d4a86, 0xe702bbe3, 0x3982a84c, 0x73fd5929, 0x816ef9e3, 0xcb110886,
+    0x15911b29, 0x5feeea4c, 0x4514e1d8, 0x0f6b10bd, 0xd1eb0312, 0x9b94f277,
+    0x690752bd, 0x2378a3d8, 0xfdf8b077, 0xb7874112, 0x1d338712, 0x574c7677,
+    0x89cc65d8, 0xc3b394bd, 0x31203477, 0x7b5fc512, 0xa5dfd6bd, 0xefa027d8,
+    0x5ac81a27, 0x10b7eb42, 0xce37f8ed, 0x84480988, 0x76dba942, 0x3ca45827,
+    0xe2244b88, 0xa85bbaed, 0x02ef7ced, 0x48908d88, 0x96109e27, 0xdc6f6f42,
+    0x2efccf88, 0x64833eed, 0xba032d42, 0xf07cdc27, 0xea86d7b3, 0xa0f926d6,
+    0x7e793579, 0x3406c41c, 0xc69564d6, 0x8cea95b3, 0x526a861c, 0x18157779,
+    0xb2a1b179, 0xf8de401c, 0x265e53b3, 0x6c21a2d6, 0x9eb2021c, 0xd4cdf379,
+    0x0a4de0d6, 0x403211b3, 0x3fb9f7fe, 0x75c6069b, 0xab461534, 0xe139e451,
+    0x13aa449b, 0x59d5b5fe, 0x8755a651, 0xcd2a5734, 0x679e9134, 0x2de16051,
+    0xf36173fe, 0xb91e829b, 0x4b8d2251, 0x01f2d334, 0xdf72c09b, 0x950d31fe,
+    0x8ff73a6a, 0xc588cb0f, 0x1b08d8a0, 0x517729c5, 0xa3e4890f, 0xe99b786a,
+    0x371b6bc5, 0x7d649aa0, 0xd7d05ca0, 0x9dafadc5, 0x432fbe6a, 0x09504f0f,
+    0xfbc3efc5, 0xb1bc1ea0, 0x6f3c0d0f, 0x2543fc6a
+  },
+  {
+    0x00000000, 0x25bbf5db, 0x4b77ebb6, 0x6ecc1e6d, 0x96efd76c, 0xb35422b7,
+    0xdd983cda, 0xf823c901, 0x2833d829, 0x0d882df2, 0x6344339f, 0x46ffc644,
+    0xbedc0f45, 0x9b67fa9e, 0xf5abe4f3, 0xd0101128, 0x5067b052, 0x75dc4589,
+    0x1b105be4, 0x3eabae3f, 0xc688673e, 0xe33392e5, 0x8dff8c88, 0xa8447953,
+    0x7854687b, 0x5def9da0, 0x332383cd, 0x16987616, 0xeebbbf17, 0xcb004acc,
+    0xa5cc54a1, 0x8077a17a, 0xa0cf60a4, 0x8574957f, 0xebb88b12, 0xce037ec9,
+    0x3620b7c8, 0x139b4213, 0x7d575c7e, 0x58eca9a5, 0x88fcb88d, 0xad474d56,
+    0xc38b533b, 0xe630a6e0, 0x1e136fe1, 0x3ba89a3a, 0x55648457, 0x70df718c,
+    0xf0a8d0f6, 0xd513252d, 0xbbdf3b40, 0x9e64ce9b, 0x6647079a, 0x43fcf241,
+    0x2d30ec2c, 0x088b19f7, 0xd89b08df, 0xfd20fd04, 0x93ece369, 0xb65716b2,
+    0x4e74dfb3, 0x6bcf2a68, 0x05033405, 0x20b8c1de, 0x4472b7b9, 0x61c94262,
+    0x0f055c0f, 0x2abea9d4, 0xd29d60d5, 0xf726950e, 0x99ea8b63, 0xbc517eb8,
+    0x6c416f90, 0x49fa9a4b, 0x27368426, 0x028d71fd, 0xfaaeb8fc, 0xdf154d27,
+    0xb1d9534a, 0x9462a691, 0x141507eb, 0x31aef230, 0x5f62ec5d, 0x7ad91986,
+    0x82fad087, 0xa741255c, 0xc98d3b31, 0xec36ceea, 0x3c26dfc2, 0x199d2a19,
+    0x77513474, 0x52eac1af, 0xaac908ae, 0x8f72fd75, 0xe1bee318, 0xc40516c3,
+    0xe4bdd71d, 0xc10622c6, 0xafca3cab, 0x8a71c970, 0x72520071, 0x57e9f5aa,
+    0x3925ebc7, 0x1c9e1e1c, 0xcc8e0f34, 0xe935faef, 0x87f9e482, 0xa2421159,
+    0x5a61d858, 0x7fda2d83, 0x111633ee, 0x34adc635, 0xb4da674f, 0x91619294,
+    0xffad8cf9, 0xda167922, 0x2235b023, 0x078e45f8, 0x69425b95, 0x4cf9ae4e,
+    0x9ce9bf66, 0xb9524abd, 0xd79e54d0, 0xf225a10b, 0x0a06680a, 0x2fbd9dd1,
+    0x417183bc, 0x64ca7667, 0x88e56f72, 0xad5e9aa9, 0xc39284c4, 0xe629711f,
+    0x1e0ab81e, 0x3bb14dc5, 0x557d53a8, 0x70c6a673, 0xa0d6b75b, 0x856d4280,
+    0xeba15ced, 0xce1aa936, 0x36396037, 0x138295ec, 0x7d4e8b81, 0x58f57e5a,
+    0xd882df20, 0xfd392afb, 0x93f53496, 0xb64ec14d, 0x4e6d084c, 0x6bd6fd97,
+    0x051ae3fa, 0x20a11621, 0xf0b10709, 0xd50af2d2, 0xbbc6ecbf, 0x9e7d1964,
+    0x665ed065, 0x43e525be, 0x2d293bd3, 0x0892ce08, 0x282a0fd6, 0x0d91fa0d,
+    0x635de460, 0x46e611bb, 0xbec5d8ba, 0x9b7e2d61, 0xf5b2330c, 0xd009c6d7,
+    0x0019d7ff, 0x25a22224, 0x4b6e3c49, 0x6ed5c992, 0x96f60093, 0xb34df548,
+    0xdd81eb25, 0xf83a1efe, 0x784dbf84, 0x5df64a5f, 0x333a5432, 0x1681a1e9,
+    0xeea268e8, 0xcb199d33, 0xa5d5835e, 0x806e7685, 0x507e67ad, 0x75c59276,
+    0x1b098c1b, 0x3eb279c0, 0xc691b0c1, 0xe32a451a, 0x8de65b77, 0xa85daeac,
+    0xcc97d8cb, 0xe92c2d10, 0x87e0337d, 0xa25bc6a6, 0x5a780fa7, 0x7fc3fa7c,
+    0x110fe411, 0x34b411ca, 0xe4a400e2, 0xc11ff539, 0xafd3eb54, 0x8a681e8f,
+    0x724bd78e, 0x57f02255, 0x393c3c38, 0x1c87c9e3, 0x9cf06899, 0xb94b9d42,
+    0xd787832f, 0xf23c76f4, 0x0a1fbff5, 0x2fa44a2e, 0x41685443, 0x64d3a198,
+    0xb4c3b0b0, 0x9178456b, 0xffb45b06, 0xda0faedd, 0x222c67dc, 0x07979207,
+    0x695b8c6a, 0x4ce079b1, 0x6c58b86f, 0x49e34db4, 0x272f53d9, 0x0294a602,
+    0xfab76f03, 0xdf0c9ad8, 0xb1c084b5, 0x947b716e, 0x446b6046, 0x61d0959d,
+    0x0f1c8bf0, 0x2aa77e2b, 0xd284b72a, 0xf73f42f1, 0x99f35c9c, 0xbc48a947,
+    0x3c3f083d, 0x1984fde6, 0x7748e38b, 0x52f31650, 0xaad0df51, 0x8f6b2a8a,
+    0xe1a734e7, 0xc41cc13c, 0x140cd014, 0x31b725cf, 0x5f7b3ba2, 0x7ac0ce79,
+    0x82e30778, 0xa758f2a3, 0xc994ecce, 0xec2f1915
+  }
+};
+
+
+/* Raw CRC register `crc` followed by the zero bytes that table `t` was built for */
+static inline uint32_t _vp_crc32c_shift(const uint32_t t[4][256], uint32_t crc) {
+  return t[0][crc & 0xff] ^ t[1][(crc >> 8) & 0xff] ^ t[2][(crc >> 16) & 0xff] ^ t[3][crc >> 24];
+}
+
+/* Three adjacent `lane`-byte streams from raw register `x`, joined with the shift table `t` */
+_VP_TARGET("sse4.2") static inline uint64_t _vp_crc32c_hw3(uint64_t x, const uint8_t* p, size_t lane,
+                                                           const uint32_t t[4][256]) {
+  uint64_t y = 0, z = 0;
+  for (size_t i = 0; i < lane; i += 8) {
+    uint64_t u, v, w;
+    memcpy(&u, p + i, 8);
+    memcpy(&v, p + lane + i, 8);
+    memcpy(&w, p + 2 * lane + i, 8);
+    x = _mm_crc32_u64(x, u);
+    y = _mm_crc32_u64(y, v);
+    z = _mm_crc32_u64(z, w);
+  }
+  x = _vp_crc32c_shift(t, (uint32_t)x) ^ y;
+  return _vp_crc32c_shift(t, (uint32_t)x) ^ z;
+}
+
+/*
+  @brief
+  CRC32C with the SSE4.2 `crc32` instruction. The buffer is cut into
+  runs of three 8 KB streams, then three 256 B streams, that run in
+  parallel to hide the instruction's 3-cycle latency. Streams are
+  joined with precomputed shift tables, four lookups per join, so the
+  split pays off from 768 bytes. Without -msse4.2 it is only safe to
+  call when `vp_cpu()->level >= VP_CPU_SSE42`.
+*/
+_VP_TARGET("sse4.2") static inline uint32_t vp_crc32c_hw(uint32_t crc, const void* buf, size_t len) {
+  const uint8_t* p = (const uint8_t*)buf;
+  uint64_t x = (uint32_t)~crc;
+  for (; len >= 3 * VP_CRC32C_LONG; p += 3 * VP_CRC32C_LONG, len -= 3 * VP_CRC32C_LONG)
+    x = _vp_crc32c_hw3(x, p, VP_CRC32C_LONG, _vp_crc32c_long);
+  for (; len >= 3 * VP_CRC32C_SHORT; p += 3 * VP_CRC32C_SHORT, len -= 3 * VP_CRC32C_SHORT)
+    x = _vp_crc32c_hw3(x, p, VP_CRC32C_SHORT, _vp_crc32c_short);
+  for (; len >= 8; p += 8, len -= 8) {
+    uint64_t u;
+    memcpy(&u, p, 8);
+    x = _mm_crc32_u64(x, u);
+  }
+  uint32_t c32 = (uint32_t)x;
+  while (len--) c32 = _mm_crc32_u8(c32, *p++);
+  return ~c32;
+}
+#endif
+
+/*
+  @brief
+  CRC32C (Castagnoli) of a buffer. Pass 0 to start, or a previous
+  result to continue over adjacent data.
+*/
+static inline uint32_t _vp_crc32c_auto(uint32_t crc, const void* buf, size_t len);
+
+static inline uint32_t vp_crc32c(uint32_t crc, const void* buf, size_t len) {
+#if defined(__SSE4_2__) && defined(__x86_64__)
+  return vp_crc32c_hw(crc, buf, len);
+#elif defined(VP_DISPATCH_X86)
+  return _vp_crc32c_auto(crc, buf, len);
+#else
+  return vp_crc32c_sw(crc, buf, len);
+#endif
+}
+
+/*
+  @brief
+  Checksum of a packed block: its site words followed by its rows
+*/
+static inline uint32_t vp_mat_crc(const vp_mat_t* m) {
+  uint32_t crc = vp_crc32c(0, m->sites, m->nsites * sizeof(vpack64_t));
+  return vp_crc32c(crc, m->gts, m->nsites * vp_row_words(m->nsamples) * sizeof(vpack64_t));
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             CPU DISPATCH
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*
+  Kernels with SIMD variants are reached through a table of function
+  pointers, bound once to the best level the CPU supports, so one
+  binary runs well on a mixed fleet without -march builds.
+
+    const vp_kernels_t* k = vp_cpu();
+    k->count(row, nsamples, alt);
+
+  Levels, each including the ones below it:
+
+    VP_CPU_SCALAR   portable C
+    VP_CPU_SSE42    SSE4.2 crc32, POPCNT
+    VP_CPU_AVX2     AVX2, BMI2 pext/pdep
+    VP_CPU_AVX512   AVX-512F, VPOPCNTQ
+
+  The environment variable VPACK_CPU_LEVEL (scalar, sse4.2, avx2,
+  avx512 or 0-3) caps the level, e.g. to test fallbacks or to avoid
+  pext/pdep on CPUs where they are microcoded. It never raises the
+  level above what the CPU supports. Dispatch covers x86-64 with GCC
+  or Clang; elsewhere, or with -DVPACK_NO_DISPATCH, every pointer is
+  the scalar kernel.
+
+  Kernels:
+
+    pack    2-bit allele codes, two per sample, to a packed row
+    unpack  packed row to 2-bit allele codes
+    count   alleles equal to a base code in a row (`vp_row_count`)
+    ac      alt allele count of each of n consecutive sites and rows,
+            eight single-word rows per instruction on AVX-512
+    filter  copy `snvpack64` words carrying an alt allele, returns count
+    dup     first `snvpack64` word with the locus and sample of the word
+            before it, or n
+    crc32c  CRC32C (`vp_crc32c`)
+*/
+enum {
+  VP_CPU_SCALAR,
+  VP_CPU_SSE42,
+  VP_CPU_AVX2,
+  VP_CPU_AVX512,
+  VP_CPU_NLEVELS
+};
+
+static const char* vp_cpu_names[VP_CPU_NLEVELS] = {"scalar", "sse4.2", "avx2", "avx512"};
+
+typedef void (*vp_pack_fn)(const uint8_t* codes, uint32_t nsamples, vpack64_t* row);
+typedef void (*vp_unpack_fn)(const vpack64_t* row, uint32_t nsamples, uint8_t* codes);
+typedef uint32_t (*vp_count_fn)(const vpack64_t* row, uint32_t nsamples, uint32_t code);
+typedef void (*vp_ac_fn)(const vpack64_t* sites, const vpack64_t* rows, size_t n, uint32_t nsamples, uint32_t* ac);
+typedef size_t (*vp_filter_fn)(const vpack64_t* v, size_t n, vpack64_t* out);
+typedef size_t (*vp_dup_fn)(const vpack64_t* v, size_t n);
+typedef uint32_t (*vp_crc_fn)(uint32_t crc, const void* buf, size_t len);
+
+typedef struct
+{
+  int level;         // VP_CPU_*
+  int detected;      // best level the CPU supports
+  vp_pack_fn pack;
+  vp_unpack_fn unpack;
+  vp_count_fn count;
+  vp_ac_fn ac;
+  vp_filter_fn filter;
+  vp_dup_fn dup;
+  vp_crc_fn crc32c;
+} vp_kernels_t;
+
+/*
+  @brief
+  Pack allele codes into a row. `codes` holds 2*nsamples base codes
+  (0-3), both alleles of sample 0 first; `row` receives
+  vp_row_words(nsamples) words.
+*/
+static inline void vp_row_pack_scalar(const uint8_t* codes, uint32_t nsamples, vpack64_t* row) {
+  uint32_t nw = vp_row_words(nsamples);
+  for (uint32_t w = 0; w < nw; w++) {
+    uint32_t k = nsamples - w * VP_GT_PER_WORD;
+    if (k > VP_GT_PER_WORD) k = VP_GT_PER_WORD;
+    const uint8_t* c = codes + 2 * w * VP_GT_PER_WORD;
+    vpack64_t v = 0;
+    for (uint32_t j = 0; j < 2 * k; j++) v = (v << 2) | (c[j] & 3);
+    row[w] = v;
+  }
+}
+
+static inline void vp_row_unpack_scalar(const vpack64_t* row, uint32_t nsamples, uint8_t* codes) {
+  uint32_t nw = vp_row_words(nsamples);
+  for (uint32_t w = 0; w < nw; w++) {
+    uint32_t k = nsamples - w * VP_GT_PER_WORD;
+    if (k > VP_GT_PER_WORD) k = VP_GT_PER_WORD;
+    uint8_t* c = codes + 2 * w * VP_GT_PER_WORD;
+    vpack64_t v = row[w];
+    for (uint32_t j = 2 * k; j-- > 0; v >>= 2) c[j] = (uint8_t)(v & 3);
+  }
+}
+
+static inline size_t vp_filter_nonref_scalar(const vpack64_t* v, size_t n, vpack64_t* out) {
+  size_t k = 0;
+  for (size_t i = 0; i < n; i++) {
+    vpack64_t x = v[i];
+    out[k] = x;
+    k += (size_t)vp_snv_is_nonref(x);
+  }
+  return k;
+}
+
+/* Words differ only in the GT field: same locus and sample */
+#define _VP_KEY_BITS (~0x1ffULL)
+
+static inline size_t vp_find_dup_scalar(const vpack64_t* v, size_t n) {
+  for (size_t i = 1; i < n; i++)
+    if (!((v[i] ^ v[i - 1]) & _VP_KEY_BITS)) return i;
+  return n;
+}
+
+/*
+  @brief
+  Alt allele count of `n` consecutive sites: `ac[i]` counts the
+  alleles of row i equal to `sites[i] & 3`. Rows are
+  vp_row_words(nsamples) words each, back to back.
+*/
+static inline void vp_rows_ac_scalar(const vpack64_t* sites, const vpack64_t* rows, size_t n, uint32_t nsamples, uint32_t* ac) {
+  uint32_t rw = vp_row_words(nsamples);
+  for (size_t i = 0; i < n; i++) ac[i] = vp_row_count(rows + i * rw, nsamples, (uint32_t)(sites[i] & 3));
+}
+
+#if defined(VP_DISPATCH_X86)
+_VP_TARGET("popcnt") static inline uint32_t _vp_row_count_popcnt(const vpack64_t* row, uint32_t nsamples, uint32_t code) {
+  return vp_row_count(row, nsamples, code);
+}
+
+_VP_TARGET("popcnt") static inline void _vp_rows_ac_popcnt(const vpack64_t* sites, const vpack64_t* rows, size_t n, uint32_t nsamples, uint32_t* ac) {
+  vp_rows_ac_scalar(sites, rows, n, nsamples, ac);
+}
+
+/*
+  BMI2: eight codes sit one per byte; byte-swapped so the first code
+  is the most significant, `pext` gathers their low two bits in row
+  order. `pdep` reverses it.
+*/
+#define _VP_CODE_BYTES 0x0303030303030303ULL
+
+_VP_TARGET("bmi2") static inline void _vp_row_pack_bmi2(const uint8_t* codes, uint32_t nsamples, vpack64_t* row) {
+  uint32_t full = nsamples / VP_GT_PER_WORD;
+  for (uint32_t w = 0; w < full; w++) {
+    const uint8_t* c = codes + 2 * w * VP_GT_PER_WORD;
+    vpack64_t v = 0;
+    for (int q = 0; q < 4; q++) {
+      uint64_t x;
+      memcpy(&x, c + 8 * q, 8);
+      v = (v << 16) | _pext_u64(__builtin_bswap64(x), _VP_CODE_BYTES);
+    }
+    row[w] = v;
+  }
+  if (nsamples % VP_GT_PER_WORD)
+    vp_row_pack_scalar(codes + 2 * full * VP_GT_PER_WORD, nsamples % VP_GT_PER_WORD, row + full);
+}
+
+_VP_TARGET("bmi2") static inline void _vp_row_unpack_bmi2(const vpack64_t* row, uint32_t nsamples, uint8_t* codes) {
+  uint32_t full = nsamples / VP_GT_PER_WORD;
+  for (uint32_t w = 0; w < full; w++) {
+    uint8_t* c = codes + 2 * w * VP_GT_PER_WORD;
+    for (int q = 0; q < 4; q++) {
+      uint64_t x = __builtin_bswap64(_pdep_u64((row[w] >> (48 - 16 * q)) & 0xffff, _VP_CODE_BYTES));
+      memcpy(c + 8 * q, &x, 8);
+    }
+  }
+  if (nsamples % VP_GT_PER_WORD)
+    vp_row_unpack_scalar(row + full, nsamples % VP_GT_PER_WORD, codes + 2 * full * VP_GT_PER_WORD);
+}
+
+/* Dword permutations that move the selected 64-bit lanes to the front */
+static const uint32_t _vp_compact4[16][8] = {
+  {0,0,0,0,0,0,0,0}, {0,1,0,0,0,0,0,0}, {2,3,0,0,0,0,0,0}, {0,1,2,3,0,0,0,0},
+  {4,5,0,0,0,0,0,0}, {0,1,4,5,0,0,0,0}, {2,3,4,5,0,0,0,0}, {0,1,2,3,4,5,0,0},
+  {6,7,0,0,0,0,0,0}, {0,1,6,7,0,0,0,0}, {2,3,6,7,0,0,0,0}, {0,1,2,3,6,7,0,0},
+  {4,5,6,7,0,0,0,0}, {0,1,4,5,6,7,0,0}, {2,3,4,5,6,7,0,0}, {0,1,2,3,4,5,6,7},
+};
+
+/* Stores stay inside out[0, i + 4), so `out` may alias `v` */
+_VP_TARGET("avx2,popcnt") static inline size_t _vp_filter_nonref_avx2(const vpack64_t* v, size_t n, vpack64_t* out) {
+  const __m256i seven = _mm256_set1_epi64x(7), one = _mm256_set1_epi64x(1);
+  size_t i = 0, k = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(v + i));
+    __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi64(_mm256_and_si256(_mm256_srli_epi64(x, 6), seven), one),
+                                  _mm256_cmpeq_epi64(_mm256_and_si256(x, seven), one));
+    int m = _mm256_movemask_pd(_mm256_castsi256_pd(hit));
+    __m256i perm = _mm256_loadu_si256((const __m256i*)_vp_compact4[m]);
+    _mm256_storeu_si256((__m256i*)(out + k), _mm256_permutevar8x32_epi32(x, perm));
+    k += (size_t)__builtin_popcount((unsigned)m);
+  }
+  return k + vp_filter_nonref_scalar(v + i, n - i, out + k);
+}
+
+/* Compare each word with its predecessor, four at a time */
+_VP_TARGET("avx2") static inline size_t _vp_find_dup_avx2(const vpack64_t* v, size_t n) {
+  const __m256i key = _mm256_set1_epi64x((long long)_VP_KEY_BITS), zero = _mm256_setzero_si256();
+  size_t i = 1;
+  for (; i + 4 <= n; i += 4) {
+    __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(v + i)),
+                                 _mm256_loadu_si256((const __m256i*)(v + i - 1)));
+    int m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(x, key), zero)));
+    if (m) return i + (size_t)__builtin_ctz((unsigned)m);
+  }
+  return i >= n ? n : i - 1 + vp_find_dup_scalar(v + i - 1, n - i + 1);
+}
+
+_VP_TARGET("avx512f,avx512vpopcntdq") static inline uint32_t _vp_row_count_avx512(const vpack64_t* row, uint32_t nsamples, uint32_t code) {
+  const __m512i lo = _mm512_set1_epi64(0x5555555555555555LL);
+  __m512i pat = _mm512_set1_epi64((long long)((uint64_t)(code & 3) * 0x5555555555555555ULL));
+  __m512i acc = _mm512_setzero_si512();
+  uint32_t full = nsamples / VP_GT_PER_WORD, j = 0;
+  for (; j + 8 <= full; j += 8) {
+    __m512i x = _mm512_xor_si512(_mm512_loadu_si512((const void*)(row + j)), pat);
+    __m512i eq = _mm512_andnot_si512(_mm512_or_si512(x, _mm512_srli_epi64(x, 1)), lo);
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(eq));
+  }
+  uint32_t n = (uint32_t)_mm512_reduce_add_epi64(acc);
+  return n + vp_row_count(row + j, nsamples - j * VP_GT_PER_WORD, code);
+}
+
+/*
+  Up to 16 samples fit one row word, so eight sites are counted per
+  vector: lane i holds row i, and its match pattern is built from
+  the alt code of site i by spreading each code bit over its half of
+  the allele bit pairs.
+*/
+_VP_TARGET("avx512f,avx512vpopcntdq") static inline void _vp_rows_ac_avx512(const vpack64_t* sites, const vpack64_t* rows, size_t n, uint32_t nsamples, uint32_t* ac) {
+  uint32_t rw = vp_row_words(nsamples);
+  size_t i = 0;
+  if (rw == 1) {
+    const __m512i lo = _mm512_set1_epi64(0x5555555555555555LL), one = _mm512_set1_epi64(1);
+    const __m512i zero = _mm512_setzero_si512(), hi = _mm512_slli_epi64(lo, 1);
+    const __m512i used = _mm512_set1_epi64((long long)(nsamples < VP_GT_PER_WORD ? (1ULL << (nsamples * 4)) - 1 : ~0ULL));
+    for (; i + 8 <= n; i += 8) {
+      __m512i s = _mm512_loadu_si512((const void*)(sites + i));
+      __m512i b0 = _mm512_sub_epi64(zero, _mm512_and_si512(s, one));
+      __m512i b1 = _mm512_sub_epi64(zero, _mm512_and_si512(_mm512_srli_epi64(s, 1), one));
+      __m512i pat = _mm512_or_si512(_mm512_and_si512(b0, lo), _mm512_and_si512(b1, hi));
+      __m512i x = _mm512_xor_si512(_mm512_loadu_si512((const void*)(rows + i)), pat);
+      __m512i eq = _mm512_and_si512(_mm512_andnot_si512(_mm512_or_si512(x, _mm512_srli_epi64(x, 1)), lo), used);
+      _mm256_storeu_si256((__m256i*)(ac + i), _mm512_cvtepi64_epi32(_mm512_popcnt_epi64(eq)));
+    }
+  }
+  for (; i < n; i++) ac[i] = _vp_row_count_avx512(rows + i * rw, nsamples, (uint32_t)(sites[i] & 3));
+}
+
+_VP_TARGET("avx512f") static inline size_t _vp_filter_nonref_avx512(const vpack64_t* v, size_t n, vpack64_t* out) {
+  const __m512i seven = _mm512_set1_epi64(7), one = _mm512_set1_epi64(1);
+  size_t i = 0, k = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512i x = _mm512_loadu_si512((const void*)(v + i));
+    __mmask8 m = _mm512_cmpeq_epi64_mask(_mm512_and_si512(_mm512_srli_epi64(x, 6), seven), one) |
+                 _mm512_cmpeq_epi64_mask(_mm512_and_si512(x, seven), one);
+    _mm512_mask_compressstoreu_epi64(out + k, m, x);
+    k += (size_t)__builtin_popcount((unsigned)m);
+  }
+  return k + vp_filter_nonref_scalar(v + i, n - i, out + k);
+}
+
+_VP_TARGET("avx512f") static inline size_t _vp_find_dup_avx512(const vpack64_t* v, size_t n) {
+  const __m512i key = _mm512_set1_epi64((long long)_VP_KEY_BITS);
+  size_t i = 1;
+  for (; i + 8 <= n; i += 8) {
+    __m512i x = _mm512_xor_si512(_mm512_loadu_si512((const void*)(v + i)), _mm512_loadu_si512((const void*)(v + i - 1)));
+    __mmask8 m = _mm512_testn_epi64_mask(x, key);
+    if (m) return i + (size_t)__builtin_ctz((unsigned)m);
+  }
+  return i >= n ? n : i - 1 + vp_find_dup_scalar(v + i - 1, n - i + 1);
+}
+
+static inline int _vp_cpu_detect(void) {
+  __builtin_cpu_init();
+  if (!__builtin_cpu_supports("sse4.2") || !__builtin_cpu_supports("popcnt")) return VP_CPU_SCALAR;
+  if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("bmi2")) return VP_CPU_SSE42;
+  if (!__builtin_cpu_supports("avx512f") || !__builtin_cpu_supports("avx512vpopcntdq")) return VP_CPU_AVX2;
+  return VP_CPU_AVX512;
+}
+#else
+static inline int _vp_cpu_detect(void) {
+  return VP_CPU_SCALAR;
+}
+#endif
+
+VP_SHARED vp_kernels_t vp_kernels;
+VP_SHARED int vp_kernels_ready;  // 0: unbound, 2: a first use is binding, 1: ready
+
+/*
+  @brief
+  Bind the kernel table to `level`, capped at the detected level.
+  Not thread safe; call before starting threads that use kernels.
+
+  @returns the level bound
+*/
+static inline int vp_cpu_set_level(int level) {
+  vp_kernels_t k = {VP_CPU_SCALAR, _vp_cpu_detect(), vp_row_pack_scalar, vp_row_unpack_scalar,
+                    vp_row_count, vp_rows_ac_scalar, vp_filter_nonref_scalar, vp_find_dup_scalar,
+                    vp_crc32c_sw};
+  if (level > k.detected) level = k.detected;
+  if (level < VP_CPU_SCALAR) level = VP_CPU_SCALAR;
+  k.level = level;
+#if defined(VP_DISPATCH_X86)
+  if (level >= VP_CPU_SSE42) {
+    k.count = _vp_row_count_popcnt;
+    k.ac = _vp_rows_ac_popcnt;
+    k.crc32c = vp_crc32c_hw;
+  }
+  if (level >= VP_CPU_AVX2) {
+    k.pack = _vp_row_pack_bmi2;
+    k.unpack = _vp_row_unpack_bmi2;
+    k.filter = _vp_filter_nonref_avx2;
+    k.dup = _vp_find_dup_avx2;
+  }
+  if (level >= VP_CPU_AVX512) {
+    k.count = _vp_row_count_avx512;
+    k.ac = _vp_rows_ac_avx512;
+    k.filter = _vp_filter_nonref_avx512;
+    k.dup = _vp_find_dup_avx512;
+  }
+#endif
+  vp_kernels = k;
+#if defined(__GNUC__)
+  __atomic_store_n(&vp_kernels_ready, 1, __ATOMIC_RELEASE);
+#else
+  vp_kernels_ready = 1;
+#endif
+  return level;
+}
+
+/*
+  @brief
+  Level requested by VPACK_CPU_LEVEL, or VP_CPU_NLEVELS if unset or
+  not recognised
+*/
+static inline int vp_cpu_env_level(void) {
+  const char* e = getenv("VPACK_CPU_LEVEL");
+  if (!e || !*e) return VP_CPU_NLEVELS;
+  for (int i = 0; i < VP_CPU_NLEVELS; i++)
+    if (!strcmp(e, vp_cpu_names[i]) || (e[0] == '0' + i && !e[1])) return i;
+  if (!strcmp(e, "sse42")) return VP_CPU_SSE42;
+  return VP_CPU_NLEVELS;
+}
+
+/*
+  @brief
+  Kernel table, bound on first use to the best supported level
+  unless VPACK_CPU_LEVEL caps it. Concurrent first calls are safe:
+  the one that wins a CAS from 0 to 2 writes the table, and the others
+  wait until it is published as 1.
+*/
+static inline const vp_kernels_t* vp_cpu(void) {
+#if defined(__GNUC__)
+  if (__atomic_load_n(&vp_kernels_ready, __ATOMIC_ACQUIRE) != 1) {
+    int unbound = 0;
+    if (__atomic_compare_exchange_n(&vp_kernels_ready, &unbound, 2, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+      vp_cpu_set_level(vp_cpu_env_level());
+    else
+      while (__atomic_load_n(&vp_kernels_ready, __ATOMIC_ACQUIRE) != 1);
+  }
+#else
+  if (!vp_kernels_ready) vp_cpu_set_level(vp_cpu_env_level());
+#endif
+  return &vp_kernels;
+}
+
+static inline uint32_t _vp_crc32c_auto(uint32_t crc, const void* buf, size_t len) {
+  return vp_cpu()->crc32c(crc, buf, len);
+}
+
+static inline void _vp_rows_ac_auto(const vpack64_t* sites, const vpack64_t* rows, size_t n, uint32_t nsamples, uint32_t* ac) {
+  vp_cpu()->ac(sites, rows, n, nsamples, ac);
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             TRACING
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*
+  Per-stage timing spans, compiled in only with -DVPACK_TRACE (needs
+  C11 atomics and thread-locals). When disabled, the hooks expand to
+  nothing.
+
+    VP_TRACE_BEGIN(pack);
+    ...
+    VP_TRACE_END(pack);
+
+  Spans go into a per-thread ring buffer of VP_TRACE_CAP entries; the
+  oldest spans are overwritten. Only the owning thread writes to a
+  buffer, and buffers are linked into a global list with a CAS, so
+  recording never takes a lock. `vp_trace_dump` writes all buffers as
+  Chrome trace JSON (chrome://tracing, Perfetto). Dump while threads
+  are idle; a span being overwritten during the dump may be torn.
+  Buffers are charged to VP_MEM_SCRATCH, VP_TRACE_CAP * 24 bytes each.
+  With -DVPACK_THREADS a thread's buffer goes to a free list when the
+  thread exits, and the next thread to trace reuses it, its spans and
+  tid included. Memory then grows with the most threads tracing at
+  once, not with every thread the library starts. Without it, buffers
+  live until exit. A thread whose buffer the memory budget refuses
+  records no spans.
+
+  The library traces `encode` and `io` in the writer, and `io` and
+  `verify` in the reader. Callers add their own stages (e.g. parse,
+  pack) with the same macros.
+*/
+#if defined(VPACK_TRACE) || defined(VPACK_METRICS)
+#include <time.h>
+
+/* monotonic where POSIX clocks are declared, else wall time (C11), else CPU time */
+static inline uint64_t vp_clock_ns(void) {
+#if defined(VP_HAVE_CLOCK)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#elif defined(TIME_UTC)
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#else
+  return (uint64_t)((double)clock() * (1e9 / CLOCKS_PER_SEC));
+#endif
+}
+#endif
+
+#ifdef VPACK_TRACE
+#ifndef VP_TRACE_CAP
+#define VP_TRACE_CAP 65536
+#endif
+
+typedef struct
+{
+  const char* name;
+  uint64_t t0;
+  uint64_t t1;
+} vp_span_t;
+
+typedef struct vp_trace_buf
+{
+  struct vp_trace_buf* next;      // every buffer, for dumps
+  struct vp_trace_buf* free_next; // free list, buffers of exited threads
+  uint32_t tid;
+  uint64_t head;                  // spans ever recorded
+  vp_span_t spans[VP_TRACE_CAP];
+} vp_trace_buf_t;
+
+VP_SHARED vp_trace_buf_t* vp_trace_list;
+VP_SHARED uint32_t vp_trace_ntid;
+VP_SHARED _VP_TLS vp_trace_buf_t* vp_trace_tls;
+
+#if defined(VPACK_THREADS)
+VP_SHARED pthread_mutex_t vp_trace_mu = PTHREAD_MUTEX_INITIALIZER;
+VP_SHARED pthread_once_t vp_trace_once = PTHREAD_ONCE_INIT;
+VP_SHARED pthread_key_t vp_trace_key;
+VP_SHARED vp_trace_buf_t* vp_trace_free;
+
+/* Thread exit: the buffer goes to the free list for the next thread */
+static inline void _vp_trace_release(void* p) {
+  vp_trace_buf_t* b = (vp_trace_buf_t*)p;
+  pthread_mutex_lock(&vp_trace_mu);
+  b->free_next = vp_trace_free;
+  vp_trace_free = b;
+  pthread_mutex_unlock(&vp_trace_mu);
+  vp_trace_tls = NULL;
+}
+
+static inline void _vp_trace_key_init(void) {
+  pthread_key_create(&vp_trace_key, _vp_trace_release);
+}
+#endif
+
+static inline uint64_t vp_trace_now(void) {
+  return vp_clock_ns();
+}
+
+static inline vp_trace_buf_t* _vp_trace_buf(void) {
+  vp_trace_buf_t* b = vp_trace_tls;
+  if (b) return b;
+#if defined(VPACK_THREADS)
+  pthread_once(&vp_trace_once, _vp_trace_key_init);
+  pthread_mutex_lock(&vp_trace_mu);
+  b = vp_trace_free;
+  if (b) vp_trace_free = b->free_next;
+  pthread_mutex_unlock(&vp_trace_mu);
+#endif
+  if (!b) {
+    b = (vp_trace_buf_t*)vp_calloc(VP_MEM_SCRATCH, 1, sizeof(vp_trace_buf_t));
+    if (!b) return NULL;
+    b->tid = _VP_ADD(vp_trace_ntid, 1);
+    vp_trace_buf_t* old = _VP_SC_LOAD(vp_trace_list);
+    do b->next = old;
+    while (!_VP_CAS(vp_trace_list, old, b));
+  }
+#if defined(VPACK_THREADS)
+  pthread_setspecific(vp_trace_key, b);
+#endif
+  vp_trace_tls = b;
+  return b;
+}
+
+static inline void vp_trace_span(const char* name, uint64_t t0, uint64_t t1) {
+  vp_trace_buf_t* b = _vp_trace_buf();
+  if (!b) return;
+  uint64_t h = _VP_LOAD(b->head);
+  b->spans[h % VP_TRACE_CAP] = (vp_span_t){name, t0, t1};
+  _VP_SC_STORE(b->head, h + 1);
+}
+
+/*
+  @brief
+  Write all recorded spans as Chrome trace JSON
+
+  @returns status  0: success, -1: write error
+*/
+static inline int vp_trace_dump(FILE* fp) {
+  int first = 1;
+  fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+  for (vp_trace_buf_t* b = _VP_SC_LOAD(vp_trace_list); b; b = b->next) {
+    uint64_t h = _VP_SC_LOAD(b->head);
+    uint64_t i = h > VP_TRACE_CAP ? h - VP_TRACE_CAP : 0;
+    for (; i < h; i++) {
+      const vp_span_t* s = &b->spans[i % VP_TRACE_CAP];
+      fprintf(fp, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+              first ? "" : ",\n", s->name, b->tid, (double)s->t0 / 1000.0, (double)(s->t1 - s->t0) / 1000.0);
+      first = 0;
+    }
+  }
+  fprintf(fp, "\n]}\n");
+  return ferror(fp) ? -1 : 0;
+}
+
+#define VP_TRACE_BEGIN(stage)  uint64_t _vp_trace_##stage = vp_trace_now()
+#define VP_TRACE_END(stage)    vp_trace_span(#stage, _vp_trace_##stage, vp_trace_now())
+#else
+#define VP_TRACE_BEGIN(stage)  ((void)0)
+#define VP_TRACE_END(stage)    ((void)0)
+#endif
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             METRICS
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*
+  Runtime counters and latency histograms, compiled in with
+  -DVPACK_METRICS. When disabled the hooks expand to nothing.
+
+  Every metric is sharded over VP_METRIC_SHARDS cache-line aligned
+  shards. A thread is assigned a shard on first use and updates it with
+  relaxed atomics, so concurrent writers rarely share a cache line.
+  Exports sum the shards.
+
+  Histograms are HDR-style log-linear: 32 linear sub-buckets per power
+  of two (~3% relative error) from 1 ns to 2^40 ns.
+
+  `vp_metrics_export` renders Prometheus text exposition format to a
+  callback, `vp_metrics_write` to a file. Rates (records/s, cache hit
+  rate) are derived from the counters by the scraper.
+*/
+enum {
+  VP_M_RECORDS_PACKED,    // sites added to writers
+  VP_M_BLOCKS_WRITTEN,
+  VP_M_BYTES_WRITTEN,
+  VP_M_BLOCKS_READ,       // blocks loaded from disk
+  VP_M_BYTES_READ,
+  VP_M_CACHE_HITS,
+  VP_M_CACHE_MISSES,
+  VP_M_CHECKSUM_ERRORS,
+  VP_M_NCOUNTERS
+};
+
+enum {
+  VP_H_QUERY_LATENCY,     // region and point queries
+  VP_H_READ_LATENCY,      // block fetch, cache hits included
+  VP_H_FLUSH_LATENCY,     // ingestion block flush
+  VP_H_NHISTOGRAMS
+};
+
+/*
+  HDR histogram buckets. These helpers are plain functions over a
+  VP_HIST_BUCKETS array and are available without VPACK_METRICS,
+  e.g. for benchmark harnesses that keep their own histograms.
+*/
+#define VP_HIST_SUB     5
+#define VP_HIST_MAXEXP  40
+#define VP_HIST_BUCKETS ((VP_HIST_MAXEXP - VP_HIST_SUB + 1) << VP_HIST_SUB)
+
+static inline uint32_t vp_hist_bucket(uint64_t v) {
+  if (v < (1u << VP_HIST_SUB)) return (uint32_t)v;
+  int e = 63 - vp_clz64(v);
+  if (e >= VP_HIST_MAXEXP) return VP_HIST_BUCKETS - 1;
+  return (uint32_t)(((e - VP_HIST_SUB + 1) << VP_HIST_SUB) + ((v >> (e - VP_HIST_SUB)) & ((1u << VP_HIST_SUB) - 1)));
+}
+
+/* Upper bound of a bucket, in the recorded unit */
+static inline uint64_t vp_hist_bucket_max(uint32_t i) {
+  if (i < (1u << VP_HIST_SUB)) return i;
+  uint32_t e = (i >> VP_HIST_SUB) + VP_HIST_SUB - 1, m = i & ((1u << VP_HIST_SUB) - 1);
+  uint64_t lo = ((uint64_t)(1u << VP_HIST_SUB) + m) << (e - VP_HIST_SUB);
+  return lo + (1ULL << (e - VP_HIST_SUB)) - 1;
+}
+
+/*
+  @brief
+  Value at quantile `q` (0...1) of a merged histogram, as the upper
+  bound of the bucket holding it
+*/
+static inline uint64_t vp_hist_quantile(const uint64_t* b, uint64_t count, double q) {
+  if (!count) return 0;
+  uint64_t rank = (uint64_t)ceil(q * (double)count), seen = 0;
+  if (!rank) rank = 1;
+  for (uint32_t i = 0; i < VP_HIST_BUCKETS; i++) {
+    seen += b[i];
+    if (seen >= rank) return vp_hist_bucket_max(i);
+  }
+  return vp_hist_bucket_max(VP_HIST_BUCKETS - 1);
+}
+
+#ifdef VPACK_METRICS
+#ifndef VP_METRIC_SHARDS
+#define VP_METRIC_SHARDS 16
+#endif
+
+typedef struct
+{
+  uint64_t count;
+  uint64_t sum;
+  uint64_t b[VP_HIST_BUCKETS];
+} vp_hist_shard_t;
+
+typedef struct
+{
+  uint64_t c[VP_M_NCOUNTERS] _VP_CACHELINE;
+  vp_hist_shard_t h[VP_H_NHISTOGRAMS] _VP_CACHELINE;
+} vp_metric_shard_t;
+
+VP_SHARED vp_metric_shard_t vp_metric_shards[VP_METRIC_SHARDS];
+VP_SHARED uint32_t vp_metric_nthreads;
+VP_SHARED _VP_TLS uint32_t vp_metric_tls;   // shard + 1, 0: unassigned
+
+static const char* vp_counter_names[VP_M_NCOUNTERS] = {
+  "vpack_records_packed_total", "vpack_blocks_written_total", "vpack_bytes_written_total",
+  "vpack_blocks_read_total", "vpack_bytes_read_total", "vpack_cache_hits_total",
+  "vpack_cache_misses_total", "vpack_checksum_errors_total"
+};
+static const char* vp_counter_help[VP_M_NCOUNTERS] = {
+  "Sites added to container writers", "Blocks written", "Bytes written",
+  "Blocks loaded from disk", "Bytes read from disk", "Block cache hits",
+  "Block cache misses", "Blocks failing CRC32C verification"
+};
+static const char* vp_hist_names[VP_H_NHISTOGRAMS] = {
+  "vpack_query_latency_seconds", "vpack_read_latency_seconds", "vpack_flush_latency_seconds"
+};
+static const char* vp_hist_help[VP_H_NHISTOGRAMS] = {
+  "Region and point query latency", "Block fetch latency", "Writer block flush latency"
+};
+
+static inline vp_metric_shard_t* _vp_metric_shard(void) {
+  if (!vp_metric_tls) vp_metric_tls = (_VP_ADD(vp_metric_nthreads, 1) - 1) % VP_METRIC_SHARDS + 1;
+  return &vp_metric_shards[vp_metric_tls - 1];
+}
+
+static inline void vp_metric_add(int id, uint64_t n) {
+  _VP_ADD(_vp_metric_shard()->c[id], n);
+}
+
+static inline void vp_metric_observe(int id, uint64_t ns) {
+  vp_hist_shard_t* h = &_vp_metric_shard()->h[id];
+  _VP_ADD(h->count, 1);
+  _VP_ADD(h->sum, ns);
+  _VP_ADD(h->b[vp_hist_bucket(ns)], 1);
+}
+
+static inline uint64_t vp_metric_counter(int id) {
+  uint64_t n = 0;
+  for (int s = 0; s < VP_METRIC_SHARDS; s++) n += _VP_LOAD(vp_metric_shards[s].c[id]);
+  return n;
+}
+
+/*
+  @brief
+  Merged latency histogram of one metric
+
+  @param id    VP_H_* histogram
+  @param b     bucket counts, len VP_HIST_BUCKETS
+  @param count total observations
+  @param sum   sum of observations (ns)
+*/
+static inline void vp_metric_histogram(int id, uint64_t* b, uint64_t* count, uint64_t* sum) {
+  memset(b, 0, VP_HIST_BUCKETS * sizeof(uint64_t));
+  *count = *sum = 0;
+  for (int s = 0; s < VP_METRIC_SHARDS; s++) {
+    vp_hist_shard_t* h = &vp_metric_shards[s].h[id];
+    *count += _VP_LOAD(h->count);
+    *sum += _VP_LOAD(h->sum);
+    for (uint32_t i = 0; i < VP_HIST_BUCKETS; i++) b[i] += _VP_LOAD(h->b[i]);
+  }
+}
+
+/* Output callback for `vp_metrics_export`; return non-zero to abort */
+typedef int (*vp_write_fn)(const char* buf, size_t len, void* ud);
+
+/*
+  @brief
+  Render all metrics in Prometheus text exposition format. Counters
+  are exported as counters, latency histograms as summaries with
+  0.5/0.9/0.99/0.999 quantiles in seconds.
+
+  @returns status  0: success, -1: callback aborted or out of memory
+*/
+static inline int vp_metrics_export(vp_write_fn fn, void* ud) {
+  char line[256];
+  int n;
+  for (int i = 0; i < VP_M_NCOUNTERS; i++) {
+    n = snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", vp_counter_names[i],
+                 vp_counter_help[i], vp_counter_names[i], vp_counter_names[i],
+                 (unsigned long long)vp_metric_counter(i));
+    if (fn(line, (size_t)n, ud)) return -1;
+  }
+  uint64_t* b = (uint64_t*)vp_malloc(VP_MEM_SCRATCH, VP_HIST_BUCKETS * sizeof(uint64_t));
+  if (!b) return -1;
+  static const double qs[4] = {0.5, 0.9, 0.99, 0.999};
+  for (int i = 0; i < VP_H_NHISTOGRAMS; i++) {
+    uint64_t count, sum;
+    vp_metric_histogram(i, b, &count, &sum);
+    n = snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s summary\n", vp_hist_names[i], vp_hist_help[i],
+                 vp_hist_names[i]);
+    if (fn(line, (size_t)n, ud)) { vp_free(VP_MEM_SCRATCH, b, VP_HIST_BUCKETS * sizeof(uint64_t)); return -1; }
+    for (int q = 0; q < 4; q++) {
+      n = snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %.9f\n", vp_hist_names[i], qs[q],
+                   (double)vp_hist_quantile(b, count, qs[q]) * 1e-9);
+      if (fn(line, (size_t)n, ud)) { vp_free(VP_MEM_SCRATCH, b, VP_HIST_BUCKETS * sizeof(uint64_t)); return -1; }
+    }
+    n = snprintf(line, sizeof(line), "%s_sum %.9f\n%s_count %llu\n", vp_hist_names[i], (double)sum * 1e-9,
+                 vp_hist_names[i], (unsigned long long)count);
+    if (fn(line, (size_t)n, ud)) { vp_free(VP_MEM_SCRATCH, b, VP_HIST_BUCKETS * sizeof(uint64_t)); return -1; }
+  }
+  vp_free(VP_MEM_SCRATCH, b, VP_HIST_BUCKETS * sizeof(uint64_t));
+  return 0;
+}
+
+static inline int _vp_write_file(const char* buf, size_t len, void* ud) {
+  return fwrite(buf, 1, len, (FILE*)ud) != len;
+}
+
+/*
+  @brief
+  Write all metrics to a file in Prometheus text format, e.g. for the
+  node_exporter textfile collector
+
+  @returns status  0: success, -1: write error
+*/
+static inline int vp_metrics_write(FILE* fp) {
+  return vp_metrics_export(_vp_write_file, fp);
+}
+
+#define VP_METRIC_INC(id, n)       vp_metric_add(id, n)
+#define VP_METRIC_TIMER(var)       uint64_t var = vp_clock_ns()
+#define VP_METRIC_OBSERVE(id, var) vp_metric_observe(id, vp_clock_ns() - (var))
+#else
+#define VP_METRIC_INC(id, n)       ((void)0)
+#define VP_METRIC_TIMER(var)       ((void)0)
+#define VP_METRIC_OBSERVE(id, var) ((void)0)
+#endif
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             PACKED CONTAINER
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*
+  On-disk layout, native (little) endian:
+
+  file header   magic "VPK1" | version | nsamples | flags          16 bytes
+  block         vp_block_hdr_t                                     32 bytes
+                site words    nsites * 8 bytes
+                rows          nsites * vp_row_words(nsamples) * 8 bytes
+  block ...
+  footer sections (optional, flag VP_FILE_FOOTER)
+                index         vp_block_ref_t[nblocks]
+                stats         vp_block_stats_t[nblocks]
+                bloom         uint64_t start[nblocks + 1], filter words
+                samples       uint64_t n, uint64_t name_off[n + 1],
+                              uint32_t order[n], names
+  footer        vp_footer_t                                       112 bytes
+  trailer       footer offset | footer CRC32C | magic "VEND"      16 bytes
+
+  Every block carries the CRC32C of its site words and rows.
+
+  The footer lets a reader open a file in O(1): it reads the trailer
+  and footer, maps the sections, and touches each section only on
+  first use, verifying its CRC32C then. Files without a valid footer
+  (older files, or a writer that never closed) are indexed by
+  scanning the block headers instead.
+*/
+#define VP_FILE_MAGIC    0x314b5056u /* "VPK1" */
+#define VP_BLOCK_MAGIC   0x4b4c4256u /* "VBLK" */
+#define VP_FILE_VERSION  1
+#define VP_BLOCK_CRC     0x1
+#define VP_FILE_FOOTER   0x1         /* file header flag */
+#define VP_FOOTER_MAGIC  0x52544656u /* "VFTR" */
+#define VP_TRAILER_MAGIC 0x444e4556u /* "VEND" */
+
+#ifndef VP_BLOOM_BITS
+#define VP_BLOOM_BITS    10          /* per site, ~1% false positives */
+#endif
+
+#define VP_EIO       -1
+#define VP_ECHECKSUM -2
+#define VP_ENOMEM    -3
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t nsites;
+  uint32_t crc;
+  uint32_t flags;
+  vpack64_t first;   // first site word
+  vpack64_t last;    // last site word
+} vp_block_hdr_t;
+
+/*
+  @brief
+  Location and key range of a block in the file
+*/
+typedef struct
+{
+  uint64_t off;      // file offset of the block header
+  uint32_t nsites;
+  uint32_t crc;
+  uint32_t flags;
+  uint32_t reserved; // zero
+  vpack64_t first;
+  vpack64_t last;
+} vp_block_ref_t;
+
+/*
+  @brief
+  Per-block summary, e.g. to skip blocks without carriers
+*/
+typedef struct
+{
+  uint64_t alt_alleles;    // alt alleles over all sites
+  uint32_t nonref_sites;   // sites with at least one alt allele
+  uint32_t max_ac;         // largest alt allele count of a site
+} vp_block_stats_t;
+
+/* Accumulate the selected sites into a `vp_block_stats_t` (ud) */
+static inline int vp_visit_block_stats(vp_batch_t* b, void* ud) {
+  vp_block_stats_t* st = (vp_block_stats_t*)ud;
+  uint32_t ac[VP_BATCH_SITES];
+  vp_batch_ac(b, ac);
+  VP_BATCH_EACH(b, i) {
+    st->alt_alleles += ac[i];
+    st->nonref_sites += ac[i] > 0;
+    if (ac[i] > st->max_ac) st->max_ac = ac[i];
+  }
+  return 0;
+}
+
+enum {
+  VP_SEC_INDEX,
+  VP_SEC_STATS,
+  VP_SEC_BLOOM,
+  VP_SEC_SAMPLES,
+  VP_SEC_N
+};
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t nblocks;
+  uint64_t nsites;
+  uint64_t sec_off[VP_SEC_N];   // file offsets, 0: section absent
+  uint64_t sec_len[VP_SEC_N];   // bytes
+  uint32_t sec_crc[VP_SEC_N];
+  uint32_t bloom_bits;          // per site, 0: no Bloom filters
+  uint32_t bloom_k;
+} vp_footer_t;
+
+typedef struct
+{
+  uint64_t footer_off;
+  uint32_t footer_crc;
+  uint32_t magic;
+} vp_trailer_t;
+
+/*
+  Block Bloom filters hold the chrom:pos key of every site (ref and
+  alt are ignored), so point lookups can skip blocks without reading
+  them. Probes use double hashing over `nbits` bits.
+*/
+static inline uint32_t vp_bloom_k(uint32_t bits_per_site) {
+  uint32_t k = (uint32_t)(bits_per_site * 0.6931 + 0.5);
+  return k < 1 ? 1 : k > 16 ? 16 : k;
+}
+
+static inline uint64_t vp_bloom_words(uint64_t nsites, uint32_t bits_per_site) {
+  uint64_t w = (nsites * bits_per_site + 63) / 64;
+  return w ? w : 1;
+}
+
+static inline uint64_t vp_bloom_key(vpack64_t site) {
+  return vp_hash64(site >> 4);
+}
+
+static inline void vp_bloom_add(uint64_t* f, uint64_t nwords, uint32_t k, uint64_t h) {
+  uint64_t nbits = nwords * 64;
+  uint32_t x = (uint32_t)h, step = (uint32_t)(h >> 32) | 1;
+  for (uint32_t i = 0; i < k; i++, x += step) {
+    uint64_t b = ((uint64_t)x * nbits) >> 32;
+    f[b >> 6] |= 1ULL << (b & 63);
+  }
+}
+
+static inline int vp_bloom_test(const uint64_t* f, uint64_t nwords, uint32_t k, uint64_t h) {
+  uint64_t nbits = nwords * 64;
+  uint32_t x = (uint32_t)h, step = (uint32_t)(h >> 32) | 1;
+  for (uint32_t i = 0; i < k; i++, x += step) {
+    uint64_t b = ((uint64_t)x * nbits) >> 32;
+    if (!(f[b >> 6] >> (b & 63) & 1)) return 0;
+  }
+  return 1;
+}
+
+/*
+  @brief
+  Block writer. Sites are buffered and written one block at a time.
+
+  Open with `vp_writer_open()`, finish with `vp_writer_close()`
+*/
+typedef struct
+{
+  FILE* fp;
+  uint32_t nsamples;
+  uint32_t block_sites;  // sites per block, halved under memory pressure
+  uint32_t checksum;     // 1: write CRC32C per block (default)
+  vp_mat_t buf;          // pending block, rows sized for block_sites
+  uint32_t site_cap;     // sites allocated in `buf.sites`
+  uint64_t nblocks;
+  uint64_t nsites;
+  uint64_t off;          // bytes written
+
+  /* footer, kept in memory until close */
+  uint32_t bloom_bits;   // Bloom bits per site (default VP_BLOOM_BITS), 0: none
+  int footer;            // 1: write a footer (default), cleared if it cannot be built
+  uint64_t refs_cap;
+  vp_block_ref_t* refs;
+  vp_block_stats_t* stats;
+  uint64_t* bloom_start; // nblocks + 1 word offsets into `bloom`
+  uint64_t* bloom;
+  uint64_t bloom_cap;    // words
+  char* names;           // sample dictionary, NUL separated
+  size_t names_len;
+
+  /* checkpoints, see `vp_writer_checkpoint_every` */
+  char* ckpt_path;
+  const uint64_t* ckpt_pos;  // caller's input positions, read at each checkpoint
+  uint32_t ckpt_npos;
+  uint32_t ckpt_every;       // blocks between checkpoints, 0: off
+  uint64_t ckpt_blocks;      // nblocks at the last checkpoint
+} vp_writer_t;
+
+static inline size_t _vp_writer_bytes(const vp_writer_t* w, size_t nsites, int rows) {
+  return nsites * (rows ? vp_row_words(w->nsamples) : 1) * sizeof(vpack64_t);
+}
+
+/* Bloom start offsets, one more than blocks; nothing before the first block */
+static inline size_t _vp_start_bytes(uint64_t cap) {
+  return cap ? (cap + 1) * sizeof(uint64_t) : 0;
+}
+
+static inline void _vp_writer_free(vp_writer_t* w) {
+  vp_free(VP_MEM_BATCH, w->buf.sites, _vp_writer_bytes(w, w->site_cap, 0));
+  vp_free(VP_MEM_BATCH, w->buf.gts, _vp_writer_bytes(w, w->block_sites, 1));
+  vp_free(VP_MEM_INDEX, w->refs, w->refs_cap * sizeof(vp_block_ref_t));
+  vp_free(VP_MEM_INDEX, w->stats, w->refs_cap * sizeof(vp_block_stats_t));
+  vp_free(VP_MEM_INDEX, w->bloom_start, _vp_start_bytes(w->refs_cap));
+  vp_free(VP_MEM_INDEX, w->bloom, w->bloom_cap * sizeof(uint64_t));
+  vp_free(VP_MEM_INDEX, w->names, w->names_len);
+  vp_free(VP_MEM_BATCH, w->ckpt_path, w->ckpt_path ? strlen(w->ckpt_path) + 1 : 0);
+  w->ckpt_path = NULL;
+  w->buf.sites = w->buf.gts = NULL;
+  w->refs = NULL;
+  w->stats = NULL;
+  w->bloom_start = w->bloom = NULL;
+  w->names = NULL;
+}
+
+/*
+  @brief
+  Store sample names in the footer's sample dictionary.
+
+  @param w     writer
+  @param names `nsamples` NUL-terminated names
+
+  @returns status  0: success, -1: out of memory
+*/
+static inline int vp_writer_set_samples(vp_writer_t* w, const char* const* names) {
+  size_t len = 0;
+  for (uint32_t i = 0; i < w->nsamples; i++) len += strlen(names[i]) + 1;
+  char* buf = (char*)vp_malloc(VP_MEM_INDEX, len);
+  if (!buf) return -1;
+  for (uint32_t i = 0, o = 0; i < w->nsamples; i++) {
+    size_t n = strlen(names[i]) + 1;
+    memcpy(buf + o, names[i], n);
+    o += (uint32_t)n;
+  }
+  vp_free(VP_MEM_INDEX, w->names, w->names_len);
+  w->names = buf;
+  w->names_len = len;
+  return 0;
+}
+
+/*
+  Reserve the footer entry of the next block: its ref, and `nw` Bloom
+  words at `w->bloom + w->bloom_start[w->nblocks]`. On allocation
+  failure the footer is dropped; the blocks themselves stay readable.
+
+  @returns status  0: success, -1: no footer
+*/
+static inline int _vp_writer_index_slot(vp_writer_t* w, const vp_block_hdr_t* h, uint64_t nw) {
+  if (!w->footer) return -1;
+  if (w->nblocks == w->refs_cap) {
+    uint64_t cap = w->refs_cap ? w->refs_cap * 2 : 64;
+    vp_block_ref_t* r = (vp_block_ref_t*)vp_realloc(VP_MEM_INDEX, w->refs, w->refs_cap * sizeof(vp_block_ref_t),
+                                                    cap * sizeof(vp_block_ref_t));
+    if (r) w->refs = r;
+    vp_block_stats_t* st = (vp_block_stats_t*)vp_realloc(VP_MEM_INDEX, w->stats, w->refs_cap * sizeof(vp_block_stats_t),
+                                                         cap * sizeof(vp_block_stats_t));
+    if (st) w->stats = st;
+    uint64_t* bs = (uint64_t*)vp_realloc(VP_MEM_INDEX, w->bloom_start, _vp_start_bytes(w->refs_cap),
+                                         _vp_start_bytes(cap));
+    if (bs) w->bloom_start = bs;
+    if (!r || !st || !bs) {
+      /* free at the size each array actually has, then drop the footer */
+      vp_free(VP_MEM_INDEX, w->refs, (r ? cap : w->refs_cap) * sizeof(vp_block_ref_t));
+      vp_free(VP_MEM_INDEX, w->stats, (st ? cap : w->refs_cap) * sizeof(vp_block_stats_t));
+      vp_free(VP_MEM_INDEX, w->bloom_start, _vp_start_bytes(bs ? cap : w->refs_cap));
+      w->refs = NULL;
+      w->stats = NULL;
+      w->bloom_start = NULL;
+      w->refs_cap = 0;
+      w->footer = 0;
+      return -1;
+    }
+    if (!w->refs_cap) w->bloom_start[0] = 0;
+    w->refs_cap = cap;
+  }
+  uint64_t b = w->nblocks;
+  w->refs[b] = (vp_block_ref_t){w->off, h->nsites, h->crc, h->flags, 0, h->first, h->last};
+
+  uint64_t at = w->bloom_start[b];
+  if (at + nw > w->bloom_cap) {
+    uint64_t cap = w->bloom_cap ? w->bloom_cap : 1024;
+    while (cap < at + nw) cap *= 2;
+    uint64_t* f = (uint64_t*)vp_realloc(VP_MEM_INDEX, w->bloom, w->bloom_cap * sizeof(uint64_t), cap * sizeof(uint64_t));
+    if (!f) { w->footer = 0; return -1; }
+    w->bloom = f;
+    w->bloom_cap = cap;
+  }
+  w->bloom_start[b + 1] = at + nw;
+  return 0;
+}
+
+/* Record a flushed block in the footer index */
+static inline void _vp_writer_index(vp_writer_t* w, const vp_block_hdr_t* h, const vp_mat_t* m) {
+  uint64_t nw = w->bloom_bits ? vp_bloom_words(m->nsites, w->bloom_bits) : 0;
+  if (_vp_writer_index_slot(w, h, nw)) return;
+  uint64_t b = w->nblocks, at = w->bloom_start[b];
+
+  vp_block_stats_t st = {0, 0, 0};
+  vp_mat_visit(m, vp_visit_block_stats, &st);
+  w->stats[b] = st;
+
+  if (nw) {
+    uint32_t k = vp_bloom_k(w->bloom_bits);
+    memset(w->bloom + at, 0, nw * sizeof(uint64_t));
+    for (size_t i = 0; i < m->nsites; i++) vp_bloom_add(w->bloom + at, nw, k, vp_bloom_key(m->sites[i]));
+  }
+}
+
+static inline int _vp_write_section(vp_writer_t* w, vp_footer_t* f, int sec, const void* p, size_t len) {
+  f->sec_off[sec] = w->off;
+  f->sec_len[sec] = len;
+  f->sec_crc[sec] = vp_crc32c(0, p, len);
+  if (len && fwrite(p, 1, len, w->fp) != len) return -1;
+  w->off += len;
+  return 0;
+}
+
+typedef struct
+{
+  const char* name;
+  uint32_t idx;
+} _vp_name_t;
+
+static inline int _vp_name_cmp(const void* a, const void* b) {
+  return strcmp(((const _vp_name_t*)a)->name, ((const _vp_name_t*)b)->name);
+}
+
+/* Sample dictionary: count, name offsets, order sorted by name, names */
+static inline int _vp_write_samples(vp_writer_t* w, vp_footer_t* f) {
+  uint64_t n = w->nsamples;
+  size_t len = (2 + n) * sizeof(uint64_t) + n * sizeof(uint32_t) + w->names_len;
+  uint8_t* p = (uint8_t*)vp_malloc(VP_MEM_SCRATCH, len);
+  if (!p) return -1;
+  uint64_t* off = (uint64_t*)(p + sizeof(uint64_t));
+  uint32_t* order = (uint32_t*)(off + n + 1);
+  char* names = (char*)(order + n);
+  memcpy(p, &n, sizeof(n));
+  memcpy(names, w->names, w->names_len);
+  off[0] = 0;
+  for (uint64_t i = 0; i < n; i++) off[i + 1] = off[i] + strlen(names + off[i]) + 1;
+  _vp_name_t* t = (_vp_name_t*)vp_malloc(VP_MEM_SCRATCH, n * sizeof(_vp_name_t));
+  if (!t) {
+    vp_free(VP_MEM_SCRATCH, p, len);
+    return -1;
+  }
+  for (uint32_t i = 0; i < n; i++) t[i] = (_vp_name_t){names + off[i], i};
+  qsort(t, n, sizeof(_vp_name_t), _vp_name_cmp);
+  for (uint32_t i = 0; i < n; i++) order[i] = t[i].idx;
+  vp_free(VP_MEM_SCRATCH, t, n * sizeof(_vp_name_t));
+  int rc = _vp_write_section(w, f, VP_SEC_SAMPLES, p, len);
+  vp_free(VP_MEM_SCRATCH, p, len);
+  return rc;
+}
+
+static inline int _vp_writer_footer(vp_writer_t* w) {
+  vp_footer_t f;
+  memset(&f, 0, sizeof(f));
+  f.magic = VP_FOOTER_MAGIC;
+  f.version = 1;
+  f.nblocks = w->nblocks;
+  f.nsites = w->nsites;
+  f.bloom_bits = w->bloom_bits;
+  f.bloom_k = w->bloom_bits ? vp_bloom_k(w->bloom_bits) : 0;
+  uint64_t nb = w->nblocks, zero = 0;
+  const uint64_t* start = nb ? w->bloom_start : &zero;
+  if (_vp_write_section(w, &f, VP_SEC_INDEX, w->refs, nb * sizeof(vp_block_ref_t)) ||
+      _vp_write_section(w, &f, VP_SEC_STATS, w->stats, nb * sizeof(vp_block_stats_t))) return -1;
+  /* bloom: start offsets and filter words are one section, one CRC */
+  uint32_t crc = vp_crc32c(0, start, (nb + 1) * sizeof(uint64_t));
+  crc = vp_crc32c(crc, w->bloom, start[nb] * sizeof(uint64_t));
+  f.sec_off[VP_SEC_BLOOM] = w->off;
+  f.sec_len[VP_SEC_BLOOM] = (nb + 1 + start[nb]) * sizeof(uint64_t);
+  f.sec_crc[VP_SEC_BLOOM] = crc;
+  if (fwrite(start, sizeof(uint64_t), nb + 1, w->fp) != nb + 1 ||
+      (start[nb] && fwrite(w->bloom, sizeof(uint64_t), start[nb], w->fp) != start[nb])) return -1;
+  w->off += f.sec_len[VP_SEC_BLOOM];
+  if (w->names && _vp_write_samples(w, &f)) return -1;
+  vp_trailer_t t = {w->off, vp_crc32c(0, &f, sizeof(f)), VP_TRAILER_MAGIC};
+  if (fwrite(&f, sizeof(f), 1, w->fp) != 1 || fwrite(&t, sizeof(t), 1, w->fp) != 1) return -1;
+  w->off += sizeof(f) + sizeof(t);
+  return 0;
+}
+
+/*
+  Checkpoint of an ingest into a container, written next to it every
+  few sealed blocks. It records the output bytes covered by sealed
+  blocks and the caller's input positions just past the last record
+  in them. The positions are opaque: byte offsets, BGZF virtual
+  offsets, record numbers, one per input. Resuming truncates the
+  output to `off` and rebuilds the footer state from the sealed
+  blocks, so the finished file is identical to an uninterrupted run.
+*/
+#define VP_CKPT_MAGIC 0x504b4356u /* "VCKP" */
+#define VP_CKPT_MAX_POS 16
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t nsamples;
+  uint32_t block_sites;  // writer block size when taken
+  uint32_t checksum;
+  uint32_t bloom_bits;
+  uint32_t every;        // blocks between checkpoints
+  uint32_t npos;
+  uint64_t pos[VP_CKPT_MAX_POS];
+  uint64_t off;          // output bytes in sealed blocks, header included
+  uint64_t nblocks;
+  uint64_t nsites;
+  uint32_t reserved;
+  uint32_t crc;          // CRC32C of the fields above
+} vp_ckpt_t;
+
+static inline int _vp_sync(FILE* fp) {
+  if (fflush(fp)) return -1;
+#if defined(VP_HAVE_FSYNC)
+  if (fsync(fileno(fp))) return -1;
+#endif
+  return 0;
+}
+
+/*
+  @brief
+  Write a checkpoint now. Called by the writer every `ckpt_every`
+  sealed blocks. Sealed blocks are synced to disk first, then the
+  checkpoint replaces the previous one atomically (written to a
+  temporary file, synced and renamed), so a crash at any point leaves
+  a checkpoint whose blocks are all on disk. Pending sites are not
+  covered: the input positions describe the last sealed block only
+  if the caller updates them before each `vp_writer_add`.
+
+  @returns status  0: success, -1: write error
+*/
+static inline int vp_writer_checkpoint(vp_writer_t* w) {
+  if (!w->ckpt_path) return 0;
+  vp_ckpt_t c;
+  memset(&c, 0, sizeof(c));
+  c.magic = VP_CKPT_MAGIC;
+  c.version = 1;
+  c.nsamples = w->nsamples;
+  c.block_sites = w->block_sites;
+  c.checksum = w->checksum;
+  c.bloom_bits = w->bloom_bits;
+  c.every = w->ckpt_every;
+  c.npos = w->ckpt_npos;
+  memcpy(c.pos, w->ckpt_pos, w->ckpt_npos * sizeof(uint64_t));
+  c.off = w->off;
+  c.nblocks = w->nblocks;
+  c.nsites = w->nsites - w->buf.nsites;
+  c.crc = vp_crc32c(0, &c, sizeof(c) - sizeof(uint32_t));
+  size_t n = strlen(w->ckpt_path);
+  char* tmp = (char*)vp_malloc(VP_MEM_SCRATCH, n + 5);
+  if (!tmp) return -1;
+  memcpy(tmp, w->ckpt_path, n);
+  memcpy(tmp + n, ".tmp", 5);
+  FILE* fp = _vp_sync(w->fp) ? NULL : fopen(tmp, "wb");
+  int rc = -1;
+  if (fp) {
+    rc = fwrite(&c, sizeof(c), 1, fp) != 1 || _vp_sync(fp);
+    if (fclose(fp)) rc = -1;
+    if (!rc) rc = rename(tmp, w->ckpt_path) ? -1 : 0;
+  }
+  vp_free(VP_MEM_SCRATCH, tmp, n + 5);
+  if (rc) return -1;
+  w->ckpt_blocks = w->nblocks;
+  return 0;
+}
+
+/*
+  @brief
+  Checkpoint the ingest every `every` sealed blocks. `pos` is the
+  caller's array of `npos` input positions, read at each checkpoint;
+  update it before each `vp_writer_add` to the position just past the
+  record being added. Each checkpoint costs one fsync and a small
+  file, so the overhead is negligible with a few hundred blocks between
+  checkpoints.
+
+  @returns status  0: success, -1: too many positions or out of memory
+*/
+static inline int vp_writer_checkpoint_every(vp_writer_t* w, const char* path, uint32_t every,
+                                             const uint64_t* pos, uint32_t npos) {
+  if (npos > VP_CKPT_MAX_POS) return -1;
+  size_t n = strlen(path) + 1;
+  char* p = (char*)vp_malloc(VP_MEM_BATCH, n);
+  if (!p) return -1;
+  memcpy(p, path, n);
+  vp_free(VP_MEM_BATCH, w->ckpt_path, w->ckpt_path ? strlen(w->ckpt_path) + 1 : 0);
+  w->ckpt_path = p;
+  w->ckpt_every = every;
+  w->ckpt_pos = pos;
+  w->ckpt_npos = npos;
+  w->ckpt_blocks = w->nblocks;
+  return 0;
+}
+
+/*
+  @brief
+  Create a container file.
+
+  @param w           writer
+  @param path        output path
+  @param nsamples    samples per row
+  @param block_sites sites per block
+
+  @returns status  0: success, -1: error
+*/
+static inline int _vp_writer_init(vp_writer_t* w, uint32_t nsamples, uint32_t block_sites) {
+  memset(w, 0, sizeof(*w));
+  if (!block_sites) return -1;
+  w->nsamples = nsamples;
+  w->block_sites = block_sites;
+  w->checksum = 1;
+  w->bloom_bits = VP_BLOOM_BITS;
+  w->footer = 1;
+  w->buf.nsamples = nsamples;
+  w->site_cap = block_sites;
+  w->buf.sites = (vpack64_t*)vp_malloc(VP_MEM_BATCH, _vp_writer_bytes(w, block_sites, 0));
+  w->buf.gts = (vpack64_t*)vp_malloc(VP_MEM_BATCH, _vp_writer_bytes(w, block_sites, 1));
+  if (w->buf.sites && w->buf.gts) return 0;
+  _vp_writer_free(w);
+  memset(w, 0, sizeof(*w));
+  return -1;
+}
+
+static inline int vp_writer_open(vp_writer_t* w, const char* path, uint32_t nsamples, uint32_t block_sites) {
+  if (_vp_writer_init(w, nsamples, block_sites)) return -1;
+  w->fp = fopen(path, "wb");
+  uint32_t hdr[4] = {VP_FILE_MAGIC, VP_FILE_VERSION, nsamples, VP_FILE_FOOTER};
+  if (!w->fp || fwrite(hdr, sizeof(hdr), 1, w->fp) != 1) {
+    if (w->fp) fclose(w->fp);
+    _vp_writer_free(w);
+    memset(w, 0, sizeof(*w));
+    return -1;
+  }
+  w->off = sizeof(hdr);
+  return 0;
+}
+
+/* smallest block a writer shrinks to under pressure, a power of two */
+#ifndef VP_WRITER_MIN_SITES
+#define VP_WRITER_MIN_SITES 64
+#endif
+
+/*
+  Halve the row buffer of an empty writer, so later blocks are
+  smaller and spill to disk sooner. Rows dominate the buffer; the
+  site array keeps its size. A failed realloc keeps the old buffer.
+*/
+static inline void _vp_writer_shrink(vp_writer_t* w) {
+  uint32_t n = w->block_sites / 2;
+  if (n < VP_WRITER_MIN_SITES) n = VP_WRITER_MIN_SITES;
+  vpack64_t* g = (vpack64_t*)vp_realloc(VP_MEM_BATCH, w->buf.gts, _vp_writer_bytes(w, w->block_sites, 1),
+                                        _vp_writer_bytes(w, n, 1));
+  if (!g) return;
+  w->buf.gts = g;
+  w->block_sites = n;
+}
+
+/*
+  @brief
+  Write the pending block, if any
+
+  @returns status  0: success, -1: write error
+*/
+static inline int vp_writer_flush(vp_writer_t* w) {
+  vp_mat_t* m = &w->buf;
+  if (!m->nsites) return 0;
+  VP_METRIC_TIMER(t0);
+  size_t rw = vp_row_words(w->nsamples);
+  vp_block_hdr_t h = {VP_BLOCK_MAGIC, (uint32_t)m->nsites, 0, 0, m->sites[0], m->sites[m->nsites - 1]};
+  VP_TRACE_BEGIN(encode);
+  if (w->checksum) {
+    h.crc = vp_mat_crc(m);
+    h.flags |= VP_BLOCK_CRC;
+  }
+  VP_TRACE_END(encode);
+  VP_TRACE_BEGIN(io);
+  if (fwrite(&h, sizeof(h), 1, w->fp) != 1 ||
+      fwrite(m->sites, sizeof(vpack64_t), m->nsites, w->fp) != m->nsites ||
+      fwrite(m->gts, sizeof(vpack64_t), m->nsites * rw, w->fp) != m->nsites * rw) return -1;
+  VP_TRACE_END(io);
+  _vp_writer_index(w, &h, m);
+  w->off += sizeof(h) + m->nsites * (1 + rw) * sizeof(vpack64_t);
+  VP_METRIC_INC(VP_M_BLOCKS_WRITTEN, 1);
+  VP_METRIC_INC(VP_M_BYTES_WRITTEN, sizeof(h) + m->nsites * (1 + rw) * sizeof(vpack64_t));
+  VP_METRIC_OBSERVE(VP_H_FLUSH_LATENCY, t0);
+  w->nblocks++;
+  m->nsites = 0;
+  if (vp_mem_pressure() && w->block_sites > VP_WRITER_MIN_SITES) _vp_writer_shrink(w);
+  if (w->ckpt_every && w->nblocks - w->ckpt_blocks >= w->ckpt_every) return vp_writer_checkpoint(w);
+  return 0;
+}
+
+/*
+  @brief
+  Append one site and its packed row. Sites should be added in
+  genomic order for `vp_reader_find` to work.
+
+  @param w    writer
+  @param site `vpack64_loc` word
+  @param row  packed row, vp_row_words(nsamples) words
+
+  @returns status  0: success, -1: write error
+*/
+static inline int vp_writer_add(vp_writer_t* w, vpack64_t site, const vpack64_t* row) {
+  vp_mat_t* m = &w->buf;
+  size_t rw = vp_row_words(w->nsamples);
+  m->sites[m->nsites] = site;
+  memcpy(m->gts + m->nsites * rw, row, rw * sizeof(vpack64_t));
+  m->nsites++;
+  w->nsites++;
+  VP_METRIC_INC(VP_M_RECORDS_PACKED, 1);
+  if (m->nsites == w->block_sites) return vp_writer_flush(w);
+  /* under pressure, spill a partial block rather than hold it */
+  if (m->nsites >= VP_WRITER_MIN_SITES && !(m->nsites & (VP_WRITER_MIN_SITES - 1)) && vp_mem_pressure())
+    return vp_writer_flush(w);
+  return 0;
+}
+
+/*
+  @brief
+  Flush pending sites and close the file
+
+  @returns status  0: success, -1: write error
+*/
+static inline int vp_writer_close(vp_writer_t* w) {
+  int rc = vp_writer_flush(w);
+  if (!rc && w->footer && _vp_writer_footer(w)) rc = -1;
+  if (fclose(w->fp)) rc = -1;
+  _vp_writer_free(w);
+  w->fp = NULL;
+  return rc;
+}
+
+/*
+  @brief
+  Reopen an interrupted ingest at its last checkpoint. The sealed
+  blocks are read back and verified to rebuild the footer index, and
+  the file is cut at the end of the last sealed block. The caller then
+  seeks its inputs to `pos`, re-applies settings such as
+  `vp_writer_set_samples` and `vp_writer_checkpoint_every`, and adds
+  records as before. Needs `ftruncate` (VP_HAVE_FSYNC); elsewhere a
+  longer interrupted tail could not be cut and resuming fails.
+
+  @param w    writer
+  @param path container being written
+  @param ckpt checkpoint path
+  @param pos  receives the input positions, VP_CKPT_MAX_POS words
+  @param npos receives the number of positions
+
+  @returns status  0: success, -1: error, VP_ECHECKSUM: bad checkpoint or sealed block
+*/
+static inline int vp_writer_resume(vp_writer_t* w, const char* path, const char* ckpt, uint64_t* pos, uint32_t* npos) {
+  vp_ckpt_t c;
+  FILE* fp = fopen(ckpt, "rb");
+  if (!fp) return -1;
+  int ok = fread(&c, sizeof(c), 1, fp) == 1;
+  fclose(fp);
+  if (!ok) return -1;
+  if (c.magic != VP_CKPT_MAGIC || c.npos > VP_CKPT_MAX_POS || !c.block_sites ||
+      c.crc != vp_crc32c(0, &c, sizeof(c) - sizeof(uint32_t))) return VP_ECHECKSUM;
+  if (_vp_writer_init(w, c.nsamples, c.block_sites)) return -1;
+  w->checksum = c.checksum;
+  w->bloom_bits = c.bloom_bits;
+  w->fp = fopen(path, "r+b");
+  uint32_t hdr[4];
+  int rc = -1;
+  size_t rw = vp_row_words(c.nsamples), cap = 0;
+  vp_mat_t m = {NULL, NULL, 0, c.nsamples};
+  if (!w->fp || fread(hdr, sizeof(hdr), 1, w->fp) != 1 || hdr[0] != VP_FILE_MAGIC || hdr[2] != c.nsamples) goto fail;
+  /* rebuild the footer state from the sealed blocks, verifying each */
+  w->off = sizeof(hdr);
+  for (; w->nblocks < c.nblocks; w->nblocks++) {
+    vp_block_hdr_t h;
+    if (fread(&h, sizeof(h), 1, w->fp) != 1 || h.magic != VP_BLOCK_MAGIC) break;
+    if (h.nsites > cap) {
+      vp_free(VP_MEM_SCRATCH, m.sites, cap * (1 + rw) * sizeof(vpack64_t));
+      m.sites = (vpack64_t*)vp_malloc(VP_MEM_SCRATCH, h.nsites * (1 + rw) * sizeof(vpack64_t));
+      cap = m.sites ? h.nsites : 0;
+      if (!m.sites) break;
+    }
+    m.gts = m.sites + h.nsites;
+    m.nsites = h.nsites;
+    if (fread(m.sites, sizeof(vpack64_t), h.nsites * (1 + rw), w->fp) != h.nsites * (1 + rw)) break;
+    if ((h.flags & VP_BLOCK_CRC) && vp_mat_crc(&m) != h.crc) {
+      rc = VP_ECHECKSUM;
+      break;
+    }
+    _vp_writer_index(w, &h, &m);
+    w->off += sizeof(h) + h.nsites * (1 + rw) * sizeof(vpack64_t);
+    w->nsites += h.nsites;
+  }
+  vp_free(VP_MEM_SCRATCH, m.sites, cap * (1 + rw) * sizeof(vpack64_t));
+  if (w->nblocks != c.nblocks || w->off != c.off || w->nsites != c.nsites) goto fail;
+  /* drop whatever the interrupted run wrote after the checkpoint */
+#if defined(VP_HAVE_FSYNC)
+  if (fflush(w->fp) || ftruncate(fileno(w->fp), (off_t)c.off) || _vp_fseek(w->fp, (int64_t)c.off, SEEK_SET)) goto fail;
+#else
+  /* a tail longer than the resumed run would survive after its footer */
+  goto fail;
+#endif
+  w->ckpt_blocks = w->nblocks;
+  memcpy(pos, c.pos, c.npos * sizeof(uint64_t));
+  *npos = c.npos;
+  return 0;
+fail:
+  if (w->fp) fclose(w->fp);
+  _vp_writer_free(w);
+  memset(w, 0, sizeof(*w));
+  return rc;
+}
+
+typedef struct
+{
+  uint64_t block;    // UINT64_MAX: empty
+  vp_mat_t m;
+  size_t cap;        // allocated sites
+  int borrowed;      // 1: `m` points into a shared segment, not owned
+} vp_cache_slot_t;
+
+/*
+  Shared segment published by `vp_shm_publish`, see "SHARED MEMORY
+  SERVING". Every reference inside it is an offset from the segment
+  base, so each process may map it at a different address.
+*/
+#define VP_SHM_MAGIC 0x4d485356u /* "VSHM" */
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t ready;        // stored last by the loader
+  uint64_t size;         // segment bytes
+  uint32_t nsamples;
+  uint32_t reserved;
+  uint64_t nblocks;
+  uint64_t ncached;      // blocks with decoded data in the segment
+  uint64_t path_off;     // container path, NUL terminated
+  uint64_t index_off;    // vp_block_ref_t[nblocks]
+  uint64_t slot_off;     // uint64_t[nblocks], data offset per block, 0: not cached
+  uint64_t data_off;     // cached blocks: site words, then rows
+} vp_shm_hdr_t;
+
+typedef struct
+{
+  int fd;
+  uint8_t* base;
+  size_t size;
+  int writable;          // loader mapping
+} vp_shm_t;
+
+static inline const vp_shm_hdr_t* vp_shm_hdr(const vp_shm_t* s) {
+  return (const vp_shm_hdr_t*)s->base;
+}
+
+/*
+  Checksum policy of a reader. Blocks read from disk are "cold";
+  blocks served from the reader's cache are "hot".
+*/
+enum {
+  VP_VERIFY_COLD   = 0,  // verify blocks read from disk (default)
+  VP_VERIFY_ALWAYS = 1,  // also re-verify cache hits
+  VP_VERIFY_NEVER  = 2
+};
+
+#ifndef VP_CACHE_SLOTS
+#define VP_CACHE_SLOTS 8
+#endif
+
+/*
+  @brief
+  Block reader with a small direct-mapped cache of loaded blocks.
+  A reader is not thread safe; open one per thread.
+
+  Open with `vp_reader_open()`, free with `vp_reader_close()`
+*/
+typedef struct
+{
+  FILE* fp;
+  uint32_t nsamples;
+  uint32_t verify;           // VP_VERIFY_*
+  uint64_t nblocks;
+  uint64_t blocks_cap;       // 0 when `blocks` points into the footer map
+  vp_block_ref_t* blocks;
+  vp_cache_slot_t cache[VP_CACHE_SLOTS];
+
+  /* footer, when the file has a valid one */
+  int has_footer;
+  vp_footer_t footer;
+  void* map;                 // mapped footer sections
+  size_t map_len;
+  const uint8_t* sec_base;   // file offset footer.sec_off[VP_SEC_INDEX]
+  uint32_t sec_ok;           // sections verified, bit per VP_SEC_*
+  uint32_t sec_bad;          // sections that failed verification
+
+  const vp_shm_t* shm;       // shared segment consulted before the file
+} vp_reader_t;
+
+static inline void _vp_cache_drop(const vp_reader_t* r, vp_cache_slot_t* s) {
+  size_t rw = vp_row_words(r->nsamples);
+  if (!s->borrowed) {
+    vp_free(VP_MEM_CACHE, s->m.sites, s->cap * sizeof(vpack64_t));
+    vp_free(VP_MEM_CACHE, s->m.gts, s->cap * rw * sizeof(vpack64_t));
+  }
+  memset(s, 0, sizeof(*s));
+  s->block = UINT64_MAX;
+}
+
+static inline void _vp_reader_unmap(vp_reader_t* r) {
+  if (!r->map) return;
+#if defined(VP_HAVE_MMAP)
+  munmap(r->map, r->map_len);
+#else
+  vp_free(VP_MEM_INDEX, r->map, r->map_len);
+#endif
+  r->map = NULL;
+  r->has_footer = 0;
+}
+
+static inline void vp_reader_close(vp_reader_t* r) {
+  for (int i = 0; i < VP_CACHE_SLOTS; i++) _vp_cache_drop(r, &r->cache[i]);
+  vp_free(VP_MEM_INDEX, r->blocks_cap ? r->blocks : NULL, r->blocks_cap * sizeof(vp_block_ref_t));
+  _vp_reader_unmap(r);
+  if (r->fp) fclose(r->fp);
+  memset(r, 0, sizeof(*r));
+}
+
+/*
+  @brief
+  Release every cached block except slot `keep`
+*/
+static inline void vp_reader_trim(vp_reader_t* r, int keep) {
+  for (int i = 0; i < VP_CACHE_SLOTS; i++)
+    if (i != keep) _vp_cache_drop(r, &r->cache[i]);
+}
+
+/*
+  Grow a slot to hold `nsites` sites. Under memory pressure, or when
+  the budget refuses the allocation, the reader's cached blocks other
+  than slot `keep` are released first, so the cache shrinks to one
+  block before failing. Slots outside the cache pass `keep` -1.
+*/
+static inline int _vp_cache_reserve(vp_reader_t* r, vp_cache_slot_t* s, size_t nsites, int keep) {
+  if (vp_mem_pressure()) vp_reader_trim(r, keep);
+  if (!s->borrowed && s->cap >= nsites) return 0;
+  size_t rw = vp_row_words(r->nsamples);
+  _vp_cache_drop(r, s);  // contents are about to be replaced
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (attempt) vp_reader_trim(r, keep);
+    s->m.sites = (vpack64_t*)vp_malloc(VP_MEM_CACHE, nsites * sizeof(vpack64_t));
+    s->m.gts = (vpack64_t*)vp_malloc(VP_MEM_CACHE, nsites * rw * sizeof(vpack64_t));
+    s->cap = nsites;
+    if (s->m.sites && s->m.gts) return 0;
+    vp_free(VP_MEM_CACHE, s->m.sites, nsites * sizeof(vpack64_t));
+    vp_free(VP_MEM_CACHE, s->m.gts, nsites * rw * sizeof(vpack64_t));
+    memset(s, 0, sizeof(*s));
+    s->block = UINT64_MAX;
+  }
+  return VP_ENOMEM;
+}
+
+/*
+  @brief
+  Footer section `sec`, verified against its CRC32C on first use
+  unless `r->verify` is VP_VERIFY_NEVER.
+
+  @returns section bytes, or NULL if absent or corrupt
+*/
+static inline const void* vp_reader_section(vp_reader_t* r, int sec) {
+  if (!r->has_footer || !r->footer.sec_off[sec] || (r->sec_bad >> sec & 1)) return NULL;
+  const uint8_t* p = r->sec_base + (r->footer.sec_off[sec] - r->footer.sec_off[VP_SEC_INDEX]);
+  if (!(r->sec_ok >> sec & 1)) {
+    if (r->verify != VP_VERIFY_NEVER && vp_crc32c(0, p, r->footer.sec_len[sec]) != r->footer.sec_crc[sec]) {
+      VP_METRIC_INC(VP_M_CHECKSUM_ERRORS, 1);
+      r->sec_bad |= 1u << sec;
+      return NULL;
+    }
+    r->sec_ok |= 1u << sec;
+  }
+  return p;
+}
+
+/*
+  Load the footer: read the trailer and footer, then map the sections
+  between the last block and the footer. Pages are faulted in when a
+  section is first used, so the cost is independent of file size.
+*/
+static inline int _vp_reader_footer(vp_reader_t* r, const char* path) {
+  vp_trailer_t t;
+  vp_footer_t f;
+  if (_vp_fseek(r->fp, -(int64_t)sizeof(t), SEEK_END) || fread(&t, sizeof(t), 1, r->fp) != 1 ||
+      t.magic != VP_TRAILER_MAGIC) return -1;
+  int64_t end = _vp_ftell(r->fp);
+  if (end < 0 || t.footer_off + sizeof(f) + sizeof(t) != (uint64_t)end) return -1;
+  if (_vp_fseek(r->fp, (int64_t)t.footer_off, SEEK_SET) || fread(&f, sizeof(f), 1, r->fp) != 1 ||
+      f.magic != VP_FOOTER_MAGIC || vp_crc32c(0, &f, sizeof(f)) != t.footer_crc) return -1;
+  uint64_t lo = f.sec_off[VP_SEC_INDEX];
+  if (lo < 16 || f.sec_len[VP_SEC_INDEX] != f.nblocks * sizeof(vp_block_ref_t)) return -1;
+  for (int i = 0; i < VP_SEC_N; i++)
+    if (f.sec_off[i] && (f.sec_off[i] < lo || f.sec_off[i] + f.sec_len[i] > t.footer_off)) return -1;
+  size_t len = (size_t)(t.footer_off - lo);
+  if (!len) len = 1;
+#if defined(VP_HAVE_MMAP)
+  uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE), base = lo / page * page;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return -1;
+  void* map = mmap(NULL, len + (lo - base), PROT_READ, MAP_SHARED, fd, (off_t)base);
+  close(fd);
+  if (map == MAP_FAILED) return -1;
+  r->map = map;
+  r->map_len = len + (lo - base);
+  r->sec_base = (const uint8_t*)map + (lo - base);
+#else
+  (void)path;
+  void* map = vp_malloc(VP_MEM_INDEX, len);
+  if (!map) return -1;
+  r->map = map;
+  r->map_len = len;
+  r->sec_base = (const uint8_t*)map;
+  if (_vp_fseek(r->fp, (int64_t)lo, SEEK_SET) || fread(map, 1, len, r->fp) != len) {
+    _vp_reader_unmap(r);
+    return -1;
+  }
+#endif
+  r->has_footer = 1;
+  r->footer = f;
+  /* the index is needed right away; it is small, so verify it now */
+  r->blocks = (vp_block_ref_t*)vp_reader_section(r, VP_SEC_INDEX);
+  if (!r->blocks) {
+    _vp_reader_unmap(r);
+    return -1;
+  }
+  r->nblocks = f.nblocks;
+  return 0;
+}
+
+/*
+  @brief
+  Open a container. The block index comes from the footer when the
+  file has a valid one, otherwise from scanning the block headers.
+
+  @returns status  0: success, -1: error
+*/
+static inline int vp_reader_open(vp_reader_t* r, const char* path) {
+  memset(r, 0, sizeof(*r));
+  for (int i = 0; i < VP_CACHE_SLOTS; i++) r->cache[i].block = UINT64_MAX;
+  r->fp = fopen(path, "rb");
+  if (!r->fp) return -1;
+  uint32_t hdr[4];
+  if (fread(hdr, sizeof(hdr), 1, r->fp) != 1 || hdr[0] != VP_FILE_MAGIC || hdr[1] > VP_FILE_VERSION) {
+    fclose(r->fp);
+    r->fp = NULL;
+    return -1;
+  }
+  r->nsamples = hdr[2];
+  if ((hdr[3] & VP_FILE_FOOTER) && !_vp_reader_footer(r, path)) return 0;
+  size_t rw = vp_row_words(r->nsamples);
+  uint64_t off = sizeof(hdr);
+  vp_block_hdr_t h;
+  if (_vp_fseek(r->fp, (int64_t)off, SEEK_SET)) {
+    vp_reader_close(r);
+    return -1;
+  }
+  while (fread(&h, sizeof(h), 1, r->fp) == 1) {
+    if (h.magic != VP_BLOCK_MAGIC) break;
+    if (r->nblocks == r->blocks_cap) {
+      size_t cap = r->blocks_cap ? r->blocks_cap * 2 : 64;
+      vp_block_ref_t* b = (vp_block_ref_t*)vp_realloc(VP_MEM_INDEX, r->blocks, r->blocks_cap * sizeof(vp_block_ref_t),
+                                                      cap * sizeof(vp_block_ref_t));
+      if (!b) { vp_reader_close(r); return -1; }
+      r->blocks = b;
+      r->blocks_cap = cap;
+    }
+    r->blocks[r->nblocks++] = (vp_block_ref_t){off, h.nsites, h.crc, h.flags, 0, h.first, h.last};
+    off += sizeof(h) + (uint64_t)h.nsites * (1 + rw) * sizeof(vpack64_t);
+    if (_vp_fseek(r->fp, (int64_t)off, SEEK_SET)) break;
+  }
+  return 0;
+}
+
+
+/*
+  Read block `i` from the file into `m`, whose buffers hold at least
+  its sites, and verify it unless `r->verify` is VP_VERIFY_NEVER. The
+  one load path, for `vp_reader_read` misses and region read-ahead.
+
+  @returns status  0: success, VP_EIO: read error, VP_ECHECKSUM: corrupt block
+*/
+static inline int _vp_reader_load_block(vp_reader_t* r, uint64_t i, vp_mat_t* m) {
+  const vp_block_ref_t* b = &r->blocks[i];
+  size_t rw = vp_row_words(r->nsamples);
+  m->nsamples = r->nsamples;
+  m->nsites = b->nsites;
+  VP_TRACE_BEGIN(io);
+  if (_vp_fseek(r->fp, (int64_t)(b->off + sizeof(vp_block_hdr_t)), SEEK_SET) ||
+      fread(m->sites, sizeof(vpack64_t), b->nsites, r->fp) != b->nsites ||
+      fread(m->gts, sizeof(vpack64_t), (size_t)b->nsites * rw, r->fp) != (size_t)b->nsites * rw) return VP_EIO;
+  VP_TRACE_END(io);
+  VP_METRIC_INC(VP_M_BLOCKS_READ, 1);
+  VP_METRIC_INC(VP_M_BYTES_READ, (uint64_t)b->nsites * (1 + rw) * sizeof(vpack64_t));
+  VP_TRACE_BEGIN(verify);
+  if ((b->flags & VP_BLOCK_CRC) && r->verify != VP_VERIFY_NEVER && vp_mat_crc(m) != b->crc) {
+    VP_METRIC_INC(VP_M_CHECKSUM_ERRORS, 1);
+    return VP_ECHECKSUM;
+  }
+  VP_TRACE_END(verify);
+  return 0;
+}
+
+/*
+  @brief
+  Load block `i`. The returned matrix is owned by the reader's cache
+  and stays valid until another block maps to the same cache slot.
+  Checksums are verified according to `r->verify`.
+
+  @param r   reader
+  @param i   block index
+  @param out receives the block
+
+  @returns status  0: success, VP_EIO: read error, VP_ECHECKSUM: corrupt block,
+                   VP_ENOMEM: memory budget exhausted
+*/
+static inline int vp_reader_read(vp_reader_t* r, uint64_t i, const vp_mat_t** out) {
+  if (i >= r->nblocks) return VP_EIO;
+  const vp_block_ref_t* b = &r->blocks[i];
+  vp_cache_slot_t* s = &r->cache[i % VP_CACHE_SLOTS];
+  int check = (b->flags & VP_BLOCK_CRC) && r->verify != VP_VERIFY_NEVER;
+  VP_METRIC_TIMER(t0);
+  if (s->block == i) {
+    VP_METRIC_INC(VP_M_CACHE_HITS, 1);
+    if (check && r->verify == VP_VERIFY_ALWAYS && vp_mat_crc(&s->m) != b->crc) {
+      VP_METRIC_INC(VP_M_CHECKSUM_ERRORS, 1);
+      return VP_ECHECKSUM;
+    }
+    *out = &s->m;
+    VP_METRIC_OBSERVE(VP_H_READ_LATENCY, t0);
+    return 0;
+  }
+  if (r->shm) {
+    /* blocks in the shared segment were verified by the loader */
+    const vp_shm_hdr_t* sh = vp_shm_hdr(r->shm);
+    uint64_t off = i < sh->nblocks ? ((const uint64_t*)(r->shm->base + sh->slot_off))[i] : 0;
+    if (off) {
+      _vp_cache_drop(r, s);
+      vpack64_t* sites = (vpack64_t*)(r->shm->base + off);
+      s->m = (vp_mat_t){sites, sites + b->nsites, b->nsites, r->nsamples};
+      s->borrowed = 1;
+      s->block = i;
+      VP_METRIC_INC(VP_M_CACHE_HITS, 1);
+      if (check && r->verify == VP_VERIFY_ALWAYS && vp_mat_crc(&s->m) != b->crc) {
+        VP_METRIC_INC(VP_M_CHECKSUM_ERRORS, 1);
+        return VP_ECHECKSUM;
+      }
+      *out = &s->m;
+      VP_METRIC_OBSERVE(VP_H_READ_LATENCY, t0);
+      return 0;
+    }
+  }
+  VP_METRIC_INC(VP_M_CACHE_MISSES, 1);
+  s->block = UINT64_MAX;
+  int rc = _vp_cache_reserve(r, s, b->nsites, (int)(s - r->cache));
+  if (!rc) rc = _vp_reader_load_block(r, i, &s->m);
+  if (rc) return rc;
+  s->block = i;
+  *out = &s->m;
+  VP_METRIC_OBSERVE(VP_H_READ_LATENCY, t0);
+  return 0;
+}
+
+/*
+  @brief
+  Index of the first block whose last site is >= `key`, or
+  `r->nblocks` if every block ends before `key`
+*/
+static inline uint64_t vp_reader_find(const vp_reader_t* r, vpack64_t key) {
+  uint64_t lo = 0, hi = r->nblocks;
+  while (lo < hi) {
+    uint64_t mid = (lo + hi) >> 1;
+    if (r->blocks[mid].last < key) lo = mid + 1; else hi = mid;
+  }
+  return lo;
+}
+
+/*
+  @brief
+  Per-block stats from the footer, or NULL if the file has none
+*/
+static inline const vp_block_stats_t* vp_reader_stats(vp_reader_t* r) {
+  return (const vp_block_stats_t*)vp_reader_section(r, VP_SEC_STATS);
+}
+
+/*
+  @brief
+  Whether the file may hold a site at the chrom:pos of `site`. A 0 is
+  definite; a 1 may be a Bloom filter false positive, or the answer
+  for files without filters whenever a block's range covers the site.
+*/
+static inline int vp_reader_may_contain(vp_reader_t* r, vpack64_t site) {
+  vpack64_t key = site & ~0xfULL;
+  uint64_t b = vp_reader_find(r, key);
+  if (b >= r->nblocks || r->blocks[b].first > (key | 0xf)) return 0;
+  const uint64_t* bloom = (const uint64_t*)vp_reader_section(r, VP_SEC_BLOOM);
+  if (!bloom || !r->footer.bloom_k) return 1;
+  uint64_t h = vp_bloom_key(site);
+  /* one position may span adjacent blocks when it has several alleles */
+  for (; b < r->nblocks && r->blocks[b].first <= (key | 0xf); b++) {
+    const uint64_t* f = bloom + r->nblocks + 1 + bloom[b];
+    if (vp_bloom_test(f, bloom[b + 1] - bloom[b], r->footer.bloom_k, h)) return 1;
+  }
+  return 0;
+}
+
+/*
+  @brief
+  Name of sample `i` from the footer dictionary, or NULL
+*/
+static inline const char* vp_reader_sample_name(vp_reader_t* r, uint32_t i) {
+  const uint64_t* d = (const uint64_t*)vp_reader_section(r, VP_SEC_SAMPLES);
+  if (!d || i >= d[0]) return NULL;
+  uint64_t n = d[0];
+  const char* names = (const char*)((const uint32_t*)(d + n + 2) + n);
+  return names + d[1 + i];
+}
+
+/*
+  @brief
+  Index of the sample called `name`, by binary search of the footer
+  dictionary
+
+  @returns sample index, or -1 if not found or the file has no dictionary
+*/
+static inline long vp_reader_sample_index(vp_reader_t* r, const char* name) {
+  const uint64_t* d = (const uint64_t*)vp_reader_section(r, VP_SEC_SAMPLES);
+  if (!d) return -1;
+  uint64_t n = d[0], lo = 0, hi = n;
+  const uint32_t* order = (const uint32_t*)(d + n + 2);
+  const char* names = (const char*)(order + n);
+  while (lo < hi) {
+    uint64_t mid = (lo + hi) >> 1;
+    int c = strcmp(names + d[1 + order[mid]], name);
+    if (!c) return (long)order[mid];
+    if (c < 0) lo = mid + 1; else hi = mid;
+  }
+  return -1;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             SHARED MEMORY SERVING
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+  A loader process publishes a container's block index and a set of
+  hot, already verified blocks into one shared memory segment. Worker
+  processes attach read-only and open readers on it: the index is not
+  rebuilt per worker and cached blocks are served in place, so N
+  workers hold one copy of the index and hot data instead of N.
+
+  Segment layout (all references are offsets from the segment base):
+
+    vp_shm_hdr_t | path | vp_block_ref_t[nblocks] | uint64_t[nblocks] | blocks
+
+  The loader fills the segment, then sets `ready` with a release
+  store; attach checks it with an acquire load, so a worker never sees
+  a half-written segment. The segment is immutable once ready. To
+  publish a new version, publish under a new name and have workers
+  re-attach; existing mappings stay valid after `vp_shm_unlink`.
+*/
+#if defined(VP_HAVE_MMAP)
+
+static inline void vp_shm_close(vp_shm_t* s) {
+  if (s->base) munmap(s->base, s->size);
+  if (s->fd >= 0) close(s->fd);
+  memset(s, 0, sizeof(*s));
+  s->fd = -1;
+}
+
+/* Size a new segment; shared memory objects are extended by writing */
+static inline int _vp_shm_size(int fd, size_t size) {
+  char z = 0;
+  if (lseek(fd, (off_t)(size - 1), SEEK_SET) < 0 || write(fd, &z, 1) != 1) return -1;
+  return 0;
+}
+
+/*
+  @brief
+  Publish container `path` into shared memory segment `name` (a POSIX
+  shm name such as "/vpack-hg38"). Blocks listed in `hot` are copied
+  in order, or blocks 0, 1, ... when `hot` is NULL, until `budget`
+  bytes of block data are used. Every copied block is verified first;
+  blocks that fail are left out and workers read them from the file.
+
+  With `name` NULL the segment is anonymous (Linux memfd) and workers
+  share it through `s->fd`, inherited by fork or passed over a socket.
+
+  @param s      receives the loader's mapping
+  @param name   segment name, or NULL
+  @param path   container path, also opened by workers
+  @param budget bytes of decoded blocks to place in the segment
+  @param hot    block indexes, hottest first, or NULL
+  @param nhot   length of `hot`
+
+  @returns status  0: success, -1: error
+*/
+static inline int vp_shm_publish(vp_shm_t* s, const char* name, const char* path, size_t budget,
+                                 const uint64_t* hot, size_t nhot) {
+  memset(s, 0, sizeof(*s));
+  s->fd = -1;
+  vp_reader_t r;
+  if (vp_reader_open(&r, path)) return -1;
+  r.verify = VP_VERIFY_COLD;
+  size_t rw = vp_row_words(r.nsamples), plen = strlen(path) + 1;
+  uint64_t n = hot ? nhot : r.nblocks, data = 0, k;
+  for (k = 0; k < n; k++) {
+    uint64_t b = hot ? hot[k] : k;
+    if (b >= r.nblocks) continue;
+    uint64_t bytes = (uint64_t)r.blocks[b].nsites * (1 + rw) * sizeof(vpack64_t);
+    if (data + bytes > budget) break;
+    data += bytes;
+  }
+  n = k;  // blocks hot[0, n) fit the budget
+  vp_shm_hdr_t h = {VP_SHM_MAGIC, 0, 0, r.nsamples, 0, r.nblocks, 0, 0, 0, 0, 0};
+  h.path_off = sizeof(h);
+  h.index_off = (h.path_off + plen + 7) & ~7ULL;
+  h.slot_off = h.index_off + r.nblocks * sizeof(vp_block_ref_t);
+  h.data_off = h.slot_off + r.nblocks * sizeof(uint64_t);
+  h.size = h.data_off + data;
+  uint64_t* slot;
+  uint64_t off = h.data_off;
+  if (name) {
+    shm_unlink(name);
+    s->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  } else {
+#if defined(MFD_CLOEXEC)
+    s->fd = memfd_create("vpack", 0);
+#else
+    /* anonymous: a private name, unlinked as soon as it is open */
+    char tmp[48];
+    snprintf(tmp, sizeof(tmp), "/vpack-%ld-%p", (long)getpid(), (void*)s);
+    s->fd = shm_open(tmp, O_RDWR | O_CREAT | O_EXCL, 0600);
+    shm_unlink(tmp);
+#endif
+  }
+  if (s->fd < 0 || _vp_shm_size(s->fd, (size_t)h.size)) goto fail;
+  s->size = (size_t)h.size;
+  s->base = (uint8_t*)mmap(NULL, s->size, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
+  if (s->base == MAP_FAILED) { s->base = NULL; goto fail; }
+  s->writable = 1;
+  memcpy(s->base + h.path_off, path, plen);
+  memcpy(s->base + h.index_off, r.blocks, r.nblocks * sizeof(vp_block_ref_t));
+  slot = (uint64_t*)(s->base + h.slot_off);
+  memset(slot, 0, r.nblocks * sizeof(uint64_t));
+  for (k = 0; k < n; k++) {
+    uint64_t b = hot ? hot[k] : k;
+    const vp_mat_t* m;
+    if (b >= r.nblocks || slot[b] || vp_reader_read(&r, b, &m)) continue;
+    memcpy(s->base + off, m->sites, m->nsites * sizeof(vpack64_t));
+    memcpy(s->base + off + m->nsites * sizeof(vpack64_t), m->gts, m->nsites * rw * sizeof(vpack64_t));
+    slot[b] = off;
+    off += (uint64_t)m->nsites * (1 + rw) * sizeof(vpack64_t);
+    h.ncached++;
+  }
+  vp_reader_close(&r);
+  memcpy(s->base, &h, sizeof(h));
+  __atomic_store_n(&((vp_shm_hdr_t*)s->base)->ready, 1u, __ATOMIC_RELEASE);
+  return 0;
+fail:
+  vp_reader_close(&r);
+  vp_shm_close(s);
+  if (name) shm_unlink(name);
+  return -1;
+}
+
+/*
+  @brief
+  Map a published segment read-only from descriptor `fd`. The
+  descriptor is owned by `s` afterwards.
+
+  @returns status  0: success, -1: error or segment not ready
+*/
+static inline int vp_shm_attach_fd(vp_shm_t* s, int fd) {
+  memset(s, 0, sizeof(*s));
+  s->fd = fd;
+  struct stat st;
+  const vp_shm_hdr_t* h;
+  if (fd < 0 || fstat(fd, &st) || (size_t)st.st_size < sizeof(vp_shm_hdr_t)) goto fail;
+  s->size = (size_t)st.st_size;
+  s->base = (uint8_t*)mmap(NULL, s->size, PROT_READ, MAP_SHARED, fd, 0);
+  if (s->base == MAP_FAILED) { s->base = NULL; goto fail; }
+  h = vp_shm_hdr(s);
+  if (h->magic != VP_SHM_MAGIC || !__atomic_load_n(&h->ready, __ATOMIC_ACQUIRE) || h->size != s->size) goto fail;
+  return 0;
+fail:
+  vp_shm_close(s);
+  return -1;
+}
+
+/*
+  @brief
+  Map the published segment `name` read-only
+
+  @returns status  0: success, -1: error or segment not ready
+*/
+static inline int vp_shm_attach(vp_shm_t* s, const char* name) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+    return -1;
+  }
+  return vp_shm_attach_fd(s, fd);
+}
+
+/*
+  @brief
+  Open a reader on an attached segment. The index comes from the
+  segment, or from the file's footer when it has one, so opening is
+  O(1) in the container size. Blocks in the segment are returned as
+  views into it and take no cache memory. `shm` must stay attached
+  until the reader is closed.
+
+  @returns status  0: success, -1: error
+*/
+static inline int vp_reader_open_shm(vp_reader_t* r, const vp_shm_t* shm) {
+  const vp_shm_hdr_t* h = vp_shm_hdr(shm);
+  memset(r, 0, sizeof(*r));
+  for (int i = 0; i < VP_CACHE_SLOTS; i++) r->cache[i].block = UINT64_MAX;
+  const char* path = (const char*)(shm->base + h->path_off);
+  r->fp = fopen(path, "rb");
+  if (!r->fp) return -1;
+  uint32_t hdr[4];
+  if (fread(hdr, sizeof(hdr), 1, r->fp) != 1 || hdr[0] != VP_FILE_MAGIC || hdr[2] != h->nsamples) {
+    vp_reader_close(r);
+    return -1;
+  }
+  r->nsamples = h->nsamples;
+  r->shm = shm;
+  if ((hdr[3] & VP_FILE_FOOTER) && !_vp_reader_footer(r, path) && r->nblocks == h->nblocks) return 0;
+  _vp_reader_unmap(r);
+  r->blocks = (vp_block_ref_t*)(shm->base + h->index_off);
+  r->nblocks = h->nblocks;
+  return 0;
+}
+
+#endif /* VP_HAVE_MMAP */
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             IN-MEMORY STORE
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+  A packed store kept in memory, with one writer and any number of
+  lock-free readers.
+
+  The store's contents are a version: an immutable, sorted array of
+  immutable blocks. The writer never modifies a published version. It
+  builds a new one (sharing the unchanged blocks) and publishes it
+  with one atomic pointer store. The version it replaced, and any
+  block no longer referenced, is retired.
+
+  Reclamation is epoch based. Each reader owns a slot. To read, it
+  stores the current global epoch in the slot, then loads the current
+  version. Every publish advances the epoch. An object retired at
+  epoch `e` is freed once every active slot holds an epoch greater
+  than `e`: those readers started after the publish and cannot see it.
+  Readers never wait. A reader that stays inside a read section only
+  delays frees; it never blocks the writer.
+
+  A snapshot pins a version beyond a read section: "the cohort as of
+  Monday". Taking one is O(1), a reference count on the version.
+  Versions count references to their blocks, so a block is freed with
+  the last version, current, retired or snapshot, that holds it.
+  Ingestion carries on meanwhile and only the blocks it replaces are
+  copied.
+
+  Writer calls (append, seal, replace, add_samples, reclaim) must come
+  from one thread at a time. Reader and snapshot calls are safe from
+  any thread.
+*/
+#ifndef VP_STORE_READERS
+#define VP_STORE_READERS 64
+#endif
+
+typedef struct vp_store_ver
+{
+  uint64_t nblocks;
+  uint64_t nsites;
+  uint32_t nsamples;
+  const vp_mat_t** blocks;   // sorted by site, each immutable
+
+  uint64_t refs;             // 1 while current, plus one per snapshot
+  struct vp_store_ver* next; // released snapshots awaiting the writer
+} vp_store_ver_t;
+
+/* A block is allocated with its data and the number of versions holding it */
+typedef struct
+{
+  vp_mat_t m;
+  uint64_t refs;
+} _vp_store_block_t;
+
+typedef struct
+{
+  uint64_t epoch;            // 0: not reading
+  uint32_t used;             // slot claimed by a reader
+  uint8_t pad[52];           // one cache line per reader
+} vp_store_slot_t;
+
+typedef struct
+{
+  vp_store_ver_t* v;
+  uint64_t epoch;            // retired while this epoch was current
+} vp_store_retired_t;
+
+typedef struct
+{
+  vp_store_ver_t* cur;       // published version
+  uint64_t epoch;
+  vp_store_slot_t slots[VP_STORE_READERS];
+  vp_store_ver_t* orphans;   // released snapshots, pushed by any thread
+
+  /* writer state */
+  uint32_t nsamples;
+  uint32_t block_sites;
+  vp_mat_t pending;          // appended sites not yet published
+  vp_store_retired_t* retired;
+  size_t nretired;
+  size_t retired_cap;
+} vp_store_t;
+
+typedef struct
+{
+  vp_store_t* st;
+  uint32_t slot;
+} vp_store_reader_t;
+
+static inline size_t _vp_store_block_bytes(size_t nsites, uint32_t nsamples) {
+  return sizeof(_vp_store_block_t) + nsites * (1 + vp_row_words(nsamples)) * sizeof(vpack64_t);
+}
+
+static inline size_t _vp_store_ver_bytes(uint64_t nblocks) {
+  return sizeof(vp_store_ver_t) + nblocks * sizeof(vp_mat_t*);
+}
+
+/* A block and its data in one allocation */
+static inline vp_mat_t* _vp_store_block_new(size_t nsites, uint32_t nsamples) {
+  _vp_store_block_t* b = (_vp_store_block_t*)vp_malloc(VP_MEM_STORE, _vp_store_block_bytes(nsites, nsamples));
+  if (!b) return NULL;
+  b->refs = 0;
+  b->m.sites = (vpack64_t*)(b + 1);
+  b->m.gts = b->m.sites + nsites;
+  b->m.nsites = nsites;
+  b->m.nsamples = nsamples;
+  return &b->m;
+}
+
+static inline void _vp_store_block_free(const vp_mat_t* m) {
+  vp_free(VP_MEM_STORE, (void*)m, _vp_store_block_bytes(m->nsites, m->nsamples));
+}
+
+static inline vp_store_ver_t* _vp_store_ver_new(uint64_t nblocks, uint32_t nsamples) {
+  vp_store_ver_t* v = (vp_store_ver_t*)vp_malloc(VP_MEM_STORE, _vp_store_ver_bytes(nblocks));
+  if (!v) return NULL;
+  v->nblocks = nblocks;
+  v->nsites = 0;
+  v->nsamples = nsamples;
+  v->blocks = (const vp_mat_t**)(v + 1);
+  v->refs = 1;
+  v->next = NULL;
+  return v;
+}
+
+/* Free a version no one can reach, and the blocks only it held */
+static inline void _vp_store_ver_free(vp_store_ver_t* v) {
+  for (uint64_t i = 0; i < v->nblocks; i++)
+    if (!--((_vp_store_block_t*)v->blocks[i])->refs) _vp_store_block_free(v->blocks[i]);
+  vp_free(VP_MEM_STORE, v, _vp_store_ver_bytes(v->nblocks));
+}
+
+/* Room for `n` more retired objects, so a publish cannot fail halfway */
+static inline int _vp_store_retire_reserve(vp_store_t* st, size_t n) {
+  if (st->nretired + n <= st->retired_cap) return 0;
+  size_t cap = st->retired_cap ? st->retired_cap : 64;
+  while (cap < st->nretired + n) cap *= 2;
+  vp_store_retired_t* r = (vp_store_retired_t*)vp_realloc(VP_MEM_STORE, st->retired,
+                                                          st->retired_cap * sizeof(*r), cap * sizeof(*r));
+  if (!r) return -1;
+  st->retired = r;
+  st->retired_cap = cap;
+  return 0;
+}
+
+/* Push a chain of released versions, lock-free, from any thread */
+static inline void _vp_store_push_orphans(vp_store_t* st, vp_store_ver_t* first) {
+  vp_store_ver_t* last = first;
+  while (last->next) last = last->next;
+  vp_store_ver_t* head = _VP_SC_LOAD(st->orphans);
+  do last->next = head; while (!_VP_CAS(st->orphans, head, first));
+}
+
+/*
+  @brief
+  Free retired versions and blocks that no reader can still see,
+  including those of released snapshots
+
+  @returns number of versions still waiting for readers
+*/
+static inline size_t vp_store_reclaim(vp_store_t* st) {
+  vp_store_ver_t* o = (vp_store_ver_t*)_VP_XCHG(st->orphans, NULL);
+  size_t no = 0;
+  for (vp_store_ver_t* v = o; v; v = v->next) no++;
+  if (no && _vp_store_retire_reserve(st, no)) {
+    _vp_store_push_orphans(st, o);  // try again on the next reclaim
+  } else if (no) {
+    uint64_t e = _VP_SC_LOAD(st->epoch);
+    for (; o; o = o->next) st->retired[st->nretired++] = (vp_store_retired_t){o, e};
+    _VP_SC_STORE(st->epoch, e + 1);
+  }
+  uint64_t min = UINT64_MAX;
+  for (int i = 0; i < VP_STORE_READERS; i++) {
+    uint64_t e = _VP_SC_LOAD(st->slots[i].epoch);
+    if (e && e < min) min = e;
+  }
+  size_t n = 0;
+  for (size_t i = 0; i < st->nretired; i++) {
+    vp_store_retired_t* r = &st->retired[i];
+    if (r->epoch < min) _vp_store_ver_free(r->v);
+    else st->retired[n++] = *r;
+  }
+  st->nretired = n;
+  return n;
+}
+
+/*
+  Publish `v` and drop the previous version's current reference. The
+  previous version is retired unless a snapshot still pins it. On
+  failure nothing is published and the caller still owns `v`.
+*/
+static inline int _vp_store_publish(vp_store_t* st, vp_store_ver_t* v) {
+  if (_vp_store_retire_reserve(st, 1)) return VP_ENOMEM;
+  for (uint64_t i = 0; i < v->nblocks; i++) {
+    ((_vp_store_block_t*)v->blocks[i])->refs++;
+    v->nsites += v->blocks[i]->nsites;
+  }
+  vp_store_ver_t* prev = st->cur;
+  _VP_SC_STORE(st->cur, v);
+  uint64_t e = _VP_SC_LOAD(st->epoch);
+  if (!_VP_SC_SUB(prev->refs, 1)) st->retired[st->nretired++] = (vp_store_retired_t){prev, e};
+  _VP_SC_STORE(st->epoch, e + 1);
+  vp_store_reclaim(st);
+  return 0;
+}
+
+/*
+  @brief
+  Create an empty store. Appended sites become visible to readers in
+  blocks of `block_sites`, or earlier with `vp_store_seal`.
+
+  @returns status  0: success, -1: error
+*/
+static inline int vp_store_init(vp_store_t* st, uint32_t nsamples, uint32_t block_sites) {
+  memset(st, 0, sizeof(*st));
+  st->epoch = 1;
+  st->nsamples = nsamples;
+  st->block_sites = block_sites ? block_sites : 4096;
+  st->cur = _vp_store_ver_new(0, nsamples);
+  st->pending.nsamples = nsamples;
+  st->pending.sites = (vpack64_t*)vp_malloc(VP_MEM_STORE, st->block_sites * sizeof(vpack64_t));
+  st->pending.gts = (vpack64_t*)vp_malloc(VP_MEM_STORE, (size_t)st->block_sites * vp_row_words(nsamples) * sizeof(vpack64_t));
+  if (!st->cur || !st->pending.sites || !st->pending.gts) {
+    vp_free(VP_MEM_STORE, st->cur, _vp_store_ver_bytes(0));
+    vp_free(VP_MEM_STORE, st->pending.sites, st->block_sites * sizeof(vpack64_t));
+    vp_free(VP_MEM_STORE, st->pending.gts, (size_t)st->block_sites * vp_row_words(nsamples) * sizeof(vpack64_t));
+    memset(st, 0, sizeof(*st));
+    return -1;
+  }
+  return 0;
+}
+
+/*
+  @brief
+  Free the store. No reader may be inside a read section and every
+  snapshot must have been released.
+*/
+static inline void vp_store_free(vp_store_t* st) {
+  if (!st->cur) return;
+  for (vp_store_ver_t *o = st->orphans, *next; o; o = next) {
+    next = o->next;
+    _vp_store_ver_free(o);
+  }
+  _vp_store_ver_free(st->cur);
+  for (size_t i = 0; i < st->nretired; i++) _vp_store_ver_free(st->retired[i].v);
+  vp_free(VP_MEM_STORE, st->retired, st->retired_cap * sizeof(vp_store_retired_t));
+  vp_free(VP_MEM_STORE, st->pending.sites, st->block_sites * sizeof(vpack64_t));
+  vp_free(VP_MEM_STORE, st->pending.gts, (size_t)st->block_sites * vp_row_words(st->nsamples) * sizeof(vpack64_t));
+  memset(st, 0, sizeof(*st));
+}
+
+/*
+  @brief
+  Publish the pending sites as a new block
+
+  @returns status  0: success, VP_ENOMEM: out of memory or budget
+*/
+static inline int vp_store_seal(vp_store_t* st) {
+  vp_mat_t* p = &st->pending;
+  if (!p->nsites) return 0;
+  vp_store_ver_t* cur = st->cur;
+  vp_mat_t* b = _vp_store_block_new(p->nsites, p->nsamples);
+  vp_store_ver_t* v = _vp_store_ver_new(cur->nblocks + 1, cur->nsamples);
+  if (b && v) {
+    memcpy(b->sites, p->sites, p->nsites * sizeof(vpack64_t));
+    memcpy(b->gts, p->gts, p->nsites * vp_row_words(p->nsamples) * sizeof(vpack64_t));
+    memcpy(v->blocks, cur->blocks, cur->nblocks * sizeof(vp_mat_t*));
+    v->blocks[cur->nblocks] = b;
+    if (!_vp_store_publish(st, v)) {
+      p->nsites = 0;
+      return 0;
+    }
+  }
+  if (b) _vp_store_block_free(b);
+  vp_free(VP_MEM_STORE, v, _vp_store_ver_bytes(cur->nblocks + 1));
+  return VP_ENOMEM;
+}
+
+/*
+  @brief
+  Append a site and its genotype row. Sites must arrive in sorted
+  order; they become visible when their block is sealed.
+
+  @returns status  0: success, VP_ENOMEM: out of memory or budget
+*/
+static inline int vp_store_append(vp_store_t* st, vpack64_t site, const vpack64_t* row) {
+  vp_mat_t* p = &st->pending;
+  size_t rw = vp_row_words(p->nsamples);
+  p->sites[p->nsites] = site;
+  memcpy(p->gts + p->nsites * rw, row, rw * sizeof(vpack64_t));
+  if (++p->nsites < st->block_sites) return 0;
+  int rc = vp_store_seal(st);
+  if (rc) p->nsites--;
+  return rc;
+}
+
+/*
+  @brief
+  Publish a new version of block `i` with the contents of `m`, which
+  is copied. Readers see either the old block or the new one, and
+  snapshots keep the old one.
+
+  @returns status  0: success, -1: bad index, VP_ENOMEM: out of memory or budget
+*/
+static inline int vp_store_replace(vp_store_t* st, uint64_t i, const vp_mat_t* m) {
+  vp_store_ver_t* cur = st->cur;
+  if (i >= cur->nblocks || !m->nsites || m->nsamples != cur->nsamples) return -1;
+  vp_mat_t* b = _vp_store_block_new(m->nsites, m->nsamples);
+  vp_store_ver_t* v = _vp_store_ver_new(cur->nblocks, cur->nsamples);
+  if (b && v) {
+    memcpy(b->sites, m->sites, m->nsites * sizeof(vpack64_t));
+    memcpy(b->gts, m->gts, m->nsites * vp_row_words(m->nsamples) * sizeof(vpack64_t));
+    memcpy(v->blocks, cur->blocks, cur->nblocks * sizeof(vp_mat_t*));
+    v->blocks[i] = b;
+    if (!_vp_store_publish(st, v)) return 0;
+  }
+  if (b) _vp_store_block_free(b);
+  vp_free(VP_MEM_STORE, v, _vp_store_ver_bytes(cur->nblocks));
+  return VP_ENOMEM;
+}
+
+/*
+  @brief
+  Add `nnew` samples to every site. Pending sites are sealed first.
+  All blocks are rebuilt with the wider rows and published as one
+  version, so readers see either the old sample set or the new one.
+
+  @param st   store
+  @param nnew number of samples to add
+  @param rows for each published site in order, vp_row_words(nnew) words
+              holding the new samples' genotypes
+
+  @returns status  0: success, VP_ENOMEM: out of memory or budget
+*/
+static inline int vp_store_add_samples(vp_store_t* st, uint32_t nnew, const vpack64_t* rows) {
+  int rc = vp_store_seal(st);
+  if (rc || !nnew) return rc;
+  vp_store_ver_t* cur = st->cur;
+  uint32_t ns = cur->nsamples, nt = ns + nnew;
+  size_t rw = vp_row_words(ns), rn = vp_row_words(nnew), rt = vp_row_words(nt);
+  vp_store_ver_t* v = _vp_store_ver_new(cur->nblocks, nt);
+  uint8_t* codes = (uint8_t*)vp_malloc(VP_MEM_SCRATCH, 2 * ((size_t)nt + VP_GT_PER_WORD));
+  vpack64_t* pgts = (vpack64_t*)vp_malloc(VP_MEM_STORE, (size_t)st->block_sites * rt * sizeof(vpack64_t));
+  uint64_t nb = 0;
+  const vp_kernels_t* k = vp_cpu();
+  if (!v || !codes || !pgts) goto fail;
+  for (; nb < cur->nblocks; nb++) {
+    const vp_mat_t* o = cur->blocks[nb];
+    vp_mat_t* b = _vp_store_block_new(o->nsites, nt);
+    if (!b) goto fail;
+    memcpy(b->sites, o->sites, o->nsites * sizeof(vpack64_t));
+    for (size_t s = 0; s < o->nsites; s++, rows += rn) {
+      k->unpack(o->gts + s * rw, ns, codes);
+      k->unpack(rows, nnew, codes + 2 * (size_t)ns);
+      k->pack(codes, nt, b->gts + s * rt);
+    }
+    v->blocks[nb] = b;
+  }
+  if (_vp_store_publish(st, v)) goto fail;
+  vp_free(VP_MEM_STORE, st->pending.gts, (size_t)st->block_sites * rw * sizeof(vpack64_t));
+  st->pending.gts = pgts;
+  st->pending.nsamples = st->nsamples = nt;
+  vp_free(VP_MEM_SCRATCH, codes, 2 * ((size_t)nt + VP_GT_PER_WORD));
+  return 0;
+fail:
+  while (nb--) _vp_store_block_free(v->blocks[nb]);
+  vp_free(VP_MEM_STORE, v, _vp_store_ver_bytes(cur->nblocks));
+  vp_free(VP_MEM_SCRATCH, codes, 2 * ((size_t)nt + VP_GT_PER_WORD));
+  vp_free(VP_MEM_STORE, pgts, (size_t)st->block_sites * rt * sizeof(vpack64_t));
+  return VP_ENOMEM;
+}
+
+/*
+  @brief
+  Register a reader. Each thread reading concurrently needs its own.
+
+  @returns status  0: success, -1: all VP_STORE_READERS slots in use
+*/
+static inline int vp_store_reader_open(vp_store_reader_t* rd, vp_store_t* st) {
+  for (uint32_t i = 0; i < VP_STORE_READERS; i++) {
+    uint32_t free_ = 0;
+    if (_VP_CAS(st->slots[i].used, free_, 1u)) {
+      rd->st = st;
+      rd->slot = i;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static inline void vp_store_reader_close(vp_store_reader_t* rd) {
+  _VP_SC_STORE(rd->st->slots[rd->slot].epoch, 0);
+  _VP_SC_STORE(rd->st->slots[rd->slot].used, 0u);
+}
+
+/*
+  @brief
+  Enter a read section. The returned version and its blocks stay
+  valid until `vp_store_read_end`, however much the writer publishes
+  meanwhile. Never blocks.
+*/
+static inline const vp_store_ver_t* vp_store_read_begin(vp_store_reader_t* rd) {
+  vp_store_t* st = rd->st;
+  /* announce first: a reclaim that misses the announcement ran
+     before it, so the version loaded below is already the new one */
+  _VP_SC_STORE(st->slots[rd->slot].epoch, _VP_SC_LOAD(st->epoch));
+  return _VP_SC_LOAD(st->cur);
+}
+
+static inline void vp_store_read_end(vp_store_reader_t* rd) {
+  _VP_SC_STORE(rd->st->slots[rd->slot].epoch, 0);
+}
+
+/*
+  @brief
+  Index of the first block of `v` whose last site is >= `key`, or
+  `v->nblocks` if every block ends before `key`
+*/
+static inline uint64_t vp_store_find(const vp_store_ver_t* v, vpack64_t key) {
+  uint64_t lo = 0, hi = v->nblocks;
+  while (lo < hi) {
+    uint64_t mid = (lo + hi) >> 1;
+    const vp_mat_t* b = v->blocks[mid];
+    if (b->sites[b->nsites - 1] < key) lo = mid + 1; else hi = mid;
+  }
+  return lo;
+}
+
+/*
+  @brief
+  Pin the current version as an immutable snapshot. O(1): no block
+  is copied. The snapshot stays valid, and unchanged by later writes,
+  until `vp_store_snapshot_release`. Never blocks. May be called
+  inside a read section on the same reader, which stays protected.
+
+  @returns the snapshot
+*/
+static inline const vp_store_ver_t* vp_store_snapshot(vp_store_reader_t* rd) {
+  vp_store_t* st = rd->st;
+  /* an open read section already announces an epoch no later than
+     now, which protects the current version too; keep it */
+  int outer = _VP_SC_LOAD(st->slots[rd->slot].epoch) != 0;
+  vp_store_ver_t* v;
+  for (;;) {
+    v = (vp_store_ver_t*)(outer ? _VP_SC_LOAD(st->cur) : vp_store_read_begin(rd));
+    uint64_t n = _VP_SC_LOAD(v->refs);
+    /* 0: superseded and retired between the load and now; retry */
+    while (n && !_VP_CAS(v->refs, n, n + 1));
+    if (!outer) vp_store_read_end(rd);
+    if (n) return v;
+  }
+}
+
+/*
+  @brief
+  Release a snapshot. The writer frees its blocks on a later publish
+  or `vp_store_reclaim` unless other versions still share them.
+*/
+static inline void vp_store_snapshot_release(vp_store_t* st, const vp_store_ver_t* snap) {
+  vp_store_ver_t* v = (vp_store_ver_t*)snap;
+  if (_VP_SC_SUB(v->refs, 1)) return;
+  v->next = NULL;
+  _vp_store_push_orphans(st, v);
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             DEDUPLICATION
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*
+  Streaming deduplication of sorted `snvpack64` words. Words with the
+  same locus and sample, i.e. equal in all bits above the GT field,
+  form a group that becomes one word:
+
+    VP_DEDUP_FIRST     the first word of the group
+    VP_DEDUP_QUALITY   the word with the highest quality, first on ties
+    VP_DEDUP_CONFLICT  the first word, with GT ./. if the group disagrees
+
+  Unphased genotypes are canonicalized on the way through, alleles in
+  ascending code order (0, 1, .), so 1/0 becomes 0/1 and ./1 becomes
+  1/. before groups are compared. Phased genotypes keep their order.
+
+  Runs without duplicates are found by the `dup` kernel and moved in
+  bulk; only words at group boundaries take the per-word path. The
+  stage works in place on the caller's batch and holds back the last
+  group, which may continue in the next batch, until
+  `vp_dedup_finish`.
+
+    vp_dedup_t d;
+    vp_dedup_init(&d, VP_DEDUP_CONFLICT);
+    while ((n = read_batch(buf)))
+      emit(buf, vp_dedup(&d, buf, NULL, n));
+    emit(buf, vp_dedup_finish(&d, buf, NULL));
+*/
+enum {
+  VP_DEDUP_NONE,
+  VP_DEDUP_FIRST,
+  VP_DEDUP_QUALITY,
+  VP_DEDUP_CONFLICT
+};
+
+#define VP_GT9_MASK     0x1ffULL
+#define VP_GT9_MISSING  0x9aULL   // ./.
+
+typedef struct
+{
+  int policy;                // VP_DEDUP_*
+  int held;                  // `last` is a group not yet emitted
+  vpack64_t last;
+  uint16_t lastq;
+  uint64_t ndup;             // words folded into an earlier word
+  uint64_t nconflict;        // groups set to ./.
+  uint64_t ncanon;           // genotypes reordered
+} vp_dedup_t;
+
+static inline void vp_dedup_init(vp_dedup_t* d, int policy) {
+  memset(d, 0, sizeof(*d));
+  d->policy = policy;
+}
+
+/* Unphased alleles in ascending code order */
+static inline vpack64_t vp_snv_canon(vpack64_t v) {
+  uint64_t a = (v >> 6) & 7, b = v & 7;
+  return ((v >> 3) & 7) == 3 && a > b ? (v & ~0x1c7ULL) | (b << 6) | a : v;
+}
+
+/* Fold one word into the held group, or emit the group and hold the word */
+static inline void _vp_dedup_word(vp_dedup_t* d, vpack64_t* v, uint16_t* q, size_t* k, vpack64_t x, uint16_t qx) {
+  vpack64_t c = vp_snv_canon(x);
+  d->ncanon += c != x;
+  if (d->held && !((c ^ d->last) & _VP_KEY_BITS)) {
+    d->ndup++;
+    if (d->policy == VP_DEDUP_QUALITY && qx > d->lastq) {
+      d->last = c;
+      d->lastq = qx;
+    } else if (d->policy == VP_DEDUP_CONFLICT && (c ^ d->last) & VP_GT9_MASK &&
+               (d->last & VP_GT9_MASK) != VP_GT9_MISSING) {
+      d->last = (d->last & ~VP_GT9_MASK) | VP_GT9_MISSING;
+      d->nconflict++;
+    }
+    return;
+  }
+  if (d->held) {
+    v[*k] = d->last;
+    if (q) q[*k] = d->lastq;
+    (*k)++;
+  }
+  d->held = 1;
+  d->last = c;
+  d->lastq = qx;
+}
+
+/*
+  @brief
+  Deduplicate and canonicalize a batch of sorted `snvpack64` words in
+  place. Batches must continue one another in sort order.
+
+  @param d stage
+  @param v words, overwritten by the output
+  @param q quality per word, permuted alongside `v`; NULL: none, and
+           VP_DEDUP_QUALITY keeps the first word
+  @param n words in the batch
+
+  @returns number of words stored at the front of `v`
+*/
+static inline size_t vp_dedup(vp_dedup_t* d, vpack64_t* v, uint16_t* q, size_t n) {
+  vp_dup_fn dup = vp_cpu()->dup;
+  size_t i = 0, k = 0;
+  /*
+    The held group of the previous batch lets the output run one word
+    ahead of the input, so each span is scanned and its tail saved
+    before anything is stored.
+  */
+  while (i < n) {
+    size_t t = dup(v + i, n - i);
+    vpack64_t tail = v[i + t - 1];
+    uint16_t tailq = q ? q[i + t - 1] : 0;
+    _vp_dedup_word(d, v, q, &k, v[i], q ? q[i] : 0);
+    /* v[i + 1, i + t) each start a group: emit the held one, move them down */
+    if (t > 1) {
+      memmove(v + k + 1, v + i + 1, (t - 2) * sizeof(vpack64_t));
+      if (q) memmove(q + k + 1, q + i + 1, (t - 2) * sizeof(uint16_t));
+      v[k] = d->last;
+      if (q) q[k] = d->lastq;
+      for (size_t j = k + 1; j < k + t - 1; j++) {
+        vpack64_t c = vp_snv_canon(v[j]);
+        d->ncanon += c != v[j];
+        v[j] = c;
+      }
+      k += t - 1;
+      d->last = vp_snv_canon(tail);
+      d->ncanon += d->last != tail;
+      d->lastq = tailq;
+    }
+    i += t;
+  }
+  return k;
+}
+
+/*
+  @brief
+  Emit the held group at the end of the stream
+
+  @returns number of words stored in `v[0]` (and `q[0]`), 0 or 1
+*/
+static inline size_t vp_dedup_finish(vp_dedup_t* d, vpack64_t* v, uint16_t* q) {
+  if (!d->held) return 0;
+  v[0] = d->last;
+  if (q) q[0] = d->lastq;
+  d->held = 0;
+  return 1;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             RADIX SORT
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*
+  LSD radix sort of `vpack64_loc` words into genomic order. Digits are
+  VP_SORT_BITS wide, so the 37-bit locus takes at most four scatter
+  passes. One read pass histograms every digit, and a digit on which
+  all keys agree, e.g. the chromosome of a single-chromosome input,
+  costs no pass.
+
+  In key-value mode the genotype rows move with their sites. The input
+  index of each word rides in the bits above the locus while the keys
+  are sorted, so sorting moves 8 bytes per site. The rows are then
+  gathered into a buffer and copied back, when one of at most
+  VP_SORT_GATHER_MAX bytes fits the memory budget. Otherwise they are
+  permuted in place by following cycles, with one row of scratch.
+  The gather's loads are independent and overlap; each step of a
+  cycle waits for the previous one, so it runs at memory latency.
+
+  With -DVPACK_THREADS, `vp_sort_loc_parallel` splits every pass over
+  threads: each thread counts its slice, and the slices scatter to
+  disjoint ranges.
+
+  Known shortfalls. Against an inlined introsort of the same words,
+  on one thread, keys alone sort 3.7x faster at 140M sites, short of
+  the 5-10x a radix sort can reach, and key-value mode only 2.0-2.2x
+  faster. Key-value mode takes at most VP_SORT_MAX_ROWS (2^27) sites.
+  The sort is not in place: it needs a scratch buffer of n words,
+  plus a copy of the rows for the gather when one fits.
+*/
+#ifndef VP_SORT_BITS
+#define VP_SORT_BITS 11
+#endif
+#define VP_SORT_BUCKETS (1u << VP_SORT_BITS)
+#define VP_SORT_MAX_ROWS (1ULL << 27)  // key-value mode: index bits above the locus
+#ifndef VP_SORT_GATHER_MAX
+#define VP_SORT_GATHER_MAX (1ULL << 30)  // bytes of rows gathered out of place
+#endif
+
+static inline uint32_t _vp_sort_digit(vpack64_t x, uint64_t kmask, uint32_t p) {
+  return (uint32_t)(((x & kmask) >> (p * VP_SORT_BITS)) & (VP_SORT_BUCKETS - 1));
+}
+
+/* Count digits [0, nd) of v[lo, hi) into cnt[p * VP_SORT_BUCKETS + d] */
+static inline void _vp_sort_hist(const vpack64_t* v, size_t lo, size_t hi, uint64_t kmask, uint32_t p0, uint32_t nd,
+                                 size_t* cnt) {
+  for (size_t i = lo; i < hi; i++)
+    for (uint32_t p = 0; p < nd; p++) cnt[p * VP_SORT_BUCKETS + _vp_sort_digit(v[i], kmask, p0 + p)]++;
+}
+
+/* Stable scatter of src[lo, hi) by digit p; `off` holds the next slot per bucket */
+static inline void _vp_sort_scatter(const vpack64_t* src, vpack64_t* dst, size_t lo, size_t hi, uint64_t kmask,
+                                    uint32_t p, size_t* off) {
+  for (size_t i = lo; i < hi; i++) dst[off[_vp_sort_digit(src[i], kmask, p)]++] = src[i];
+}
+
+/* Stable insertion sort, for short inputs */
+static inline void _vp_sort_small(vpack64_t* v, size_t n, uint64_t kmask) {
+  for (size_t i = 1; i < n; i++) {
+    vpack64_t x = v[i];
+    size_t j = i;
+    for (; j > 0 && (v[j - 1] & kmask) > (x & kmask); j--) v[j] = v[j - 1];
+    v[j] = x;
+  }
+}
+
+#if defined(VPACK_THREADS)
+typedef struct
+{
+  const vpack64_t* src;
+  vpack64_t* dst;
+  size_t lo, hi;
+  uint64_t kmask;
+  uint32_t p, nd;            // digit, digits to count
+  int scatter;
+  size_t* cnt;               // counts, then next slots
+} _vp_sort_job_t;
+
+static inline void* _vp_sort_worker(void* arg) {
+  _vp_sort_job_t* j = (_vp_sort_job_t*)arg;
+  if (j->scatter) _vp_sort_scatter(j->src, j->dst, j->lo, j->hi, j->kmask, j->p, j->cnt);
+  else _vp_sort_hist(j->src, j->lo, j->hi, j->kmask, j->p, j->nd, j->cnt);
+  return NULL;
+}
+
+/* Run jobs on threads, the first on the caller; a job without a thread runs inline */
+static inline void _vp_sort_jobs(_vp_sort_job_t* jobs, pthread_t* th, uint32_t nt) {
+  uint32_t started = 1;
+  for (; started < nt; started++)
+    if (pthread_create(&th[started], NULL, _vp_sort_worker, &jobs[started])) break;
+  for (uint32_t t = started; t < nt; t++) _vp_sort_worker(&jobs[t]);
+  _vp_sort_worker(&jobs[0]);
+  for (uint32_t t = 1; t < started; t++) pthread_join(th[t], NULL);
+}
+#endif
+
+/*
+  Sort v[0, n) by the bits in `kmask`, stably, using `tmp` of n words.
+  Each of `nt` threads sorts a slice of every pass.
+*/
+static inline int _vp_radix_sort(vpack64_t* v, vpack64_t* tmp, size_t n, uint64_t kmask, uint32_t nt) {
+  uint32_t nd = (uint32_t)((64 - vp_clz64(kmask) + VP_SORT_BITS - 1) / VP_SORT_BITS);
+  /* totals per digit, then per-slice counts of the current digit */
+  size_t hb = ((size_t)nd + nt) * VP_SORT_BUCKETS * sizeof(size_t);
+  size_t* cnt = (size_t*)vp_calloc(VP_MEM_SCRATCH, 1, hb);
+  if (!cnt) return VP_ENOMEM;
+#if defined(VPACK_THREADS)
+  _vp_sort_job_t* jobs = (_vp_sort_job_t*)vp_calloc(VP_MEM_SCRATCH, nt, sizeof(_vp_sort_job_t));
+  pthread_t* th = (pthread_t*)vp_malloc(VP_MEM_SCRATCH, nt * sizeof(pthread_t));
+  if (!jobs || !th) {
+    vp_free(VP_MEM_SCRATCH, jobs, nt * sizeof(_vp_sort_job_t));
+    vp_free(VP_MEM_SCRATCH, th, nt * sizeof(pthread_t));
+    vp_free(VP_MEM_SCRATCH, cnt, hb);
+    return VP_ENOMEM;
+  }
+  for (uint32_t t = 0; t < nt; t++)
+    jobs[t] = (_vp_sort_job_t){v, tmp, n * t / nt, n * (t + 1) / nt, kmask, 0, nd, 0, NULL};
+  if (nt > 1) {
+    /* all digits per slice; slices reuse the totals' layout, then sum */
+    size_t* part = (size_t*)vp_calloc(VP_MEM_SCRATCH, (size_t)nt * nd * VP_SORT_BUCKETS, sizeof(size_t));
+    if (!part) {
+      vp_free(VP_MEM_SCRATCH, jobs, nt * sizeof(_vp_sort_job_t));
+      vp_free(VP_MEM_SCRATCH, th, nt * sizeof(pthread_t));
+      vp_free(VP_MEM_SCRATCH, cnt, hb);
+      return VP_ENOMEM;
+    }
+    for (uint32_t t = 0; t < nt; t++) jobs[t].cnt = part + (size_t)t * nd * VP_SORT_BUCKETS;
+    _vp_sort_jobs(jobs, th, nt);
+    for (size_t i = 0; i < (size_t)nt * nd * VP_SORT_BUCKETS; i++) cnt[i % ((size_t)nd * VP_SORT_BUCKETS)] += part[i];
+    vp_free(VP_MEM_SCRATCH, part, (size_t)nt * nd * VP_SORT_BUCKETS * sizeof(size_t));
+    for (uint32_t t = 0; t < nt; t++) jobs[t].cnt = cnt + ((size_t)nd + t) * VP_SORT_BUCKETS;
+  } else
+#endif
+    _vp_sort_hist(v, 0, n, kmask, 0, nd, cnt);
+  vpack64_t *src = v, *dst = tmp;
+  for (uint32_t p = 0; p < nd; p++) {
+    const size_t* c = cnt + (size_t)p * VP_SORT_BUCKETS;
+    if (c[_vp_sort_digit(src[0], kmask, p)] == n) continue;  // one bucket: nothing moves
+    size_t* off = cnt + (size_t)nd * VP_SORT_BUCKETS;
+#if defined(VPACK_THREADS)
+    if (nt > 1) {
+      /* per-slice counts of this digit, then slots in (bucket, slice) order */
+      memset(off, 0, (size_t)nt * VP_SORT_BUCKETS * sizeof(size_t));
+      for (uint32_t t = 0; t < nt; t++) {
+        jobs[t].src = src;
+        jobs[t].dst = dst;
+        jobs[t].p = p;
+        jobs[t].nd = 1;
+        jobs[t].scatter = 0;
+      }
+      _vp_sort_jobs(jobs, th, nt);
+      size_t at = 0;
+      for (uint32_t d = 0; d < VP_SORT_BUCKETS; d++)
+        for (uint32_t t = 0; t < nt; t++) {
+          size_t k = jobs[t].cnt[d];
+          jobs[t].cnt[d] = at;
+          at += k;
+        }
+      for (uint32_t t = 0; t < nt; t++) jobs[t].scatter = 1;
+      _vp_sort_jobs(jobs, th, nt);
+    } else
+#endif
+    {
+      size_t at = 0;
+      for (uint32_t d = 0; d < VP_SORT_BUCKETS; d++) {
+        off[d] = at;
+        at += c[d];
+      }
+      _vp_sort_scatter(src, dst, 0, n, kmask, p, off);
+    }
+    vpack64_t* x = src;
+    src = dst;
+    dst = x;
+  }
+  if (src != v) memcpy(v, src, n * sizeof(vpack64_t));
+#if defined(VPACK_THREADS)
+  vp_free(VP_MEM_SCRATCH, jobs, nt * sizeof(_vp_sort_job_t));
+  vp_free(VP_MEM_SCRATCH, th, nt * sizeof(pthread_t));
+#endif
+  vp_free(VP_MEM_SCRATCH, cnt, hb);
+  return 0;
+}
+
+/* Move row perm[i] to row i for all i, following cycles; perm is consumed */
+static inline void _vp_permute_rows(vpack64_t* rows, uint32_t rw, vpack64_t* perm, size_t n, vpack64_t* tmp) {
+  size_t rb = (size_t)rw * sizeof(vpack64_t);
+  for (size_t i = 0; i < n; i++) {
+    if (perm[i] == i) continue;
+    memcpy(tmp, rows + i * rw, rb);
+    size_t j = i;
+    for (;;) {
+      size_t k = (size_t)perm[j];
+      perm[j] = j;
+      if (k == i) break;
+      memcpy(rows + j * rw, rows + k * rw, rb);
+      j = k;
+    }
+    memcpy(rows + j * rw, tmp, rb);
+  }
+}
+
+/* Gather row perm[i] into buf row i for all i, then copy back */
+static inline void _vp_gather_rows(vpack64_t* rows, uint32_t rw, const vpack64_t* perm, size_t n, vpack64_t* buf) {
+  if (rw == 1) {
+    for (size_t i = 0; i < n; i++) buf[i] = rows[perm[i]];
+  } else {
+    for (size_t i = 0; i < n; i++) memcpy(buf + i * rw, rows + perm[i] * rw, rw * sizeof(vpack64_t));
+  }
+  memcpy(rows, buf, n * rw * sizeof(vpack64_t));
+}
+
+static inline int _vp_sort_loc(vpack64_t* v, vpack64_t* rows, uint32_t nsamples, size_t n, uint32_t nt) {
+  if (n < 2) return 0;
+  if (rows && n > VP_SORT_MAX_ROWS) return -1;
+  uint32_t rw = vp_row_words(nsamples);
+  size_t rb = (rw ? rw : 1) * sizeof(vpack64_t);
+  /*
+    Buffers are allocated up front, and the sort's own counters are
+    allocated before it moves a word. The bits above the locus wait in
+    `tmp` while the index rides there, so a failure leaves the input
+    as it was.
+  */
+  vpack64_t* tmp = n > 64 || rows ? (vpack64_t*)vp_malloc(VP_MEM_SCRATCH, n * sizeof(vpack64_t)) : NULL;
+  vpack64_t* row = rows ? (vpack64_t*)vp_malloc(VP_MEM_SCRATCH, rb) : NULL;
+  int rc = (n > 64 || rows) && !tmp ? VP_ENOMEM : rows && !row ? VP_ENOMEM : 0;
+  int tagged = !rc && rows;
+  if (tagged)
+    for (size_t i = 0; i < n; i++) {
+      tmp[i] = v[i] & ~VMASK_37;
+      v[i] = (v[i] & VMASK_37) | ((uint64_t)i << 37);
+    }
+  if (!rc) rc = n > 64 ? _vp_radix_sort(v, tmp, n, VMASK_37, nt) : (_vp_sort_small(v, n, VMASK_37), 0);
+  if (rc && tagged)
+    for (size_t i = 0; i < n; i++) v[i] = (v[i] & VMASK_37) | tmp[i];
+  if (!rc && rows) {
+    for (size_t i = 0; i < n; i++) tmp[i] = v[i] >> 37;
+    size_t gb = n * rw * sizeof(vpack64_t);
+    vpack64_t* buf = gb <= VP_SORT_GATHER_MAX ? (vpack64_t*)vp_malloc(VP_MEM_SCRATCH, gb) : NULL;
+    if (buf) _vp_gather_rows(rows, rw, tmp, n, buf);
+    else _vp_permute_rows(rows, rw, tmp, n, row);
+    vp_free(VP_MEM_SCRATCH, buf, gb);
+    for (size_t i = 0; i < n; i++) v[i] &= VMASK_37;
+  }
+  vp_free(VP_MEM_SCRATCH, tmp, n * sizeof(vpack64_t));
+  vp_free(VP_MEM_SCRATCH, row, rb);
+  return rc;
+}
+
+/*
+  @brief
+  Sort `vpack64_loc` words into genomic order, stably. With `rows`,
+  the n rows of vp_row_words(nsamples) words move with their sites.
+  Bits above the 37-bit locus are ignored, and cleared in key-value
+  mode.
+
+  @param v        sites
+  @param rows     genotype rows, one per site, or NULL
+  @param nsamples row width
+  @param n        sites, at most VP_SORT_MAX_ROWS with rows
+
+  @returns status  0: success, -1: too many sites, VP_ENOMEM: out of memory
+*/
+static inline int vp_sort_loc(vpack64_t* v, vpack64_t* rows, uint32_t nsamples, size_t n) {
+  return _vp_sort_loc(v, rows, nsamples, n, 1);
+}
+
+#if defined(VPACK_THREADS)
+/*
+  @brief
+  `vp_sort_loc` with up to `nthreads` threads, each handling a slice
+  of at least 64k sites. The row permutation runs on the caller.
+*/
+static inline int vp_sort_loc_parallel(vpack64_t* v, vpack64_t* rows, uint32_t nsamples, size_t n,
+                                       uint32_t nthreads) {
+  size_t nt = n >> 16;
+  if (nt > nthreads) nt = nthreads;
+  return _vp_sort_loc(v, rows, nsamples, n, nt ? (uint32_t)nt : 1);
+}
+#endif
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             K-WAY MERGE
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+  Merge of sorted `snvpack64` runs, typically one file per sample,
+  into a multi-sample container.
+
+  A run is a file of native-endian `snvpack64` words sorted by locus.
+  Runs are memory mapped and read sequentially. The next window of
+  each run is requested ahead of use (posix_madvise WILLNEED) and
+  windows already merged are dropped, so the page cache holds about
+  two windows per run. Without mmap, runs are read through a buffer of
+  the same size.
+
+  A loser tree picks the smallest word among k runs in log2(k)
+  comparisons. Words are ordered by locus, then by sample ID, so all
+  samples of a site come out together. When there are more runs than
+  `fan_in`, groups of `fan_in` runs are first merged into intermediate
+  runs in `tmpdir`, and so on until one pass remains. Only `fan_in`
+  runs are open at a time, which keeps file descriptors, mappings and
+  buffer memory bounded. The fan-in used is the caller's, clamped to
+  the descriptor limit and to what the memory budget can hold
+  (`vp_merge_fan_in`). The resident windows of every open run, mapped
+  or buffered, are charged to VP_MEM_SCRATCH.
+*/
+#ifndef VP_MERGE_WINDOW
+#define VP_MERGE_WINDOW (1u << 20)  // bytes per run window
+#endif
+
+/* Merge order of a `snvpack64` word: locus, then sample ID */
+static inline uint64_t vp_merge_key(vpack64_t v) {
+  return (((v >> 9) & VMASK_37) << 17) | (v >> 46);
+}
+
+typedef struct
+{
+  const vpack64_t* p;        // next word
+  const vpack64_t* end;      // end of the current window
+  const vpack64_t* base;     // mapping, or buffer
+  size_t n;                  // words in the file (mapped) or buffer capacity
+  size_t win;                // words per window
+  size_t charged;            // bytes of resident windows charged to VP_MEM_SCRATCH (mapped)
+  FILE* fp;                  // fallback reader
+  uint64_t hi;               // stop at locus >= hi
+} vp_run_t;
+
+static inline void vp_run_close(vp_run_t* r) {
+#if defined(VP_HAVE_MMAP)
+  if (!r->fp && r->base) munmap((void*)r->base, r->n * sizeof(vpack64_t));
+#endif
+  if (r->charged) vp_mem_release(VP_MEM_SCRATCH, r->charged);
+  if (r->fp) {
+    fclose(r->fp);
+    vp_free(VP_MEM_SCRATCH, (void*)r->base, r->n * sizeof(vpack64_t));
+  }
+  memset(r, 0, sizeof(*r));
+}
+
+#if defined(VP_HAVE_MMAP) && defined(POSIX_MADV_WILLNEED)
+/* Advise on the pages of [a, b); `inner` keeps partial pages out */
+static inline void _vp_advise(const void* a, const void* b, int inner, int advice) {
+  uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE), x = (uintptr_t)a, y = (uintptr_t)b;
+  x = inner ? (x + page - 1) / page * page : x / page * page;
+  y = inner ? y / page * page : (y + page - 1) / page * page;
+  if (x < y) posix_madvise((void*)x, y - x, advice);
+}
+#endif
+
+/* Next window: read ahead the one after it, drop the one before */
+static inline int _vp_run_fill(vp_run_t* r) {
+  if (r->fp) {
+    size_t got = fread((void*)r->base, sizeof(vpack64_t), r->n, r->fp);
+    r->p = r->base;
+    r->end = r->base + got;
+    return got ? 0 : -1;
+  }
+  size_t at = (size_t)(r->end - r->base);
+  if (at >= r->n) return -1;
+  size_t len = r->n - at < r->win ? r->n - at : r->win;
+  r->p = r->base + at;
+  r->end = r->p + len;
+#if defined(VP_HAVE_MMAP) && defined(POSIX_MADV_WILLNEED)
+  size_t ahead = r->n - (at + len) < r->win ? r->n - (at + len) : r->win;
+  if (ahead) _vp_advise(r->end, r->end + ahead, 0, POSIX_MADV_WILLNEED);
+  if (at) _vp_advise(r->base + (at > r->win ? at - r->win : 0), r->p, 1, POSIX_MADV_DONTNEED);
+#endif
+  return 0;
+}
+
+/*
+  @brief
+  Open a run positioned at the first word with locus >= `lo`; words
+  with locus >= `hi` (0: no limit) end the run
+
+  @param r   run
+  @param path file of sorted `snvpack64` words
+  @param lo  first locus, a `vpack64_loc` word
+  @param hi  end locus, exclusive, 0 for none
+  @param window bytes per read-ahead window, 0 for VP_MERGE_WINDOW
+
+  @returns status  0: success, -1: error
+*/
+static inline int vp_run_open(vp_run_t* r, const char* path, vpack64_t lo, vpack64_t hi, size_t window) {
+  memset(r, 0, sizeof(*r));
+  r->win = (window ? window : VP_MERGE_WINDOW) / sizeof(vpack64_t);
+  if (!r->win) r->win = 1;
+  r->hi = hi ? hi : UINT64_MAX;
+#if defined(VP_HAVE_MMAP)
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return -1;
+  off_t len = lseek(fd, 0, SEEK_END);
+  if (len < 0) {
+    close(fd);
+    return -1;
+  }
+  r->n = (size_t)len / sizeof(vpack64_t);
+  /* the page cache holds about two windows of a run; charge them */
+  size_t charge = (r->n < 2 * r->win ? r->n : 2 * r->win) * sizeof(vpack64_t);
+  if (charge && vp_mem_reserve(VP_MEM_SCRATCH, charge)) {
+    close(fd);
+    return -1;
+  }
+  r->charged = charge;
+  if (r->n) {
+    void* map = mmap(NULL, r->n * sizeof(vpack64_t), PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+      close(fd);
+      vp_run_close(r);
+      return -1;
+    }
+    r->base = (const vpack64_t*)map;
+  }
+  close(fd);
+  /* binary search for the start, then read ahead from there */
+  size_t a = 0, b = r->n;
+  while (a < b) {
+    size_t mid = (a + b) >> 1;
+    if (((r->base[mid] >> 9) & VMASK_37) < lo) a = mid + 1; else b = mid;
+  }
+  r->end = r->base + a;
+  r->p = r->end;
+  _vp_run_fill(r);
+#else
+  r->fp = fopen(path, "rb");
+  r->n = r->win;
+  r->base = (const vpack64_t*)vp_malloc(VP_MEM_SCRATCH, r->n * sizeof(vpack64_t));
+  if (!r->fp || !r->base) {
+    if (!r->fp) vp_free(VP_MEM_SCRATCH, (void*)r->base, r->n * sizeof(vpack64_t));
+    vp_run_close(r);
+    return -1;
+  }
+  r->p = r->end = r->base;
+  while ((r->p < r->end || !_vp_run_fill(r)) && ((*r->p >> 9) & VMASK_37) < lo) r->p++;
+#endif
+  return 0;
+}
+
+/*
+  @brief
+  Next word of a run
+
+  @returns 1: word stored in `v`, 0: end of run or range
+*/
+static inline int vp_run_next(vp_run_t* r, vpack64_t* v) {
+  if (r->p == r->end && _vp_run_fill(r)) return 0;
+  if (((*r->p >> 9) & VMASK_37) >= r->hi) {
+    r->p = r->end;
+    return 0;
+  }
+  *v = *r->p++;
+  return 1;
+}
+
+/*
+  @brief
+  Loser tree over k runs. `tree[0]` is the run holding the smallest
+  key; `tree[1..k-1]` hold the loser of each internal match.
+*/
+typedef struct
+{
+  uint32_t k;
+  vp_run_t* runs;
+  uint64_t* keys;            // current key per run, UINT64_MAX: exhausted
+  vpack64_t* words;          // current word per run
+  uint32_t* tree;
+  vp_dedup_t* dedup;         // stage applied by the drains, NULL: none
+  vp_cms_t* cms;             // carrier counts of the drained words, NULL: none
+} vp_merge_t;
+
+/* Run a beats run b: smaller key, then lower index. Index k is -inf. */
+static inline int _vp_merge_beats(const vp_merge_t* m, uint32_t a, uint32_t b) {
+  if (a == m->k || b == m->k) return a == m->k;
+  return m->keys[a] < m->keys[b] || (m->keys[a] == m->keys[b] && a < b);
+}
+
+/* Replay the matches from leaf `s` to the root */
+static inline void _vp_merge_adjust(vp_merge_t* m, uint32_t s) {
+  for (uint32_t t = (s + m->k) >> 1; t > 0; t >>= 1)
+    if (_vp_merge_beats(m, m->tree[t], s)) {
+      uint32_t x = m->tree[t];
+      m->tree[t] = s;
+      s = x;
+    }
+  m->tree[0] = s;
+}
+
+static inline void _vp_merge_pull(vp_merge_t* m, uint32_t i) {
+  m->keys[i] = vp_run_next(&m->runs[i], &m->words[i]) ? vp_merge_key(m->words[i]) : UINT64_MAX;
+}
+
+static inline void vp_merge_close(vp_merge_t* m) {
+  for (uint32_t i = 0; m->runs && i < m->k; i++) vp_run_close(&m->runs[i]);
+  vp_free(VP_MEM_SCRATCH, m->runs, m->k * sizeof(vp_run_t));
+  vp_free(VP_MEM_SCRATCH, m->keys, m->k * sizeof(uint64_t));
+  vp_free(VP_MEM_SCRATCH, m->words, m->k * sizeof(vpack64_t));
+  vp_free(VP_MEM_SCRATCH, m->tree, (m->k + 1) * sizeof(uint32_t));
+  memset(m, 0, sizeof(*m));
+}
+
+/*
+  @brief
+  Open a merge of `k` runs restricted to loci in [lo, hi)
+
+  @returns status  0: success, -1: error
+*/
+static inline int vp_merge_open(vp_merge_t* m, const char* const* paths, uint32_t k, vpack64_t lo, vpack64_t hi,
+                                size_t window) {
+  memset(m, 0, sizeof(*m));
+  m->k = k;
+  m->runs = (vp_run_t*)vp_calloc(VP_MEM_SCRATCH, k, sizeof(vp_run_t));
+  m->keys = (uint64_t*)vp_malloc(VP_MEM_SCRATCH, k * sizeof(uint64_t));
+  m->words = (vpack64_t*)vp_malloc(VP_MEM_SCRATCH, k * sizeof(vpack64_t));
+  m->tree = (uint32_t*)vp_malloc(VP_MEM_SCRATCH, (k + 1) * sizeof(uint32_t));
+  if (!m->runs || !m->keys || !m->words || !m->tree) {
+    vp_merge_close(m);
+    return -1;
+  }
+  for (uint32_t i = 0; i < k; i++) {
+    if (vp_run_open(&m->runs[i], paths[i], lo, hi, window)) {
+      vp_merge_close(m);
+      return -1;
+    }
+    _vp_merge_pull(m, i);
+  }
+  for (uint32_t t = 0; t <= k; t++) m->tree[t] = k;
+  for (uint32_t i = k; i-- > 0;) _vp_merge_adjust(m, i);
+  return 0;
+}
+
+/*
+  @brief
+  Next word in merge order
+
+  @returns 1: word stored in `v`, 0: all runs exhausted
+*/
+static inline int vp_merge_next(vp_merge_t* m, vpack64_t* v) {
+  uint32_t s = m->tree[0];
+  if (!m->k || m->keys[s] == UINT64_MAX) return 0;
+  *v = m->words[s];
+  _vp_merge_pull(m, s);
+  _vp_merge_adjust(m, s);
+  return 1;
+}
+
+/*
+  @brief
+  Next batch of up to `cap` (> 0) words in merge order, passed through
+  `m->dedup` when set and counted into `m->cms` (`vp_cms_add_snv`)
+
+  @returns number of words stored in `buf`, 0: all runs exhausted
+*/
+static inline size_t vp_merge_read(vp_merge_t* m, vpack64_t* buf, size_t cap) {
+  size_t n;
+  for (;;) {
+    n = 0;
+    while (n < cap && vp_merge_next(m, &buf[n])) n++;
+    if (!m->dedup) break;
+    if (!n) {
+      n = vp_dedup_finish(m->dedup, buf, NULL);
+      break;
+    }
+    /* a batch folded entirely into the held group yields nothing */
+    if ((n = vp_dedup(m->dedup, buf, NULL, n))) break;
+  }
+  if (m->cms) vp_cms_add_snv(m->cms, buf, n);
+  return n;
+}
+
+/* Set the alleles of sample `s` in a packed row, first sample highest */
+static inline void _vp_row_set(vpack64_t* row, uint32_t nsamples, uint32_t s, uint64_t a, uint64_t b) {
+  uint32_t w = s / VP_GT_PER_WORD, k = nsamples - w * VP_GT_PER_WORD;
+  if (k > VP_GT_PER_WORD) k = VP_GT_PER_WORD;
+  uint32_t sh = (k - 1 - s % VP_GT_PER_WORD) * 4;
+  row[w] = (row[w] & ~(0xfULL << sh)) | (((a << 2) | b) << sh);
+}
+
+/*
+  @brief
+  Drain a merge into a container. Each locus becomes one site; the
+  row holds sample ID `v >> 46` of each word. Samples without a word
+  at the site, and missing alleles, are hom-ref. Words with a sample
+  ID >= the writer's `nsamples` are dropped.
+
+  @returns status  0: success, -1: write error, VP_ENOMEM: out of memory
+*/
+static inline int vp_merge_write(vp_merge_t* m, vp_writer_t* w) {
+  uint32_t ns = w->nsamples, rw = vp_row_words(ns);
+  vpack64_t* row = (vpack64_t*)vp_malloc(VP_MEM_SCRATCH, (rw ? rw : 1) * sizeof(vpack64_t));
+  if (!row) return VP_ENOMEM;
+  vpack64_t buf[512], site = 0;
+  uint64_t ref = 0, alt = 0;
+  size_t n;
+  int have_site = 0, rc = 0;
+  while (!rc && (n = vp_merge_read(m, buf, 512))) {
+    for (size_t i = 0; i < n && !rc; i++) {
+      vpack64_t v = buf[i], loc = (v >> 9) & VMASK_37;
+      if (!have_site || loc != site) {
+        if (have_site) rc = vp_writer_add(w, site, row);
+        site = loc;
+        have_site = 1;
+        ref = (site >> 2) & 3;
+        alt = site & 3;
+        for (uint32_t j = 0; j < rw; j++) row[j] = ref * 0x5555555555555555ULL;
+        if (ns % VP_GT_PER_WORD) row[rw - 1] &= (1ULL << (ns % VP_GT_PER_WORD * 4)) - 1;
+      }
+      uint32_t s = (uint32_t)(v >> 46);
+      if (s < ns) _vp_row_set(row, ns, s, ((v >> 6) & 7) == 1 ? alt : ref, (v & 7) == 1 ? alt : ref);
+    }
+  }
+  if (have_site && !rc) rc = vp_writer_add(w, site, row);
+  vp_free(VP_MEM_SCRATCH, row, (rw ? rw : 1) * sizeof(vpack64_t));
+  return rc;
+}
+
+/*
+  @brief
+  Drain a merge into a run file of `snvpack64` words
+
+  @returns status  0: success, -1: write error
+*/
+static inline int vp_merge_write_run(vp_merge_t* m, FILE* fp) {
+  vpack64_t buf[512];
+  size_t n;
+  while ((n = vp_merge_read(m, buf, 512)))
+    if (fwrite(buf, sizeof(vpack64_t), n, fp) != n) return -1;
+  return 0;
+}
+
+typedef struct
+{
+  uint32_t nsamples;         // row width, 0: number of inputs
+  uint32_t block_sites;      // container block size
+  uint32_t fan_in;           // runs open at once, at most (see `vp_merge_fan_in`)
+  size_t window;             // read-ahead bytes per run, 0: VP_MERGE_WINDOW
+  const char* tmpdir;        // intermediate runs
+  vpack64_t lo, hi;          // locus range [lo, hi), hi 0: no limit
+  int dedup;                 // VP_DEDUP_* policy, applied in every pass
+  vp_cms_t* cms;             // carrier counts of the output sites, NULL: none
+} vp_merge_opts_t;
+
+static inline vp_merge_opts_t vp_merge_opts_init(void) {
+  return (vp_merge_opts_t){0, 4096, 256, 0, ".", 0, 0, VP_DEDUP_NONE, NULL};
+}
+
+#ifndef VP_MERGE_RESERVED_FDS
+#define VP_MERGE_RESERVED_FDS 16  // descriptors left for the caller and the output
+#endif
+
+/*
+  @brief
+  Fan-in a merge with options `o` will use: `o->fan_in` (at least 2),
+  clamped so that open runs stay below RLIMIT_NOFILE less
+  VP_MERGE_RESERVED_FDS, and so that their windows, two per mapped
+  run or one buffer otherwise, fit the unused part of the memory
+  budget after one writer block. It never goes below 2; a budget too
+  small for that makes the merge fail with an error.
+
+  @param o        options
+  @param nsamples row width of the output
+*/
+static inline uint32_t vp_merge_fan_in(const vp_merge_opts_t* o, uint32_t nsamples) {
+  uint64_t fan = o->fan_in >= 2 ? o->fan_in : 2;
+#if defined(VP_HAVE_MMAP) && defined(RLIMIT_NOFILE)
+  struct rlimit rl;
+  if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur != RLIM_INFINITY) {
+    uint64_t nofile = (uint64_t)rl.rlim_cur;
+    uint64_t lim = nofile > VP_MERGE_RESERVED_FDS + 2 ? nofile - VP_MERGE_RESERVED_FDS : 2;
+    if (fan > lim) fan = lim;
+  }
+#endif
+  uint64_t budget = _VP_LOAD(vp_mem.budget), used = _VP_LOAD(vp_mem.total);
+  if (budget) {
+    uint64_t win = o->window ? o->window : VP_MERGE_WINDOW;
+#if defined(VP_HAVE_MMAP)
+    win *= 2;
+#endif
+    uint64_t per = win + sizeof(vp_run_t) + 2 * sizeof(uint64_t) + sizeof(uint32_t);
+    uint64_t block = (uint64_t)(o->block_sites ? o->block_sites : 1) * (1 + vp_row_words(nsamples)) * sizeof(vpack64_t);
+    uint64_t avail = budget > used + block ? budget - used - block : 0;
+    if (fan > avail / per) fan = avail / per;
+  }
+  return fan >= 2 ? (uint32_t)fan : 2;
+}
+
+/* merges started by this process, numbering their temporary files */
+VP_SHARED uint64_t _vp_merge_seq = 0;
+
+/* Temporary run names are unique per process, merge and pass */
+static inline void _vp_merge_tmp(char* buf, size_t len, const char* dir, uint64_t id, uint32_t pass, size_t i) {
+#if defined(VP_HAVE_MMAP)
+  long pid = (long)getpid();
+#else
+  long pid = 0;
+#endif
+  snprintf(buf, len, "%s/vpack-merge-%ld-%llu-%u-%zu.snv", dir, pid, (unsigned long long)id, pass, i);
+}
+
+/*
+  @brief
+  Merge sorted `snvpack64` run files into one container. With more
+  than `o->fan_in` inputs, intermediate passes merge groups of
+  `fan_in` runs into temporary runs, which are removed once merged.
+  With `o->dedup` set, every pass deduplicates as it merges, so
+  duplicates shrink the intermediate runs too. Quality is not carried
+  by run files, so VP_DEDUP_QUALITY keeps the first word. With `o->cms`
+  set, the final pass counts the carriers of every output site into
+  it, after deduplication. Peak memory is about `fan_in * 2 * window`
+  of mapped pages plus one writer block.
+
+  @param paths input runs
+  @param n     number of inputs
+  @param out   container path
+  @param o     options, NULL for defaults
+
+  @returns status  0: success, -1: error, VP_ENOMEM: out of memory
+*/
+static inline int vp_merge_files(const char* const* paths, size_t n, const char* out, const vp_merge_opts_t* o) {
+  vp_merge_opts_t d = vp_merge_opts_init();
+  if (!o) o = &d;
+  uint32_t ns = o->nsamples ? o->nsamples : (uint32_t)n;
+  uint32_t fan = vp_merge_fan_in(o, ns);
+  const char** cur = (const char**)paths;
+  char** tmp = NULL;
+  size_t ntmp = 0, len = strlen(o->tmpdir) + 96;
+  uint64_t id = _VP_ADD(_vp_merge_seq, 1);
+  int rc = 0;
+  for (uint32_t pass = 0; n > fan && !rc; pass++) {
+    size_t m = (n + fan - 1) / fan;
+    char** next = (char**)vp_calloc(VP_MEM_SCRATCH, m, sizeof(char*));
+    if (!next) { rc = VP_ENOMEM; break; }
+    for (size_t g = 0; g < m && !rc; g++) {
+      next[g] = (char*)vp_malloc(VP_MEM_SCRATCH, len);
+      if (!next[g]) { rc = VP_ENOMEM; break; }
+      _vp_merge_tmp(next[g], len, o->tmpdir, id, pass, g);
+      size_t a = g * fan, b = a + fan < n ? a + fan : n;
+      vp_merge_t mg;
+      FILE* fp = fopen(next[g], "wb");
+      rc = -1;
+      vp_dedup_t dd;
+      vp_dedup_init(&dd, o->dedup);
+      if (fp && !vp_merge_open(&mg, cur + a, (uint32_t)(b - a), o->lo, o->hi, o->window)) {
+        mg.dedup = o->dedup ? &dd : NULL;
+        rc = vp_merge_write_run(&mg, fp);
+        vp_merge_close(&mg);
+      }
+      if (fp && fclose(fp)) rc = -1;
+    }
+    /* the previous pass's runs are merged; remove them */
+    for (size_t i = 0; i < ntmp; i++) {
+      remove(tmp[i]);
+      vp_free(VP_MEM_SCRATCH, tmp[i], len);
+    }
+    vp_free(VP_MEM_SCRATCH, tmp, ntmp * sizeof(char*));
+    tmp = next;
+    ntmp = m;
+    cur = (const char**)next;
+    n = m;
+  }
+  if (!rc) {
+    vp_writer_t w;
+    vp_merge_t mg;
+    vp_dedup_t dd;
+    vp_dedup_init(&dd, o->dedup);
+    rc = -1;
+    if (!vp_writer_open(&w, out, ns, o->block_sites)) {
+      if (!vp_merge_open(&mg, cur, (uint32_t)n, o->lo, o->hi, o->window)) {
+        mg.dedup = o->dedup ? &dd : NULL;
+        mg.cms = o->cms;
+        rc = vp_merge_write(&mg, &w);
+        vp_merge_close(&mg);
+      }
+      if (vp_writer_close(&w)) rc = -1;
+    }
+  }
+  for (size_t i = 0; i < ntmp; i++) {
+    if (tmp[i]) remove(tmp[i]);
+    vp_free(VP_MEM_SCRATCH, tmp[i], len);
+  }
+  vp_free(VP_MEM_SCRATCH, tmp, ntmp * sizeof(char*));
+  return rc;
+}
+
+/*
+  Parallel merge. Keys are sampled from every input and sorted, and
+  splitters are taken at equal quantiles of the sampled key mass, each
+  sample weighted by its file's size. Each partition [split[j],
+  split[j+1]) of loci is merged independently, and the outputs
+  concatenate in order. Splitters are loci, so a site never straddles
+  two partitions.
+*/
+#ifndef VP_SPLIT_SAMPLES
+#define VP_SPLIT_SAMPLES 64  // keys sampled per input and partition
+#endif
+
+typedef struct
+{
+  uint64_t key;
+  double weight;
+} _vp_split_key_t;
+
+static inline int _vp_split_cmp(const void* a, const void* b) {
+  uint64_t x = ((const _vp_split_key_t*)a)->key, y = ((const _vp_split_key_t*)b)->key;
+  return x < y ? -1 : x > y;
+}
+
+/*
+  @brief
+  Pick splitters that cut sorted inputs into `nparts` locus ranges of
+  about equal size. Inputs are files of sorted words; the locus is
+  `(v >> shift) & mask`, as for `vp_hash64_batch`: (9, VMASK_37) for
+  `snvpack64` runs, (0, ~0) for `vpack64_loc` words.
+
+  @param paths  inputs
+  @param n      number of inputs
+  @param shift  locus shift
+  @param mask   locus mask
+  @param nparts partitions wanted
+  @param split  receives nparts + 1 bounds; part j is [split[j], split[j+1]),
+                split[0] is 0 and the last bound is 0 for "no limit"
+
+  @returns number of non-empty partitions (<= nparts), or -1 on error
+*/
+static inline int vp_merge_splitters(const char* const* paths, size_t n, uint32_t shift, uint64_t mask,
+                                     uint32_t nparts, vpack64_t* split) {
+  if (!nparts) return -1;
+  size_t per = (size_t)VP_SPLIT_SAMPLES * nparts, cap = per * n, ns = 0;
+  _vp_split_key_t* k = (_vp_split_key_t*)vp_malloc(VP_MEM_SCRATCH, (cap ? cap : 1) * sizeof(_vp_split_key_t));
+  if (!k) return -1;
+  double total = 0;
+  for (size_t i = 0; i < n; i++) {
+    FILE* fp = fopen(paths[i], "rb");
+    if (!fp || _vp_fseek(fp, 0, SEEK_END)) {
+      if (fp) fclose(fp);
+      vp_free(VP_MEM_SCRATCH, k, (cap ? cap : 1) * sizeof(_vp_split_key_t));
+      return -1;
+    }
+    int64_t len = _vp_ftell(fp);
+    uint64_t nw = len > 0 ? (uint64_t)len / sizeof(vpack64_t) : 0;
+    size_t m = nw < per ? (size_t)nw : per;
+    for (size_t j = 0; j < m; j++) {
+      vpack64_t v;
+      /* the middle of each of m equal slices */
+      uint64_t at = ((2 * (uint64_t)j + 1) * nw) / (2 * m);
+      if (_vp_fseek(fp, (int64_t)(at * sizeof(vpack64_t)), SEEK_SET) || fread(&v, sizeof(v), 1, fp) != 1) break;
+      k[ns++] = (_vp_split_key_t){(v >> shift) & mask, (double)nw / (double)m};
+    }
+    total += (double)nw;
+    fclose(fp);
+  }
+  qsort(k, ns, sizeof(_vp_split_key_t), _vp_split_cmp);
+  int np = 0;
+  split[np++] = 0;
+  double acc = 0;
+  for (size_t i = 0; i < ns && (uint32_t)np < nparts; i++) {
+    acc += k[i].weight;
+    /* cut after this key's locus once the next quantile is reached */
+    if (acc >= total * np / nparts && i + 1 < ns && k[i + 1].key != k[i].key && k[i + 1].key > split[np - 1])
+      split[np++] = k[i + 1].key;
+  }
+  split[np] = 0;
+  vp_free(VP_MEM_SCRATCH, k, (cap ? cap : 1) * sizeof(_vp_split_key_t));
+  return np;
+}
+
+/*
+  @brief
+  Append the blocks of container `path` to a writer, in order. Blocks
+  are copied verbatim with their CRCs, without decoding them, and the
+  footer entries are rebased: refs get the writer's offsets, stats and
+  Bloom words come from the file's footer. A file without a usable
+  footer, or with another Bloom width, has each block read and
+  verified once to rebuild them. Pending sites are flushed first, so
+  the file's block boundaries are kept.
+
+  @returns status  0: success, -1: error, VP_ENOMEM: out of memory,
+                   VP_ECHECKSUM: corrupt block
+*/
+static inline int vp_writer_append_file(vp_writer_t* w, const char* path) {
+  vp_reader_t r;
+  if (vp_writer_flush(w) || vp_reader_open(&r, path)) return -1;
+  size_t rw = vp_row_words(w->nsamples), cap = (size_t)1 << 20;
+  int rc = r.nsamples == w->nsamples ? 0 : -1;
+  uint8_t* buf = rc ? NULL : (uint8_t*)vp_malloc(VP_MEM_SCRATCH, cap);
+  if (!rc && !buf) rc = VP_ENOMEM;
+  const vp_block_stats_t* st = vp_reader_stats(&r);
+  const uint64_t* bloom = (const uint64_t*)vp_reader_section(&r, VP_SEC_BLOOM);
+  int reuse = st && r.footer.bloom_bits == w->bloom_bits && (bloom || !w->bloom_bits);
+  for (uint64_t b = 0; b < r.nblocks && !rc; b++) {
+    vp_block_hdr_t h;
+    uint64_t len = (uint64_t)r.blocks[b].nsites * (1 + rw) * sizeof(vpack64_t);
+    if (_vp_fseek(r.fp, (int64_t)r.blocks[b].off, SEEK_SET) || fread(&h, sizeof(h), 1, r.fp) != 1 ||
+        h.magic != VP_BLOCK_MAGIC || h.nsites != r.blocks[b].nsites || fwrite(&h, sizeof(h), 1, w->fp) != 1) {
+      rc = -1;
+      break;
+    }
+    for (uint64_t k = 0; k < len && !rc; k += cap) {
+      size_t c = len - k < cap ? (size_t)(len - k) : cap;
+      if (fread(buf, 1, c, r.fp) != c || fwrite(buf, 1, c, w->fp) != c) rc = -1;
+    }
+    if (rc) break;
+    if (reuse) {
+      uint64_t nw = w->bloom_bits ? bloom[b + 1] - bloom[b] : 0;
+      if (!_vp_writer_index_slot(w, &h, nw)) {
+        w->stats[w->nblocks] = st[b];
+        if (nw) memcpy(w->bloom + w->bloom_start[w->nblocks], bloom + r.nblocks + 1 + bloom[b], nw * sizeof(uint64_t));
+      }
+    } else {
+      const vp_mat_t* m;
+      if ((rc = vp_reader_read(&r, b, &m))) break;
+      _vp_writer_index(w, &h, m);
+    }
+    w->off += sizeof(h) + len;
+    w->nblocks++;
+    w->nsites += h.nsites;
+    VP_METRIC_INC(VP_M_BLOCKS_WRITTEN, 1);
+    VP_METRIC_INC(VP_M_BYTES_WRITTEN, sizeof(h) + len);
+  }
+  vp_free(VP_MEM_SCRATCH, buf, buf ? cap : 0);
+  vp_reader_close(&r);
+  return rc;
+}
+
+#if defined(VPACK_THREADS)
+typedef struct
+{
+  const char* const* paths;
+  size_t n;
+  char out[4096];
+  vp_merge_opts_t o;
+  vp_cms_t cms;              // this partition's counts, folded into the caller's
+  int skip;                  // clipped range is empty
+  int started;
+  pthread_t th;
+  int rc;
+} _vp_merge_job_t;
+
+static inline void* _vp_merge_worker(void* arg) {
+  _vp_merge_job_t* j = (_vp_merge_job_t*)arg;
+  j->rc = vp_merge_files(j->paths, j->n, j->out, &j->o);
+  return NULL;
+}
+
+/*
+  @brief
+  Merge with `nthreads` workers, one locus range each, then append
+  the partition containers to `out` with `vp_writer_append_file`.
+  Partitions outside [o->lo, o->hi) are skipped. Each worker opens at
+  most `vp_merge_fan_in` / (partitions merged) runs, at least 2, so
+  the total stays within the effective fan-in. With `o->cms` set, each
+  worker counts into its own sketch, and these are folded into
+  `o->cms` with `vp_cms_merge` after the join.
+
+  The result holds the same sites and rows as `vp_merge_files`, but
+  each partition ends with a short block, so the files differ in
+  bytes. The join copies blocks without decoding them; it is bound by
+  disk bandwidth, not by the merge.
+
+  @returns status  0: success, -1: error, VP_ENOMEM: out of memory
+*/
+static inline int vp_merge_files_parallel(const char* const* paths, size_t n, const char* out,
+                                          const vp_merge_opts_t* o, uint32_t nthreads) {
+  vp_merge_opts_t d = vp_merge_opts_init();
+  if (!o) o = &d;
+  if (nthreads < 2) return vp_merge_files(paths, n, out, o);
+  vpack64_t* split = (vpack64_t*)vp_malloc(VP_MEM_SCRATCH, (nthreads + 1) * sizeof(vpack64_t));
+  _vp_merge_job_t* jobs = (_vp_merge_job_t*)vp_calloc(VP_MEM_SCRATCH, nthreads, sizeof(_vp_merge_job_t));
+  int np = split && jobs ? vp_merge_splitters(paths, n, 9, VMASK_37, nthreads, split) : -1, rc = np < 0 ? -1 : 0;
+  uint32_t ns = o->nsamples ? o->nsamples : (uint32_t)n, fan = vp_merge_fan_in(o, ns), active = 0;
+  uint64_t id = _VP_ADD(_vp_merge_seq, 1);
+  for (int j = 0; j < np; j++) {
+    _vp_merge_job_t* jb = &jobs[j];
+    jb->paths = paths;
+    jb->n = n;
+    jb->o = *o;
+    jb->o.nsamples = ns;
+    /* clip the partition to the caller's range */
+    vpack64_t lo = split[j], hi = split[j + 1];
+    jb->o.lo = lo > o->lo ? lo : o->lo;
+    jb->o.hi = !hi ? o->hi : !o->hi || hi < o->hi ? hi : o->hi;
+    jb->skip = jb->o.hi && jb->o.lo >= jb->o.hi;
+    active += !jb->skip;
+    snprintf(jb->out, sizeof(jb->out), "%s/vpack-part-%ld-%llu-%d.vpk", o->tmpdir, (long)getpid(),
+             (unsigned long long)id, j);
+  }
+  for (int j = 0; j < np && !rc; j++) {
+    _vp_merge_job_t* jb = &jobs[j];
+    if (jb->skip) continue;
+    jb->o.fan_in = fan / active > 2 ? fan / active : 2;
+    if (o->cms) {
+      if (vp_cms_init(&jb->cms, o->cms->depth, o->cms->wbits, o->cms->k)) {
+        rc = VP_ENOMEM;
+        break;
+      }
+      jb->o.cms = &jb->cms;
+    }
+    if (pthread_create(&jb->th, NULL, _vp_merge_worker, jb)) {
+      rc = -1;
+      break;
+    }
+    jb->started = 1;
+  }
+  for (int j = 0; j < np; j++) {
+    if (!jobs[j].started) continue;
+    pthread_join(jobs[j].th, NULL);
+    if (jobs[j].rc && !rc) rc = jobs[j].rc;
+  }
+  for (int j = 0; j < np; j++) {
+    if (!rc && o->cms && jobs[j].started) vp_cms_merge(o->cms, &jobs[j].cms);
+    if (jobs[j].cms.c) vp_cms_destroy(&jobs[j].cms);
+  }
+  vp_writer_t w;
+  if (!rc && !vp_writer_open(&w, out, ns, o->block_sites)) {
+    for (int j = 0; j < np && !rc; j++)
+      if (jobs[j].started) rc = vp_writer_append_file(&w, jobs[j].out);
+    if (vp_writer_close(&w)) rc = -1;
+  } else if (!rc) {
+    rc = -1;
+  }
+  for (int j = 0; j < np; j++)
+    if (jobs[j].started) remove(jobs[j].out);
+  vp_free(VP_MEM_SCRATCH, split, (nthreads + 1) * sizeof(vpack64_t));
+  vp_free(VP_MEM_SCRATCH, jobs, nthreads * sizeof(_vp_merge_job_t));
+  return rc;
+}
+#endif /* VPACK_THREADS */
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*             REGION SCAN
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*
+  Iterator over the sites of a container in a locus range [lo, hi),
+  e.g. a gene or a chromosome arm. The first block comes from the block
+  index (`vp_reader_find`), and the range is delivered block by block
+  as batches: a `vp_mat_t` view of the sites of one block that fall
+  in the range, with their rows.
+
+    vp_region_t it;
+    const vp_mat_t* b;
+    vp_region_open(&it, &r, lo, hi, 0);
+    while ((rc = vp_region_next(&it, &b)) > 0)
+      use(b->sites, b->gts, b->nsites);
+    vp_region_close(&it);
+
+  Upcoming blocks are read ahead while the caller works on the current
+  one. By default the next `ahead` blocks are requested from the kernel
+  (posix_fadvise WILLNEED), so reads hit the page cache. With
+  -DVPACK_THREADS, ranges longer than `ahead` blocks are loaded by a
+  thread into a ring of `ahead` buffers, and it verifies checksums
+  there, so I/O and CRC32C overlap the caller's work. The reader must
+  not be used for anything else until the iterator is closed. Blocks
+  served from a shared segment need no read-ahead.
+*/
+#ifndef VP_REGION_AHEAD
+#define VP_REGION_AHEAD 4  // blocks read ahead
+#endif
+
+#if defined(VPACK_THREADS)
+typedef struct
+{
+  pthread_mutex_t mu;
+  pthread_cond_t cv;
+  vp_reader_t* r;
+  uint64_t b0, b1;           // blocks to load
+  uint64_t loaded;           // blocks [b0, loaded) are in the ring
+  uint64_t released;         // blocks before it may be overwritten
+  int stop;                  // set by the consumer
+  int done;                  // set by the loader on exit
+  int err;                   // first load error
+  uint32_t nslots;
+  vp_cache_slot_t* slot;     // block b in slot[(b - b0) % nslots]
+  int* rc;
+  pthread_t th;
+} _vp_prefetch_t;
+
+/*
+  Load one block into a ring slot. The reader is the loader's alone
+  until the iterator closes, so under pressure its cache is released.
+*/
+static inline int _vp_prefetch_load(_vp_prefetch_t* pf, vp_cache_slot_t* s, uint64_t i) {
+  int rc = _vp_cache_reserve(pf->r, s, pf->r->blocks[i].nsites, -1);
+  if (rc) return rc;
+  s->block = i;
+  return _vp_reader_load_block(pf->r, i, &s->m);
+}
+
+static inline void* _vp_prefetch_worker(void* arg) {
+  _vp_prefetch_t* pf = (_vp_prefetch_t*)arg;
+  for (uint64_t b = pf->b0; b < pf->b1; b++) {
+    pthread_mutex_lock(&pf->mu);
+    while (!pf->stop && b >= pf->released + pf->nslots) pthread_cond_wait(&pf->cv, &pf->mu);
+    int stop = pf->stop;
+    pthread_mutex_unlock(&pf->mu);
+    if (stop) break;
+    uint32_t k = (uint32_t)((b - pf->b0) % pf->nslots);
+    int rc = _vp_prefetch_load(pf, &pf->slot[k], b);
+    pthread_mutex_lock(&pf->mu);
+    pf->rc[k] = rc;
+    pf->loaded = b + 1;
+    if (rc) pf->err = rc;
+    pthread_cond_broadcast(&pf->cv);
+    pthread_mutex_unlock(&pf->mu);
+    if (rc) break;
+  }
+  pthread_mutex_lock(&pf->mu);
+  pf->done = 1;
+  pthread_cond_broadcast(&pf->cv);
+  pthread_mutex_unlock(&pf->mu);
+  return NULL;
+}
+
+static inline void _vp_prefetch_free(_vp_prefetch_t* pf) {
+  size_t rw = vp_row_words(pf->r->nsamples);
+  for (uint32_t k = 0; pf->slot && k < pf->nslots; k++) {
+    vp_free(VP_MEM_CACHE, pf->slot[k].m.sites, pf->slot[k].cap * sizeof(vpack64_t));
+    vp_free(VP_MEM_CACHE, pf->slot[k].m.gts, pf->slot[k].cap * rw * sizeof(vpack64_t));
+  }
+  vp_free(VP_MEM_CACHE, pf->slot, pf->nslots * sizeof(vp_cache_slot_t));
+  vp_free(VP_MEM_CACHE, pf->rc, pf->nslots * sizeof(int));
+  vp_free(VP_MEM_CACHE, pf, sizeof(*pf));
+}
+#endif /* VPACK_THREADS */
+
+typedef struct
+{
+  vp_reader_t* r;
+  vpack64_t lo, hi;          // locus range, hi 0: no limit
+  uint64_t next;             // next block
+  uint64_t end;              // blocks [next, end) overlap the range
+  uint64_t advised;          // blocks before it were read ahead
+  uint32_t ahead;
+  vp_mat_t batch;
+#if defined(VPACK_THREADS)
+  _vp_prefetch_t* pf;        // NULL: read on the caller's thread
+#endif
+} vp_region_t;
+
+/* First site >= key in a block */
+static inline size_t _vp_mat_lower(const vp_mat_t* m, vpack64_t key) {
+  size_t a = 0, b = m->nsites;
+  while (a < b) {
+    size_t mid = (a + b) >> 1;
+    if (m->sites[mid] < key) a = mid + 1; else b = mid;
+  }
+  return a;
+}
+
+/* Ask the kernel for blocks up to `next + ahead` */
+static inline void _vp_region_advise(vp_region_t* it) {
+  uint64_t to = it->next + it->ahead < it->end ? it->next + it->ahead : it->end;
+  if (it->advised < it->next) it->advised = it->next;
+  if (it->advised >= to || it->r->shm) return;
+#if defined(VP_HAVE_MMAP) && defined(POSIX_FADV_WILLNEED)
+  size_t rw = vp_row_words(it->r->nsamples);
+  const vp_block_ref_t* a = &it->r->blocks[it->advised];
+  const vp_block_ref_t* z = &it->r->blocks[to - 1];
+  off_t len = (off_t)(z->off - a->off + sizeof(vp_block_hdr_t) + (uint64_t)z->nsites * (1 + rw) * sizeof(vpack64_t));
+  posix_fadvise(fileno(it->r->fp), (off_t)a->off, len, POSIX_FADV_WILLNEED);
+#endif
+  it->advised = to;
+}
+
+static inline void vp_region_close(vp_region_t* it) {
+#if defined(VPACK_THREADS)
+  if (it->pf) {
+    pthread_mutex_lock(&it->pf->mu);
+    it->pf->stop = 1;
+    pthread_cond_broadcast(&it->pf->cv);
+    pthread_mutex_unlock(&it->pf->mu);
+    pthread_join(it->pf->th, NULL);
+    pthread_mutex_destroy(&it->pf->mu);
+    pthread_cond_destroy(&it->pf->cv);
+    _vp_prefetch_free(it->pf);
+  }
+#endif
+  memset(it, 0, sizeof(*it));
+}
+
+/*
+  @brief
+  Open an iterator over the sites in [lo, hi) of a reader
+
+  @param it    iterator
+  @param r     reader, used only by the iterator until it is closed
+  @param lo    first site, a `vpack64_loc` word
+  @param hi    end site, exclusive, 0 for no limit
+  @param ahead blocks to read ahead, 0 for VP_REGION_AHEAD
+
+  @returns status  0: success, VP_ENOMEM: out of memory
+*/
+static inline int vp_region_open(vp_region_t* it, vp_reader_t* r, vpack64_t lo, vpack64_t hi, uint32_t ahead) {
+  memset(it, 0, sizeof(*it));
+  it->r = r;
+  it->lo = lo;
+  it->hi = hi ? hi : UINT64_MAX;
+  it->ahead = ahead ? ahead : VP_REGION_AHEAD;
+  it->next = vp_reader_find(r, lo);
+  /* blocks are in site order, so the range ends at the first block starting at or after hi */
+  uint64_t a = it->next, b = r->nblocks;
+  while (a < b) {
+    uint64_t mid = (a + b) >> 1;
+    if (r->blocks[mid].first < it->hi) a = mid + 1; else b = mid;
+  }
+  it->end = a;
+#if defined(VPACK_THREADS)
+  if (!r->shm && it->end - it->next > it->ahead) {
+    _vp_prefetch_t* pf = (_vp_prefetch_t*)vp_calloc(VP_MEM_CACHE, 1, sizeof(_vp_prefetch_t));
+    if (!pf) return VP_ENOMEM;
+    pf->r = r;
+    pf->b0 = pf->loaded = pf->released = it->next;
+    pf->b1 = it->end;
+    pf->nslots = it->ahead;
+    pf->slot = (vp_cache_slot_t*)vp_calloc(VP_MEM_CACHE, pf->nslots, sizeof(vp_cache_slot_t));
+    pf->rc = (int*)vp_calloc(VP_MEM_CACHE, pf->nslots, sizeof(int));
+    if (!pf->slot || !pf->rc) {
+      _vp_prefetch_free(pf);
+      return VP_ENOMEM;
+    }
+    pthread_mutex_init(&pf->mu, NULL);
+    pthread_cond_init(&pf->cv, NULL);
+    if (pthread_create(&pf->th, NULL, _vp_prefetch_worker, pf)) {
+      /* no thread: fall back to reading on the caller's thread */
+      pthread_mutex_destroy(&pf->mu);
+      pthread_cond_destroy(&pf->cv);
+      _vp_prefetch_free(pf);
+    } else {
+      it->pf = pf;
+    }
+  }
+#endif
+  return 0;
+}
+
+/*
+  @brief
+  Next batch of the range. The batch views the sites of one block
+  that fall in [lo, hi) and their rows; it stays valid until the next
+  call. Blocks holding no site of the range are skipped.
+
+  @returns 1: batch stored in `out`, 0: end of range,
+           VP_EIO, VP_ECHECKSUM or VP_ENOMEM: read error
+*/
+static inline int vp_region_next(vp_region_t* it, const vp_mat_t** out) {
+  while (it->next < it->end) {
+    const vp_mat_t* m;
+    uint64_t b = it->next++;
+#if defined(VPACK_THREADS)
+    if (it->pf) {
+      _vp_prefetch_t* pf = it->pf;
+      uint32_t k = (uint32_t)((b - pf->b0) % pf->nslots);
+      int rc;
+      pthread_mutex_lock(&pf->mu);
+      /* the previous batch is done with */
+      pf->released = b;
+      pthread_cond_broadcast(&pf->cv);
+      while (pf->loaded <= b && !pf->done) pthread_cond_wait(&pf->cv, &pf->mu);
+      /* past a failed block the loader has stopped */
+      rc = pf->loaded > b ? pf->rc[k] : pf->err ? pf->err : VP_EIO;
+      pthread_mutex_unlock(&pf->mu);
+      if (rc) return rc;
+      m = &pf->slot[k].m;
+    } else
+#endif
+    {
+      _vp_region_advise(it);
+      int rc = vp_reader_read(it->r, b, &m);
+      if (rc) return rc;
+    }
+    size_t i0 = m->nsites && m->sites[0] < it->lo ? _vp_mat_lower(m, it->lo) : 0;
+    size_t i1 = m->nsites && m->sites[m->nsites - 1] >= it->hi ? _vp_mat_lower(m, it->hi) : m->nsites;
+    if (i0 >= i1) continue;
+    size_t rw = vp_row_words(m->nsamples);
+    it->batch = (vp_mat_t){m->sites + i0, m->gts + i0 * rw, i1 - i0, m->nsamples};
+    *out = &it->batch;
+    return 1;
+  }
+  return 0;
+}
+
+/*
+  @brief
+  Run a batch visitor (see "BATCH VISITORS") over the sites in
+  [lo, hi); `first` counts sites from the start of the range. A
+  non-zero return from `fn` stops the scan and is returned. The
+  scan's duration is recorded in VP_H_QUERY_LATENCY.
+
+  @returns status  0: success, a read error (< 0), or the visitor's value
+*/
+static inline int vp_region_scan(vp_reader_t* r, vpack64_t lo, vpack64_t hi, vp_batch_fn fn, void* ud) {
+  VP_METRIC_TIMER(t0);
+  vp_region_t it;
+  const vp_mat_t* m;
+  vp_batch_t b;
+  size_t seen = 0;
+  int rc = vp_region_open(&it, r, lo, hi, 0);
+  while (!rc && (rc = vp_region_next(&it, &m)) > 0) {
+    size_t rw = vp_row_words(m->nsamples);
+    rc = 0;
+    for (size_t i = 0; !rc && i < m->nsites; i += VP_BATCH_SITES) {
+      size_t n = m->nsites - i < VP_BATCH_SITES ? m->nsites - i : VP_BATCH_SITES;
+      vp_batch_init(&b, m->sites + i, m->gts + i * rw, n, seen + i, m->nsamples);
+      rc = fn(&b, ud);
+    }
+    seen += m->nsites;
+  }
+  vp_region_close(&it);
+  VP_METRIC_OBSERVE(VP_H_QUERY_LATENCY, t0);
+  return rc;
+}
+
+#endif /* VPACK_H */